@@ -10,6 +10,7 @@
 //
 
 #include <algorithm>
+#include <bit>
 #include <functional>
 #include <limits>
 
@@ -174,6 +175,16 @@ std::expected<Allocation, Allocator::Error> Allocator::allocate_near(
     return internal_allocate_near(desired_addresses, size, max_distance);
 }
 
+std::expected<Allocation, Allocator::Error> Allocator::allocate_fixed(size_t size) {
+    return allocate_fixed_near({}, size, std::numeric_limits<size_t>::max());
+}
+
+std::expected<Allocation, Allocator::Error> Allocator::allocate_fixed_near(
+    const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance) {
+    std::scoped_lock lock{m_mutex};
+    return internal_allocate_fixed_near(desired_addresses, size, max_distance);
+}
+
 void Allocator::free(uint8_t* address, size_t size) {
     std::scoped_lock lock{m_mutex};
     return internal_free(address, size);
@@ -181,29 +192,68 @@ void Allocator::free(uint8_t* address, size_t size) {
 
 std::expected<Allocation, Allocator::Error> Allocator::internal_allocate_near(
     const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance) {
-    // First search through our list of allocations for a free block that is large
-    // enough.
-    for (const auto& allocation : m_memory) {
-        if (allocation->size < size) {
-            continue;
+    auto address = internal_carve_near(desired_addresses, size, max_distance, 1);
+
+    if (!address) {
+        return std::unexpected{address.error()};
+    }
+
+    return Allocation{shared_from_this(), *address, size};
+}
+
+std::expected<uint8_t*, Allocator::Error> Allocator::internal_carve_near(
+    const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance, size_t alignment) {
+    const auto [low, high] = window(desired_addresses, max_distance);
+
+    // Takes the allocation out of a free range if it fits there, returning the rest of the range to the index.
+    auto carve = [&](std::map<uint8_t*, uint8_t*>::iterator range) -> uint8_t* {
+        const auto start = range->first;
+        const auto end = range->second;
+        const auto address = align_up(std::max(start, low), alignment);
+
+        if (address > high || address >= end || static_cast<size_t>(end - address) < size) {
+            return nullptr;
         }
 
-        for (auto node = allocation->freelist.get(); node != nullptr; node = node->next.get()) {
-            // Enough room?
-            if (static_cast<size_t>(node->end - node->start) < size) {
-                continue;
-            }
+        erase_free_range(range);
 
-            const auto address = node->start;
+        if (start < address) {
+            insert_free_range(start, address);
+        }
 
-            // Close enough?
-            if (!in_range(address, desired_addresses, max_distance)) {
-                continue;
+        if (address + size < end) {
+            insert_free_range(address + size, end);
+        }
+
+        return address;
+    };
+
+    // Any range in a class above the one the request falls in is big enough, so the first range in the window is
+    // taken. Ranges in the request's own class may be too small, so a few of those are tried first.
+    const auto first_class = size_class(size + alignment - 1);
+
+    for (auto c = first_class; c < SIZE_CLASSES; ++c) {
+        const auto& starts = m_free_by_class[c];
+
+        if (starts.empty()) {
+            continue;
+        }
+
+        auto it = starts.lower_bound(low);
+
+        // Free ranges don't overlap, so only the one starting just before the window can reach into it.
+        if (it != starts.begin()) {
+            if (auto address = carve(m_free.find(*std::prev(it)))) {
+                return address;
             }
+        }
 
-            node->start += size;
+        for (auto tries = c == first_class ? 4 : 2; tries > 0 && it != starts.end() && *it <= high; --tries) {
+            const auto range_start = *it++;
 
-            return Allocation{shared_from_this(), address, size};
+            if (auto address = carve(m_free.find(range_start))) {
+                return address;
+            }
         }
     }
 
@@ -215,62 +265,163 @@ std::expected<Allocation, Allocator::Error> Allocator::internal_allocate_near(
         return std::unexpected{allocation_address.error()};
     }
 
-    auto& allocation = m_memory.emplace_back(new Memory);
+    auto memory = std::make_unique<Memory>();
 
-    allocation->address = *allocation_address;
-    allocation->size = allocation_size;
-    allocation->freelist = std::make_unique<FreeNode>();
-    allocation->freelist->start = *allocation_address + size;
-    allocation->freelist->end = *allocation_address + allocation_size;
+    memory->address = *allocation_address;
+    memory->size = allocation_size;
+    m_memory.emplace(*allocation_address, std::move(memory));
 
-    return Allocation{shared_from_this(), *allocation_address, size};
+    if (size < allocation_size) {
+        insert_free_range(*allocation_address + size, *allocation_address + allocation_size);
+    }
+
+    return *allocation_address;
 }
 
-void Allocator::internal_free(uint8_t* address, size_t size) {
-    for (const auto& allocation : m_memory) {
-        if (allocation->address > address || allocation->address + allocation->size < address) {
-            continue;
+std::expected<Allocation, Allocator::Error> Allocator::internal_allocate_fixed_near(
+    const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance) {
+    const auto slab_size = static_cast<size_t>(system_info().page_size);
+    const auto object_size = align_up(size, 16);
+
+    // Objects that don't fit at least a few to a page aren't worth a slab.
+    if (object_size > slab_size / 4) {
+        return internal_allocate_near(desired_addresses, size, max_distance);
+    }
+
+    const auto [low, high] = window(desired_addresses, max_distance);
+    auto& partial_slabs = m_partial_slabs[object_size];
+
+    auto take = [&](std::set<uint8_t*>::iterator it) -> uint8_t* {
+        auto& slab = m_slabs.find(*it)->second;
+        const auto address = slab.free_objects.back();
+
+        if (address < low || address > high) {
+            return nullptr;
         }
 
-        // Find the right place for our new freenode.
-        FreeNode* prev{};
+        slab.free_objects.pop_back();
 
-        for (auto node = allocation->freelist.get(); node != nullptr; prev = node, node = node->next.get()) {
-            if (node->start > address) {
-                break;
-            }
+        if (slab.free_objects.empty()) {
+            partial_slabs.erase(it);
         }
 
-        // Add new freenode.
-        auto free_node = std::make_unique<FreeNode>();
+        return address;
+    };
+
+    auto it = partial_slabs.lower_bound(low);
 
-        free_node->start = address;
-        free_node->end = address + size;
+    if (it != partial_slabs.begin()) {
+        if (auto address = take(std::prev(it))) {
+            return Allocation{shared_from_this(), address, size};
+        }
+    }
 
-        if (prev == nullptr) {
-            free_node->next.swap(allocation->freelist);
-            allocation->freelist.swap(free_node);
-        } else {
-            free_node->next.swap(prev->next);
-            prev->next.swap(free_node);
+    if (it != partial_slabs.end()) {
+        if (auto address = take(it)) {
+            return Allocation{shared_from_this(), address, size};
         }
+    }
+
+    // No slab with room in range, so start a new one.
+    auto slab_address = internal_carve_near(desired_addresses, slab_size, max_distance, slab_size);
+
+    if (!slab_address) {
+        return std::unexpected{slab_address.error()};
+    }
+
+    Slab slab{.address = *slab_address, .size = slab_size, .object_size = object_size};
+    const auto count = slab_size / object_size;
+
+    // Objects are handed out from the start of the slab.
+    slab.free_objects.reserve(count);
 
-        combine_adjacent_freenodes(*allocation);
-        break;
+    for (auto i = count - 1; i > 0; --i) {
+        slab.free_objects.emplace_back(*slab_address + i * object_size);
     }
+
+    partial_slabs.emplace(*slab_address);
+    m_slabs.emplace(*slab_address, std::move(slab));
+
+    return Allocation{shared_from_this(), *slab_address, size};
 }
 
-void Allocator::combine_adjacent_freenodes(Memory& memory) {
-    for (auto prev = memory.freelist.get(), node = prev; node != nullptr; node = node->next.get()) {
-        if (prev->end == node->start) {
-            prev->end = node->end;
-            prev->next.swap(node->next);
-            node->next.reset();
-            node = prev;
-        } else {
-            prev = node;
+void Allocator::internal_free(uint8_t* address, size_t size) {
+    // Slab objects go back to their slab, which is kept for the next object of that size.
+    if (auto slab = m_slabs.upper_bound(address); slab != m_slabs.begin()) {
+        --slab;
+
+        if (address < slab->second.address + slab->second.size) {
+            if (slab->second.free_objects.empty()) {
+                m_partial_slabs[slab->second.object_size].emplace(slab->second.address);
+            }
+
+            slab->second.free_objects.emplace_back(address);
+            return;
         }
     }
+
+    auto memory = m_memory.upper_bound(address);
+
+    if (memory == m_memory.begin()) {
+        return;
+    }
+
+    --memory;
+
+    const auto block_start = memory->second->address;
+    const auto block_end = block_start + memory->second->size;
+
+    if (address >= block_end) {
+        return;
+    }
+
+    auto start = address;
+    auto end = address + size;
+
+    // Merge with the free ranges either side, as long as they're in the same block.
+    if (auto next = m_free.find(end); next != m_free.end() && end < block_end) {
+        end = next->second;
+        erase_free_range(next);
+    }
+
+    if (auto next = m_free.lower_bound(start); next != m_free.begin()) {
+        auto prev = std::prev(next);
+
+        if (prev->second == start && prev->first >= block_start) {
+            start = prev->first;
+            erase_free_range(prev);
+        }
+    }
+
+    insert_free_range(start, end);
+}
+
+void Allocator::insert_free_range(uint8_t* start, uint8_t* end) {
+    m_free.emplace(start, end);
+    m_free_by_class[size_class(static_cast<size_t>(end - start))].emplace(start);
+}
+
+void Allocator::erase_free_range(std::map<uint8_t*, uint8_t*>::iterator range) {
+    m_free_by_class[size_class(static_cast<size_t>(range->second - range->first))].erase(range->first);
+    m_free.erase(range);
+}
+
+size_t Allocator::size_class(size_t size) {
+    return static_cast<size_t>(std::bit_width(size)) - 1;
+}
+
+Allocator::Window Allocator::window(const std::vector<uint8_t*>& desired_addresses, size_t max_distance) {
+    auto low = std::numeric_limits<uintptr_t>::min();
+    auto high = std::numeric_limits<uintptr_t>::max();
+
+    for (const auto desired_address : desired_addresses) {
+        const auto address = reinterpret_cast<uintptr_t>(desired_address);
+
+        low = std::max(low, address > max_distance ? address - max_distance : 0);
+        high = std::min(high, high - address > max_distance ? address + max_distance : high);
+    }
+
+    return {reinterpret_cast<uint8_t*>(low), reinterpret_cast<uint8_t*>(high)};
 }
 
 std::expected<uint8_t*, Allocator::Error> Allocator::allocate_nearby_memory(
@@ -398,6 +549,233 @@ VmtHook create_vmt(void* object) {
 }
 } // namespace safetyhook
 
+//
+// Source file: hook_batch.cpp
+//
+
+
+
+namespace safetyhook {
+HookBatch::HookBatch() : HookBatch(Allocator::global()) {
+}
+
+HookBatch::HookBatch(std::shared_ptr<Allocator> allocator) : m_allocator{std::move(allocator)} {
+}
+
+size_t HookBatch::add(InlineHook& hook, void* target, void* destination) {
+    auto hook_result = InlineHook::create(m_allocator, target, destination, InlineHook::StartDisabled);
+
+    std::scoped_lock lock{m_mutex};
+    const auto index = m_entries.size();
+
+    if (hook_result) {
+        hook = std::move(*hook_result);
+    } else {
+        hook.reset();
+
+        if (!m_error) {
+            m_error = Error::bad_inline_hook(index, hook_result.error());
+        }
+    }
+
+    m_entries.emplace_back(Entry{&hook, nullptr});
+
+    return index;
+}
+
+size_t HookBatch::add(MidHook& hook, void* target, MidHookFn destination_fn) {
+    auto hook_result = MidHook::create(m_allocator, target, destination_fn, MidHook::StartDisabled);
+
+    std::scoped_lock lock{m_mutex};
+    const auto index = m_entries.size();
+
+    if (hook_result) {
+        hook = std::move(*hook_result);
+    } else {
+        hook.reset();
+
+        if (!m_error) {
+            m_error = Error::bad_mid_hook(index, hook_result.error());
+        }
+    }
+
+    m_entries.emplace_back(Entry{&hook.m_hook, &hook});
+
+    return index;
+}
+
+size_t HookBatch::enable(InlineHook& hook) {
+    std::scoped_lock lock{m_mutex};
+    m_entries.emplace_back(Entry{&hook, nullptr, Action::Enable});
+    return m_entries.size() - 1;
+}
+
+size_t HookBatch::enable(MidHook& hook) {
+    std::scoped_lock lock{m_mutex};
+    m_entries.emplace_back(Entry{&hook.m_hook, &hook, Action::Enable});
+    return m_entries.size() - 1;
+}
+
+size_t HookBatch::disable(InlineHook& hook) {
+    std::scoped_lock lock{m_mutex};
+    m_entries.emplace_back(Entry{&hook, nullptr, Action::Disable});
+    return m_entries.size() - 1;
+}
+
+size_t HookBatch::disable(MidHook& hook) {
+    std::scoped_lock lock{m_mutex};
+    m_entries.emplace_back(Entry{&hook.m_hook, &hook, Action::Disable});
+    return m_entries.size() - 1;
+}
+
+std::expected<void, HookBatch::Error> HookBatch::commit() {
+    std::scoped_lock lock{m_mutex};
+
+    // Hooks already in the state they're queued for are skipped, so the IP fix-ups below only touch hooks that
+    // actually change. So are hooks queued to be enabled that have been reset and have nothing to enable.
+    for (auto& entry : m_entries) {
+        if (entry.action != Action::Add && entry.inline_hook->m_enabled == (entry.action == Action::Enable)) {
+            entry.skip = true;
+        }
+
+        if (entry.action == Action::Enable && !entry.inline_hook->m_trampoline) {
+            entry.skip = true;
+        }
+    }
+
+    // A hook that failed to build means nothing gets enabled, but the disables still go through.
+    std::optional<Error> error = m_error;
+
+    // Every target that's about to get a jmp is made writable before anything is frozen, so a target that can't be
+    // fails the commit here, before any thread is moved into a trampoline.
+    std::vector<UnprotectMemory> unprotected{};
+
+    for (size_t i = 0; i < m_entries.size() && !error; ++i) {
+        const auto& entry = m_entries[i];
+
+        if (entry.action == Action::Disable || entry.skip) {
+            continue;
+        }
+
+        auto hook = entry.inline_hook;
+
+        if (auto um = unprotect(hook->m_target, hook->m_original_bytes.size())) {
+            unprotected.emplace_back(std::move(*um));
+            continue;
+        }
+
+        const auto err = InlineHook::Error::failed_to_unprotect(hook->m_target);
+
+        if (entry.mid_hook != nullptr) {
+            error = Error::bad_mid_hook(i, MidHook::Error::bad_inline_hook(err));
+        } else {
+            error = Error::bad_inline_hook(i, err);
+        }
+    }
+
+    // Set if a write failed under the freeze after all, once the threads had already been moved.
+    bool failed_frozen = false;
+
+    execute_while_frozen(
+        [this, &error, &failed_frozen] {
+            for (auto& entry : m_entries) {
+                if (entry.action == Action::Disable && !entry.skip) {
+                    entry.inline_hook->restore_original_bytes();
+                }
+            }
+
+            if (error) {
+                return;
+            }
+
+            for (size_t i = 0; i < m_entries.size(); ++i) {
+                if (m_entries[i].action == Action::Disable || m_entries[i].skip) {
+                    continue;
+                }
+
+                auto result = m_entries[i].inline_hook->write_jmp();
+
+                if (result) {
+                    continue;
+                }
+
+                if (m_entries[i].mid_hook != nullptr) {
+                    error = Error::bad_mid_hook(i, MidHook::Error::bad_inline_hook(result.error()));
+                } else {
+                    error = Error::bad_inline_hook(i, result.error());
+                }
+
+                failed_frozen = true;
+
+                // Put back what was already written, while everything is still frozen.
+                for (size_t j = 0; j < i; ++j) {
+                    if (m_entries[j].action != Action::Disable && !m_entries[j].skip) {
+                        m_entries[j].inline_hook->restore_original_bytes();
+                    }
+                }
+
+                break;
+            }
+        },
+        [this, &error](auto, auto, auto ctx) {
+            for (const auto& entry : m_entries) {
+                if (entry.skip) {
+                    continue;
+                }
+
+                if (entry.action == Action::Disable) {
+                    entry.inline_hook->fix_ips_to_target(ctx);
+                } else if (!error) {
+                    entry.inline_hook->fix_ips_to_trampoline(ctx);
+                }
+            }
+        });
+
+    // Pages shared by several targets get their original protection back from the first guard taken on them.
+    while (!unprotected.empty()) {
+        unprotected.pop_back();
+    }
+
+    if (error) {
+        // The threads are visited before the writes, so some may already be in trampolines reset_all() frees.
+        if (failed_frozen) {
+            execute_while_frozen([] {}, [this](auto, auto, auto ctx) {
+                for (const auto& entry : m_entries) {
+                    if (entry.action != Action::Disable && !entry.skip) {
+                        entry.inline_hook->fix_ips_to_target(ctx);
+                    }
+                }
+            });
+        }
+
+        reset_all();
+        return std::unexpected{*error};
+    }
+
+    m_entries.clear();
+
+    return {};
+}
+
+void HookBatch::reset_all() {
+    for (auto& entry : m_entries) {
+        // Hooks that were only queued to be switched belong to an earlier commit and keep their trampolines.
+        if (entry.action != Action::Add) {
+            continue;
+        }
+
+        if (entry.mid_hook != nullptr) {
+            entry.mid_hook->reset();
+        } else {
+            entry.inline_hook->reset();
+        }
+    }
+
+    m_entries.clear();
+    m_error.reset();
+}
+} // namespace safetyhook
+
 //
 // Source file: inline_hook.cpp
 //
@@ -530,7 +908,7 @@ std::expected<InlineHook, InlineHook::Error> InlineHook::create(void* target, vo
 }
 
 std::expected<InlineHook, InlineHook::Error> InlineHook::create(
-    const std::shared_ptr<Allocator>& allocator, void* target, void* destination) {
+    const std::shared_ptr<Allocator>& allocator, void* target, void* destination, Flags flags) {
     InlineHook hook{};
 
     if (const auto setup_result =
@@ -539,6 +917,12 @@ std::expected<InlineHook, InlineHook::Error> InlineHook::create(
         return std::unexpected{setup_result.error()};
     }
 
+    if (!(flags & StartDisabled)) {
+        if (auto enable_result = hook.enable(); !enable_result) {
+            return std::unexpected{enable_result.error()};
+        }
+    }
+
     return hook;
 }
 
@@ -557,10 +941,14 @@ InlineHook& InlineHook::operator=(InlineHook&& other) noexcept {
         m_trampoline = std::move(other.m_trampoline);
         m_trampoline_size = other.m_trampoline_size;
         m_original_bytes = std::move(other.m_original_bytes);
+        m_type = other.m_type;
+        m_enabled = other.m_enabled;
 
         other.m_target = nullptr;
         other.m_destination = nullptr;
         other.m_trampoline_size = 0;
+        other.m_type = Type::Unset;
+        other.m_enabled = false;
     }
 
     return *this;
@@ -716,26 +1104,7 @@ std::expected<void, InlineHook::Error> InlineHook::e9_hook(const std::shared_ptr
     }
 #endif
 
-    std::optional<Error> error;
-
-    // jmp from original to trampoline.
-    execute_while_frozen(
-        [this, &trampoline_epilogue, &error] {
-            if (auto result = emit_jmp_e9(m_target,
-                    reinterpret_cast<uint8_t*>(&trampoline_epilogue->jmp_to_destination), m_original_bytes.size());
-                !result) {
-                error = result.error();
-            }
-        },
-        [this](auto, auto, auto ctx) {
-            for (size_t i = 0; i < m_original_bytes.size(); ++i) {
-                fix_ip(ctx, m_target + i, m_trampoline.data() + i);
-            }
-        });
-
-    if (error) {
-        return std::unexpected{*error};
-    }
+    m_type = Type::E9;
 
     return {};
 }
@@ -784,21 +1153,29 @@ std::expected<void, InlineHook::Error> InlineHook::ff_hook(const std::shared_ptr
         return std::unexpected{result.error()};
     }
 
+    m_type = Type::FF;
+
+    return {};
+}
+#endif
+
+std::expected<void, InlineHook::Error> InlineHook::enable() {
+    std::scoped_lock lock{m_mutex};
+
+    if (m_enabled || !m_trampoline) {
+        return {};
+    }
+
     std::optional<Error> error;
 
     // jmp from original to trampoline.
     execute_while_frozen(
         [this, &error] {
-            if (auto result = emit_jmp_ff(m_target, m_destination, m_target + sizeof(JmpFF), m_original_bytes.size());
-                !result) {
+            if (auto result = write_jmp(); !result) {
                 error = result.error();
             }
         },
-        [this](auto, auto, auto ctx) {
-            for (size_t i = 0; i < m_original_bytes.size(); ++i) {
-                fix_ip(ctx, m_target + i, m_trampoline.data() + i);
-            }
-        });
+        [this](auto, auto, auto ctx) { fix_ips_to_trampoline(ctx); });
 
     if (error) {
         return std::unexpected{*error};
@@ -806,8 +1183,59 @@ std::expected<void, InlineHook::Error> InlineHook::ff_hook(const std::shared_ptr
 
     return {};
 }
+
+void InlineHook::disable() {
+    std::scoped_lock lock{m_mutex};
+
+    if (!m_enabled) {
+        return;
+    }
+
+    execute_while_frozen([this] { restore_original_bytes(); }, [this](auto, auto, auto ctx) { fix_ips_to_target(ctx); });
+}
+
+std::expected<void, InlineHook::Error> InlineHook::write_jmp() {
+    std::expected<void, Error> result{};
+
+    if (m_type == Type::E9) {
+        auto trampoline_epilogue = reinterpret_cast<TrampolineEpilogueE9*>(
+            m_trampoline.address() + m_trampoline_size - sizeof(TrampolineEpilogueE9));
+        result = emit_jmp_e9(m_target, reinterpret_cast<uint8_t*>(&trampoline_epilogue->jmp_to_destination),
+            m_original_bytes.size());
+    }
+#if SAFETYHOOK_ARCH_X86_64
+    else if (m_type == Type::FF) {
+        result = emit_jmp_ff(m_target, m_destination, m_target + sizeof(JmpFF), m_original_bytes.size());
+    }
 #endif
 
+    if (result) {
+        m_enabled = true;
+    }
+
+    return result;
+}
+
+void InlineHook::restore_original_bytes() {
+    if (auto um = unprotect(m_target, m_original_bytes.size())) {
+        std::copy(m_original_bytes.begin(), m_original_bytes.end(), m_target);
+    }
+
+    m_enabled = false;
+}
+
+void InlineHook::fix_ips_to_trampoline(void* thread_ctx) const {
+    for (size_t i = 0; i < m_original_bytes.size(); ++i) {
+        fix_ip(thread_ctx, m_target + i, m_trampoline.data() + i);
+    }
+}
+
+void InlineHook::fix_ips_to_target(void* thread_ctx) const {
+    for (size_t i = 0; i < m_original_bytes.size(); ++i) {
+        fix_ip(thread_ctx, m_trampoline.data() + i, m_target + i);
+    }
+}
+
 void InlineHook::destroy() {
     std::scoped_lock lock{m_mutex};
 
@@ -815,19 +1243,14 @@ void InlineHook::destroy() {
         return;
     }
 
-    execute_while_frozen(
-        [this] {
-            if (auto um = unprotect(m_target, m_original_bytes.size())) {
-                std::copy(m_original_bytes.begin(), m_original_bytes.end(), m_target);
-            }
-        },
-        [this](auto, auto, auto ctx) {
-            for (size_t i = 0; i < m_original_bytes.size(); ++i) {
-                fix_ip(ctx, m_trampoline.data() + i, m_target + i);
-            }
-        });
+    // A hook that was never enabled hasn't touched the target, so there's nothing to freeze for.
+    if (m_enabled) {
+        execute_while_frozen(
+            [this] { restore_original_bytes(); }, [this](auto, auto, auto ctx) { fix_ips_to_target(ctx); });
+    }
 
     m_trampoline.free();
+    m_type = Type::Unset;
 }
 } // namespace safetyhook
 
@@ -901,12 +1324,23 @@ constexpr std::array<uint8_t, 171> asm_data = {0xFF, 0x35, 0xA7, 0x00, 0x00, 0x0
     0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 #endif
 
+#if SAFETYHOOK_ARCH_X86_64
+constexpr size_t destination_offset = sizeof(asm_data) - 16;
+#elif SAFETYHOOK_ARCH_X86_32
+constexpr size_t destination_offset = sizeof(asm_data) - 8;
+#endif
+
+// Stubs come from allocate_fixed, which hands out 16 byte aligned slots. Keeping the destination inside one 16 byte
+// chunk means it never straddles a cache line, so x86 updates it with a single atomic store even though it isn't
+// pointer aligned.
+static_assert(destination_offset % 16 + sizeof(void*) <= 16);
+
 std::expected<MidHook, MidHook::Error> MidHook::create(void* target, MidHookFn destination) {
     return create(Allocator::global(), target, destination);
 }
 
 std::expected<MidHook, MidHook::Error> MidHook::create(
-    const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination) {
+    const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination, Flags flags) {
     MidHook hook{};
 
     if (const auto setup_result = hook.setup(allocator, reinterpret_cast<uint8_t*>(target), destination);
@@ -914,6 +1348,12 @@ std::expected<MidHook, MidHook::Error> MidHook::create(
         return std::unexpected{setup_result.error()};
     }
 
+    if (!(flags & StartDisabled)) {
+        if (auto enable_result = hook.enable(); !enable_result) {
+            return std::unexpected{enable_result.error()};
+        }
+    }
+
     return hook;
 }
 
@@ -939,12 +1379,40 @@ void MidHook::reset() {
     *this = {};
 }
 
+std::expected<void, MidHook::Error> MidHook::enable() {
+    if (auto enable_result = m_hook.enable(); !enable_result) {
+        return std::unexpected{Error::bad_inline_hook(enable_result.error())};
+    }
+
+    return {};
+}
+
+void MidHook::disable() {
+    m_hook.disable();
+}
+
+void MidHook::set_destination(MidHookFn destination_fn) {
+    m_destination = destination_fn;
+
+    if (!m_stub) {
+        return;
+    }
+
+    *reinterpret_cast<volatile uintptr_t*>(m_stub.data() + destination_offset) =
+        reinterpret_cast<uintptr_t>(destination_fn);
+}
+
 std::expected<void, MidHook::Error> MidHook::setup(
     const std::shared_ptr<Allocator>& allocator, uint8_t* target, MidHookFn destination_fn) {
     m_target = target;
     m_destination = destination_fn;
 
-    auto stub_allocation = allocator->allocate(asm_data.size());
+    // Every stub is the same size, so they share slabs near the hooks instead of each taking space of their own.
+    auto stub_allocation = allocator->allocate_fixed_near({target}, asm_data.size());
+
+    if (!stub_allocation) {
+        stub_allocation = allocator->allocate_fixed(asm_data.size());
+    }
 
     if (!stub_allocation) {
         return std::unexpected{Error::bad_allocation(stub_allocation.error())};
@@ -954,17 +1422,16 @@ std::expected<void, MidHook::Error> MidHook::setup(
 
     std::copy(asm_data.begin(), asm_data.end(), m_stub.data());
 
-#if SAFETYHOOK_ARCH_X86_64
-    store(m_stub.data() + sizeof(asm_data) - 16, m_destination);
-#elif SAFETYHOOK_ARCH_X86_32
-    store(m_stub.data() + sizeof(asm_data) - 8, m_destination);
+    store(m_stub.data() + destination_offset, m_destination);
 
+#if SAFETYHOOK_ARCH_X86_32
     // 32-bit has some relocations we need to fix up as well.
     store(m_stub.data() + 0x02, m_stub.data() + m_stub.size() - 4);
-    store(m_stub.data() + 0x59, m_stub.data() + m_stub.size() - 8);
+    store(m_stub.data() + 0x59, m_stub.data() + destination_offset);
 #endif
 
-    auto hook_result = InlineHook::create(allocator, m_target, m_stub.data());
+    // The jump is written by enable(), once the stub knows where the trampoline is.
+    auto hook_result = InlineHook::create(allocator, m_target, m_stub.data(), InlineHook::StartDisabled);
 
     if (!hook_result) {
         m_stub.free();
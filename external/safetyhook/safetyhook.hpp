@@ -61,10 +61,13 @@ import std.compat;
 #pragma once
 
 #ifndef SAFETYHOOK_USE_CXXMODULES
+#include <array>
 #include <cstdint>
 #include <expected>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <vector>
 #else
 import std.compat;
@@ -150,36 +153,79 @@ public:
     [[nodiscard]] std::expected<Allocation, Error> allocate_near(
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
 
+    /// @brief Allocates memory for a fixed-size object, such as a MidHook stub.
+    /// @param size The size of the object.
+    /// @return The Allocation or an Allocator::Error if the allocation failed.
+    /// @note Objects of the same size are packed into shared page-sized slabs, 16 byte aligned.
+    [[nodiscard]] std::expected<Allocation, Error> allocate_fixed(size_t size);
+
+    /// @brief Allocates memory for a fixed-size object near desired addresses.
+    /// @param desired_addresses The desired addresses.
+    /// @param size The size of the object.
+    /// @param max_distance The maximum distance from the desired addresses.
+    /// @return The Allocation or an Allocator::Error if the allocation failed.
+    /// @note Objects of the same size are packed into shared page-sized slabs, 16 byte aligned.
+    [[nodiscard]] std::expected<Allocation, Error> allocate_fixed_near(
+        const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
+
 protected:
     friend Allocation;
 
     void free(uint8_t* address, size_t size);
 
 private:
-    struct FreeNode {
-        std::unique_ptr<FreeNode> next{};
-        uint8_t* start{};
-        uint8_t* end{};
-    };
-
     struct Memory {
         uint8_t* address{};
         size_t size{};
-        std::unique_ptr<FreeNode> freelist{};
 
         ~Memory();
     };
 
-    std::vector<std::unique_ptr<Memory>> m_memory{};
+    struct Slab {
+        uint8_t* address{};
+        size_t size{};
+        size_t object_size{};
+        std::vector<uint8_t*> free_objects{};
+    };
+
+    /// @brief An address window every desired address is within max_distance of.
+    struct Window {
+        uint8_t* low{};
+        uint8_t* high{};
+    };
+
+    static constexpr size_t SIZE_CLASSES = sizeof(size_t) * 8;
+
+    // Memory blocks from the OS, by address.
+    std::map<uint8_t*, std::unique_ptr<Memory>> m_memory{};
+
+    // Free ranges, start to end. A range never spans two blocks, and neighbouring free ranges within a block are
+    // always merged.
+    std::map<uint8_t*, uint8_t*> m_free{};
+
+    // Starts of the same free ranges, split by size class (the index of the size's highest set bit).
+    std::array<std::set<uint8_t*>, SIZE_CLASSES> m_free_by_class{};
+
+    // Slabs by address, and the addresses of slabs with a free object by object size.
+    std::map<uint8_t*, Slab> m_slabs{};
+    std::map<size_t, std::set<uint8_t*>> m_partial_slabs{};
+
     std::mutex m_mutex{};
 
     Allocator() = default;
 
     [[nodiscard]] std::expected<Allocation, Error> internal_allocate_near(
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance = 0x7FFF'FFFF);
+    [[nodiscard]] std::expected<uint8_t*, Error> internal_carve_near(
+        const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance, size_t alignment);
+    [[nodiscard]] std::expected<Allocation, Error> internal_allocate_fixed_near(
+        const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance);
     void internal_free(uint8_t* address, size_t size);
 
-    static void combine_adjacent_freenodes(Memory& memory);
+    void insert_free_range(uint8_t* start, uint8_t* end);
+    void erase_free_range(std::map<uint8_t*, uint8_t*>::iterator range);
+    [[nodiscard]] static size_t size_class(size_t size);
+    [[nodiscard]] static Window window(const std::vector<uint8_t*>& desired_addresses, size_t max_distance);
     [[nodiscard]] static std::expected<uint8_t*, Error> allocate_nearby_memory(
         const std::vector<uint8_t*>& desired_addresses, size_t size, size_t max_distance);
     [[nodiscard]] static bool in_range(
@@ -405,6 +451,12 @@ public:
         [[nodiscard]] static Error not_enough_space(uint8_t* ip) { return {.type = NOT_ENOUGH_SPACE, .ip = ip}; }
     };
 
+    /// @brief Flags for InlineHook.
+    enum Flags : int {
+        Default = 0,       ///< Default flags.
+        StartDisabled = 1, ///< Build the trampoline but don't write the jump until enable() is called.
+    };
+
     /// @brief Create an inline hook.
     /// @param target The address of the function to hook.
     /// @param destination The destination address.
@@ -427,20 +479,22 @@ public:
     /// @param allocator The allocator to use.
     /// @param target The address of the function to hook.
     /// @param destination The destination address.
+    /// @param flags The flags to use.
     /// @return The InlineHook or an InlineHook::Error if an error occurred.
     /// @note If you don't care about error handling, use the easy API (safetyhook::create_inline).
     [[nodiscard]] static std::expected<InlineHook, Error> create(
-        const std::shared_ptr<Allocator>& allocator, void* target, void* destination);
+        const std::shared_ptr<Allocator>& allocator, void* target, void* destination, Flags flags = Default);
 
     /// @brief Create an inline hook with a given Allocator.
     /// @param allocator The allocator to use.
     /// @param target The address of the function to hook.
     /// @param destination The destination address.
+    /// @param flags The flags to use.
     /// @return The InlineHook or an InlineHook::Error if an error occurred.
     /// @note If you don't care about error handling, use the easy API (safetyhook::create_inline).
-    [[nodiscard]] static std::expected<InlineHook, Error> create(
-        const std::shared_ptr<Allocator>& allocator, FnPtr auto target, FnPtr auto destination) {
-        return create(allocator, reinterpret_cast<void*>(target), reinterpret_cast<void*>(destination));
+    [[nodiscard]] static std::expected<InlineHook, Error> create(const std::shared_ptr<Allocator>& allocator,
+        FnPtr auto target, FnPtr auto destination, Flags flags = Default) {
+        return create(allocator, reinterpret_cast<void*>(target), reinterpret_cast<void*>(destination), flags);
     }
 
     InlineHook() = default;
@@ -455,6 +509,19 @@ public:
     /// @note This is called automatically in the destructor.
     void reset();
 
+    /// @brief Write the jump to the trampoline, if it isn't already.
+    /// @return Nothing or an InlineHook::Error if an error occurred.
+    /// @note Freezes all other threads while the jump is written.
+    [[nodiscard]] std::expected<void, Error> enable();
+
+    /// @brief Restore the original bytes but keep the trampoline, so the hook can be enabled again.
+    /// @note Freezes all other threads while the bytes are restored.
+    void disable();
+
+    /// @brief Tests if the jump to the trampoline is currently written.
+    /// @return True if the hook is enabled, false otherwise.
+    [[nodiscard]] bool enabled() const { return m_enabled; }
+
     /// @brief Get a pointer to the target.
     /// @return A pointer to the target.
     [[nodiscard]] uint8_t* target() const { return m_target; }
@@ -605,12 +672,17 @@ public:
 
 private:
     friend class MidHook;
+    friend class HookBatch;
+
+    enum class Type { Unset, E9, FF };
 
     uint8_t* m_target{};
     uint8_t* m_destination{};
     Allocation m_trampoline{};
     std::vector<uint8_t> m_original_bytes{};
     uintptr_t m_trampoline_size{};
+    Type m_type{Type::Unset};
+    bool m_enabled{};
     std::recursive_mutex m_mutex{};
 
     std::expected<void, Error> setup(
@@ -621,6 +693,12 @@ private:
     std::expected<void, Error> ff_hook(const std::shared_ptr<Allocator>& allocator);
 #endif
 
+    // These expect the other threads to already be frozen.
+    std::expected<void, Error> write_jmp();
+    void restore_original_bytes();
+    void fix_ips_to_trampoline(void* thread_ctx) const;
+    void fix_ips_to_target(void* thread_ctx) const;
+
     void destroy();
 };
 } // namespace safetyhook
@@ -749,6 +827,12 @@ public:
         }
     };
 
+    /// @brief Flags for MidHook.
+    enum Flags : int {
+        Default = 0,       ///< Default flags.
+        StartDisabled = 1, ///< Build the stub and trampoline but don't write the jump until enable() is called.
+    };
+
     /// @brief Creates a new MidHook object.
     /// @param target The address of the function to hook.
     /// @param destination_fn The destination function.
@@ -771,21 +855,23 @@ public:
     /// @param allocator The Allocator to use.
     /// @param target The address of the function to hook.
     /// @param destination_fn The destination function.
+    /// @param flags The flags to use.
     /// @return The MidHook object or a MidHook::Error if an error occurred.
     /// @note If you don't care about error handling, use the easy API (safetyhook::create_mid).
-    [[nodiscard]] static std::expected<MidHook, Error> create(
-        const std::shared_ptr<Allocator>& allocator, void* target, MidHookFn destination_fn);
+    [[nodiscard]] static std::expected<MidHook, Error> create(const std::shared_ptr<Allocator>& allocator,
+        void* target, MidHookFn destination_fn, Flags flags = Default);
 
     /// @brief Creates a new MidHook object with a given Allocator.
     /// @tparam T The type of the function to hook.
     /// @param allocator The Allocator to use.
     /// @param target The address of the function to hook.
     /// @param destination_fn The destination function.
+    /// @param flags The flags to use.
     /// @return The MidHook object or a MidHook::Error if an error occurred.
     /// @note If you don't care about error handling, use the easy API (safetyhook::create_mid).
-    [[nodiscard]] static std::expected<MidHook, Error> create(
-        const std::shared_ptr<Allocator>& allocator, FnPtr auto target, MidHookFn destination_fn) {
-        return create(allocator, reinterpret_cast<void*>(target), destination_fn);
+    [[nodiscard]] static std::expected<MidHook, Error> create(const std::shared_ptr<Allocator>& allocator,
+        FnPtr auto target, MidHookFn destination_fn, Flags flags = Default) {
+        return create(allocator, reinterpret_cast<void*>(target), destination_fn, flags);
     }
 
     MidHook() = default;
@@ -800,6 +886,17 @@ public:
     /// @note This is called automatically in the destructor.
     void reset();
 
+    /// @brief Write the jump to the stub, if it isn't already.
+    /// @return Nothing or a MidHook::Error if an error occurred.
+    [[nodiscard]] std::expected<void, Error> enable();
+
+    /// @brief Restore the original bytes but keep the stub, so the hook can be enabled again.
+    void disable();
+
+    /// @brief Tests if the jump to the stub is currently written.
+    /// @return True if the hook is enabled, false otherwise.
+    [[nodiscard]] bool enabled() const { return m_hook.enabled(); }
+
     /// @brief Get a pointer to the target.
     /// @return A pointer to the target.
     [[nodiscard]] uint8_t* target() const { return m_target; }
@@ -812,6 +909,12 @@ public:
     /// @return The destination function.
     [[nodiscard]] MidHookFn destination() const { return m_destination; }
 
+    /// @brief Point the stub at a different destination function.
+    /// @param destination_fn The new destination function.
+    /// @details Safe to call while other threads are running through the hook. Each call of the hook uses either the
+    /// old destination or the new one. The old function must stay callable, since a thread may still be inside it.
+    void set_destination(MidHookFn destination_fn);
+
     /// @brief Returns a vector containing the original bytes of the target function.
     /// @return A vector of the original bytes of the target function.
     [[nodiscard]] const auto& original_bytes() const { return m_hook.m_original_bytes; }
@@ -821,6 +924,8 @@ public:
     explicit operator bool() const { return static_cast<bool>(m_stub); }
 
 private:
+    friend class HookBatch;
+
     InlineHook m_hook{};
     uint8_t* m_target{};
     Allocation m_stub{};
@@ -1004,6 +1109,174 @@ private:
 };
 } // namespace safetyhook
 
+//
+// Header: safetyhook/hook_batch.hpp
+//
+// Include stack:
+//   - safetyhook.hpp
+//   - safetyhook/easy.hpp
+//
+
+/// @file safetyhook/hook_batch.hpp
+/// @brief Installing several hooks with a single thread freeze.
+
+#pragma once
+
+#ifndef SAFETYHOOK_USE_CXXMODULES
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+#else
+import std.compat;
+#endif
+
+namespace safetyhook {
+/// @brief Installs a set of hooks all at once.
+/// @details Each add() builds its hook's trampoline (and stub, for a MidHook) straight away but leaves the target
+/// untouched. commit() then writes every jump inside one execute_while_frozen pass, fixing up the IPs of the frozen
+/// threads for all of the hooks in the same sweep, instead of freezing and resuming the process once per hook.
+/// If any hook fails to build or to be written, every hook in the batch is reset and no target is left modified.
+/// Hooks that were committed earlier can be queued with enable() and disable() to be switched in the same pass.
+/// Disabling can't fail, so those are applied even when an enable fails; the enabled and added hooks are still
+/// all or nothing.
+/// @note The hook objects passed to add() must stay where they are until commit() returns. add() can be called from
+/// several threads at once. Hooks are indexed in the order their add() calls finished.
+class HookBatch final {
+public:
+    /// @brief Error type for HookBatch.
+    struct Error {
+        /// @brief The type of error.
+        enum : uint8_t {
+            BAD_INLINE_HOOK, ///< An InlineHook failed to build or to be written.
+            BAD_MID_HOOK,    ///< A MidHook failed to build or to be written.
+        } type;
+
+        /// @brief Index of the hook that failed, in the order they were added.
+        size_t index;
+
+        /// @brief Extra error information.
+        union {
+            InlineHook::Error inline_hook_error; ///< InlineHook error information.
+            MidHook::Error mid_hook_error;       ///< MidHook error information.
+        };
+
+        /// @brief Create a BAD_INLINE_HOOK error.
+        /// @param index The index of the hook.
+        /// @param err The InlineHook::Error that failed.
+        /// @return The new BAD_INLINE_HOOK error.
+        [[nodiscard]] static Error bad_inline_hook(size_t index, InlineHook::Error err) {
+            return {.type = BAD_INLINE_HOOK, .index = index, .inline_hook_error = err};
+        }
+
+        /// @brief Create a BAD_MID_HOOK error.
+        /// @param index The index of the hook.
+        /// @param err The MidHook::Error that failed.
+        /// @return The new BAD_MID_HOOK error.
+        [[nodiscard]] static Error bad_mid_hook(size_t index, MidHook::Error err) {
+            return {.type = BAD_MID_HOOK, .index = index, .mid_hook_error = err};
+        }
+    };
+
+    /// @brief Creates a batch that uses the default global Allocator.
+    HookBatch();
+
+    /// @brief Creates a batch that uses a given Allocator.
+    /// @param allocator The Allocator to use.
+    explicit HookBatch(std::shared_ptr<Allocator> allocator);
+
+    HookBatch(const HookBatch&) = delete;
+    HookBatch& operator=(const HookBatch&) = delete;
+
+    /// @brief Builds a disabled InlineHook into hook.
+    /// @param hook The hook object to fill in.
+    /// @param target The address of the function to hook.
+    /// @param destination The destination address.
+    /// @return The index of the hook within the batch.
+    size_t add(InlineHook& hook, void* target, void* destination);
+
+    /// @brief Builds a disabled InlineHook into hook.
+    /// @param hook The hook object to fill in.
+    /// @param target The address of the function to hook.
+    /// @param destination The destination address.
+    /// @return The index of the hook within the batch.
+    size_t add(InlineHook& hook, FnPtr auto target, FnPtr auto destination) {
+        return add(hook, reinterpret_cast<void*>(target), reinterpret_cast<void*>(destination));
+    }
+
+    /// @brief Builds a disabled MidHook into hook.
+    /// @param hook The hook object to fill in.
+    /// @param target The address of the function to hook.
+    /// @param destination_fn The destination function.
+    /// @return The index of the hook within the batch.
+    size_t add(MidHook& hook, void* target, MidHookFn destination_fn);
+
+    /// @brief Builds a disabled MidHook into hook.
+    /// @param hook The hook object to fill in.
+    /// @param target The address of the function to hook.
+    /// @param destination_fn The destination function.
+    /// @return The index of the hook within the batch.
+    size_t add(MidHook& hook, FnPtr auto target, MidHookFn destination_fn) {
+        return add(hook, reinterpret_cast<void*>(target), destination_fn);
+    }
+
+    /// @brief Queues a hook that was built earlier, and disabled since, to be enabled again.
+    /// @param hook The hook to enable. Nothing happens to it if it's already enabled.
+    /// @return The index of the hook within the batch.
+    size_t enable(InlineHook& hook);
+
+    /// @brief Queues a hook that was built earlier, and disabled since, to be enabled again.
+    /// @param hook The hook to enable. Nothing happens to it if it's already enabled.
+    /// @return The index of the hook within the batch.
+    size_t enable(MidHook& hook);
+
+    /// @brief Queues an enabled hook to be disabled. It keeps its trampoline, so it can be enabled again later.
+    /// @param hook The hook to disable. Nothing happens to it if it's already disabled.
+    /// @return The index of the hook within the batch.
+    size_t disable(InlineHook& hook);
+
+    /// @brief Queues an enabled hook to be disabled. It keeps its stub, so it can be enabled again later.
+    /// @param hook The hook to disable. Nothing happens to it if it's already disabled.
+    /// @return The index of the hook within the batch.
+    size_t disable(MidHook& hook);
+
+    /// @brief Enables every hook in the batch with a single thread freeze.
+    /// @return Nothing or a HookBatch::Error describing the first hook that failed.
+    /// @note Every target is made writable before the freeze, so a target that can't be fails the commit without
+    /// anything written.
+    /// @note On failure every hook added to the batch is reset and the hooks queued with enable() are left disabled.
+    /// The hooks queued with disable() are disabled either way, including when a hook failed in add().
+    /// Either way the batch is empty afterwards and can be reused.
+    [[nodiscard]] std::expected<void, Error> commit();
+
+    /// @brief Get the number of hooks waiting to be committed.
+    /// @return The number of hooks.
+    [[nodiscard]] size_t size() const {
+        std::scoped_lock lock{m_mutex};
+        return m_entries.size();
+    }
+
+private:
+    enum class Action : uint8_t { Add, Enable, Disable };
+
+    struct Entry {
+        InlineHook* inline_hook;
+        MidHook* mid_hook; // Owner of inline_hook, if it's part of a MidHook.
+        Action action{Action::Add};
+        bool skip{}; // Already in the state it was queued for.
+    };
+
+    std::shared_ptr<Allocator> m_allocator{};
+    std::vector<Entry> m_entries{};
+    std::optional<Error> m_error{};
+    mutable std::mutex m_mutex{};
+
+    void reset_all();
+};
+} // namespace safetyhook
+
 namespace safetyhook {
 /// @brief Easy to use API for creating an InlineHook.
 /// @param target The address of the function to hook.
@@ -1056,6 +1329,7 @@ namespace safetyhook {
 using SafetyHookContext = safetyhook::Context;
 using SafetyHookInline = safetyhook::InlineHook;
 using SafetyHookMid = safetyhook::MidHook;
+using SafetyHookBatch = safetyhook::HookBatch;
 using SafetyInlineHook [[deprecated("Use SafetyHookInline instead.")]] = safetyhook::InlineHook;
 using SafetyMidHook [[deprecated("Use SafetyHookMid instead.")]] = safetyhook::MidHook;
 using SafetyHookVmt = safetyhook::VmtHook;
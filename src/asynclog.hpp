@@ -0,0 +1,202 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <spdlog/details/null_mutex.h>
+#include <spdlog/sinks/base_sink.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include <windows.h>
+
+// spdlog sink that never touches the disk on the calling thread.
+//
+// Each message is copied into a fixed-size slot of a bounded lock-free queue (Vyukov's MPMC ring) and a
+// background thread formats the records in batches and writes them to the file. If the queue is full the message
+// is dropped and counted rather than blocking; the writer logs how many were lost once there's room again.
+// Messages longer than a slot are truncated.
+//
+// The logger still formats the payload ("{}" arguments) on the caller, everything else (timestamp, level, pattern,
+// I/O) happens on the writer. Shutdown() is what gets the tail of the log to the disk on DLL_PROCESS_DETACH.
+//
+// The writer runs until the process exits, which is fine because the DLL is pinned and never unloaded. The sink
+// has to live as long: the destructor only closes handles. The file is a plain Win32 handle rather than a CRT
+// stream, so the exit-time drain can't block on a stream lock held by the terminated writer.
+class AsyncFileSink final : public spdlog::sinks::base_sink<spdlog::details::null_mutex>
+{
+public:
+    static constexpr std::size_t Capacity = 1024;   // must be a power of two
+    static constexpr std::size_t MaxMessage = 216;
+
+    explicit AsyncFileSink(const std::string& filename, bool truncate = true)
+    {
+        static_assert((Capacity & (Capacity - 1)) == 0);
+        for (std::size_t i = 0; i < Capacity; ++i)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        file = CreateFileA(filename.c_str(), truncate ? GENERIC_WRITE : FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE,
+            NULL, truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            throw spdlog::spdlog_ex("Failed opening file " + filename + " for writing", static_cast<int>(GetLastError()));
+
+        writer = CreateThread(NULL, 0, WriterThread, this, 0, NULL);
+        if (!writer) {
+            CloseHandle(file);
+            throw spdlog::spdlog_ex("Failed to start the log writer thread", static_cast<int>(GetLastError()));
+        }
+    }
+
+    ~AsyncFileSink() override
+    {
+        CloseHandle(writer);
+        CloseHandle(file);
+    }
+
+    // Writes out whatever is still queued on the calling thread. For DLL_PROCESS_DETACH at process exit, when the
+    // writer has already been terminated, maybe halfway through a batch.
+    void Shutdown()
+    {
+        WriteBatch();
+    }
+
+    std::uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+
+protected:
+    void sink_it_(const spdlog::details::log_msg& msg) override
+    {
+        auto position = enqueuePosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots[position & (Capacity - 1)];
+            auto sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position);
+            if (diff == 0) {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        auto& record = slot->record;
+        record.time = msg.time;
+        record.threadId = msg.thread_id;
+        record.level = msg.level;
+        record.loggerName = msg.logger_name;
+        record.length = (std::min)(msg.payload.size(), MaxMessage);
+        memcpy(record.text, msg.payload.data(), record.length);
+        slot->sequence.store(position + 1, std::memory_order_release);
+        Wake();
+    }
+
+    // Called by flush_on() after every message, so all it may do is nudge the writer.
+    void flush_() override
+    {
+        Wake();
+    }
+
+private:
+    struct Record
+    {
+        spdlog::log_clock::time_point time;
+        std::size_t threadId;
+        spdlog::level::level_enum level;
+        spdlog::string_view_t loggerName;   // points at the logger's name, which outlives the sink's use of it
+        std::size_t length;
+        char text[MaxMessage];
+    };
+
+    struct alignas(64) Slot
+    {
+        std::atomic<std::size_t> sequence;
+        Record record;
+    };
+
+    Slot slots[Capacity];
+    alignas(64) std::atomic<std::size_t> enqueuePosition{ 0 };
+    alignas(64) std::atomic<std::size_t> dequeuePosition{ 0 };
+    alignas(64) std::atomic<std::uint32_t> signal{ 0 };
+    std::atomic<std::uint64_t> dropped{ 0 };
+    std::uint64_t droppedReported = 0;
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE writer = nullptr;
+
+    void Wake()
+    {
+        signal.fetch_add(1, std::memory_order_release);
+        signal.notify_one();
+    }
+
+    bool Dequeue(Record& record)
+    {
+        auto position = dequeuePosition.load(std::memory_order_relaxed);
+        for (;;) {
+            auto& slot = slots[position & (Capacity - 1)];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(position + 1);
+            if (diff == 0) {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    record = slot.record;
+                    slot.sequence.store(position + Capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Formats everything currently queued and writes it with one WriteFile.
+    void WriteBatch()
+    {
+        Record record;
+        spdlog::memory_buf_t buffer;
+        while (Dequeue(record)) {
+            spdlog::details::log_msg msg(record.time, spdlog::source_loc{}, record.loggerName, record.level,
+                spdlog::string_view_t(record.text, record.length));
+            msg.thread_id = record.threadId;
+            formatter_->format(msg, buffer);
+        }
+
+        auto lost = dropped.load(std::memory_order_relaxed);
+        if (lost != droppedReported) {
+            auto text = fmt::format("Logging: Dropped {} message(s), the log queue was full.", lost - droppedReported);
+            spdlog::details::log_msg msg(spdlog::log_clock::now(), spdlog::source_loc{}, "", spdlog::level::warn, text);
+            formatter_->format(msg, buffer);
+            droppedReported = lost;
+        }
+
+        // Straight to the system cache, nothing is held back in the process.
+        DWORD written = 0;
+        if (buffer.size())
+            WriteFile(file, buffer.data(), static_cast<DWORD>(buffer.size()), &written, NULL);
+    }
+
+    static DWORD __stdcall WriterThread(void* parameter)
+    {
+        static_cast<AsyncFileSink*>(parameter)->WriterLoop();
+        return 0;
+    }
+
+    void WriterLoop()
+    {
+        for (;;) {
+            auto seen = signal.load(std::memory_order_acquire);
+            WriteBatch();
+            signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+};
@@ -1,11 +1,21 @@
 #include "stdafx.h"
 #include "helper.hpp"
+#include "asynclog.hpp"
+#include "fovmath.hpp"
+#include "hookstats.hpp"
+#include "litehook.hpp"
+#include "profiler.hpp"
+#include "seqlock.hpp"
+#include "taskgraph.hpp"
 
 #include <inipp/inipp.h>
 #include <spdlog/spdlog.h>
-#include <spdlog/sinks/basic_file_sink.h>
 #include <safetyhook.hpp>
 
+#include <algorithm>
+#include <functional>
+#include <mutex>
+
 HMODULE baseModule = GetModuleHandle(NULL);
 
 // Version
@@ -15,9 +25,17 @@ std::string sLogFile = sFixName + ".log";
 
 // Logger
 std::shared_ptr<spdlog::logger> logger;
+std::shared_ptr<AsyncFileSink> logSink;
 std::filesystem::path sExePath;
 std::string sExeName;
 
+// Signatures
+Scanner::Batch Signatures;
+std::string sCacheFile = sFixName + ".cache";
+std::string sTraceFile = sFixName + ".trace.json";
+std::unique_ptr<ThreadPool> WorkerPool;
+std::chrono::steady_clock::time_point AttachTime;
+
 // Ini
 inipp::Ini<char> ini;
 std::string sConfigFile = sFixName + ".ini";
@@ -29,16 +47,45 @@ bool bFixRes;
 bool bFixAspect;
 bool bFixFOV;
 bool bFixHUD;
+int iScanThreads;
+bool bHookStats;
+bool bStartupTrace;
+bool bConfigReload;
 
 // Aspect ratio + HUD stuff
 float fPi = (float)3.141592653;
-float fAspectRatio;
 float fNativeAspect = (float)16 / 9;
-float fAspectMultiplier;
-float fHUDWidth;
-float fHUDHeight;
-float fHUDWidthOffset;
-float fHUDHeightOffset;
+
+// Everything the hooks need that only changes with the resolution. CalculateAspectRatio fills it in and bumps
+// epoch, hooks that write to game memory remember the epoch they last applied and skip the write if it matches.
+// Published through a seqlock because CalculateAspectRatio runs on a game thread while other hooks are reading,
+// hooks take one snapshot with Display.Load() and only use that.
+struct DisplayState
+{
+    uint32_t epoch = 0;
+    float fAspectRatio = 0;
+    float fAspectMultiplier = 0;
+    bool bWider = false;            // than 16:9
+    bool bNarrower = false;
+    float fFOVScale = 0;            // 16:9 / aspect ratio
+
+    // Movies
+    float fHUDWidth = 0;
+    float fHUDHeight = 0;
+    float fHUDWidthOffset = 0;
+    float fHUDHeightOffset = 0;
+    int iMovieWidth = 0;
+    int iMovieHeight = 0;
+    int iMovieWidthOffset = 0;
+    int iMovieHeightOffset = 0;
+
+    // HUD
+    float fViewportWidth = 0;       // 480 * aspect ratio
+    float fHUDScale = 0;            // 640 / (480 * aspect ratio)
+    int iHUDWidth = 0;
+    uint32_t iProjectionWidth = 0;  // -1 / aspect multiplier, as the raw float bits the game expects in eax
+};
+SeqLock<DisplayState> Display;
 
 // Variables
 int iResX;
@@ -48,6 +95,7 @@ int iCurrentResY;
 int iDefaultViewportX = 854;
 int iDefaultViewportY = 480;
 float fHUDAspect = (float)640 / 854;
+safetyhook::HookBatch Hooks;
 uintptr_t HUDAspect1Addr;
 uintptr_t HUDAspect2Addr;
 uintptr_t HUDAspect3Addr;
@@ -56,34 +104,218 @@ uintptr_t HUDBackgroundWidthAddr;
 uintptr_t HUDBackgroundHeightAddr;
 bool bIsHUD;
 
+// Hooks that behave differently for wider than 16:9, narrower and native 16:9 get a handler per case instead of
+// testing the aspect ratio on every call. SelectHandlers() swaps the right ones in when the resolution changes.
+enum class AspectClass
+{
+    Native,
+    Wider,
+    Narrower,
+};
+
+template<typename Context>
+void PassThrough(Context&)
+{
+}
+
+template<typename Context>
+struct AspectHandlers
+{
+    void (*native)(Context&) = PassThrough<Context>;
+    void (*wider)(Context&) = PassThrough<Context>;
+    void (*narrower)(Context&) = PassThrough<Context>;
+
+    void (*For(AspectClass aspect) const)(Context&)
+    {
+        switch (aspect) {
+        case AspectClass::Wider: return wider;
+        case AspectClass::Narrower: return narrower;
+        default: return native;
+        }
+    }
+};
+
+struct Fix;
+
+// Keyed by the fix that added the hook, so Fix::Discard() can take its own out.
+std::vector<std::pair<const Fix*, std::function<void(AspectClass)>>> HandlerSwitches;
+std::mutex HandlerMutex;
+
+AspectClass ClassifyAspect(const DisplayState& display)
+{
+    if (display.bWider)
+        return AspectClass::Wider;
+    if (display.bNarrower)
+        return AspectClass::Narrower;
+    return AspectClass::Native;
+}
+
+void SelectHandlers()
+{
+    // Loads the state under the lock so whichever thread swaps last uses the latest resolution.
+    std::scoped_lock lock(HandlerMutex);
+    auto aspect = ClassifyAspect(Display.Load());
+    for (auto& [fix, select] : HandlerSwitches)
+        select(aspect);
+}
+
+void SetCallback(SafetyHookMid& hook, safetyhook::MidHookFn callback)
+{
+    hook.set_destination(callback);
+}
+
+template<LiteHook::Registers Regs>
+void SetCallback(LiteHook::MidHook<Regs>& hook, typename LiteHook::MidHook<Regs>::Callback callback)
+{
+    hook.SetCallback(callback);
+}
+
+void Queue(safetyhook::HookBatch& batch, SafetyHookMid& hook, bool enable)
+{
+    if (enable)
+        batch.enable(hook);
+    else
+        batch.disable(hook);
+}
+
+template<LiteHook::Registers Regs>
+void Queue(safetyhook::HookBatch& batch, LiteHook::MidHook<Regs>& hook, bool enable)
+{
+    if (enable)
+        hook.Enable(batch);
+    else
+        hook.Disable(batch);
+}
+
+// A fix the ini can switch on and off while the game runs. setup runs the first time the fix is enabled and
+// registers everything it installs: hooks with Track(), writes in patches, and callbacks it changes on hooks it
+// doesn't own in switches. After that, toggling only switches those off and back on, no rescanning or rebuilding.
+// A disabled fix has its hooks' original bytes back, so it costs nothing per call.
+struct Fix
+{
+    const char* section;                // in the ini
+    const char* setting;                // for the log
+    bool& enabled;                      // what the ini asks for
+    void (*setup)(Fix& fix);
+
+    bool built = false;
+    bool live = false;                  // what's installed
+    std::vector<std::pair<const char*, std::function<void(safetyhook::HookBatch&, bool)>>> hooks;
+    std::vector<std::function<void(bool)>> switches;
+    Memory::PatchSet patches;
+
+    template<typename Hook>
+    void Track(const char* name, Hook& hook)
+    {
+        hooks.emplace_back(name, [&hook](safetyhook::HookBatch& batch, bool enable) { Queue(batch, hook, enable); });
+    }
+
+    // Hooks are queued on batch and change when it's committed, patches and switches change straight away.
+    void Apply(safetyhook::HookBatch& batch, bool enable)
+    {
+        if (enable && !built) {
+            setup(*this);
+            built = true;
+        }
+        else {
+            for (auto& [name, queue] : hooks)
+                queue(batch, enable);
+            if (enable)
+                patches.Commit();
+            else
+                patches.Revert();
+        }
+
+        for (auto& select : switches)
+            select(enable);
+        live = enable;
+    }
+
+    // A failed commit resets the hooks it added, so a fix built for that commit is taken apart and set up again
+    // the next time it's enabled.
+    void Discard()
+    {
+        for (auto& select : switches)
+            select(false);
+        patches.Rollback();
+        hooks.clear();
+        switches.clear();
+        {
+            std::scoped_lock lock(HandlerMutex);
+            std::erase_if(HandlerSwitches, [this](const auto& entry) { return entry.first == this; });
+        }
+        built = false;
+        live = false;
+    }
+};
+
+// Adds hook to the batch with the handler for the current aspect ratio and registers it with SelectHandlers().
+template<typename Hook, typename Context>
+void AddAspectHook(Fix& fix, Hook& hook, uint8_t* address, const char* name, AspectHandlers<Context> handlers)
+{
+    Profiler::Scope profile(name, "hook");
+    auto wrapped = HookStats::Wrap(name, handlers.For(ClassifyAspect(Display.Load())));
+    if constexpr (std::is_same_v<Hook, SafetyHookMid>)
+        Hooks.add(hook, address, wrapped);
+    else
+        hook.Add(Hooks, address, wrapped);
+
+    fix.Track(name, hook);
+
+    std::scoped_lock lock(HandlerMutex);
+    HandlerSwitches.emplace_back(&fix, [&hook, wrapped, handlers](AspectClass aspect)
+    {
+        SetCallback(hook, HookStats::Rebind(wrapped, handlers.For(aspect)));
+    });
+}
+
 void CalculateAspectRatio(bool bLog)
 {
+    DisplayState state;
+
     // Calculate aspect ratio
-    fAspectRatio = (float)iCurrentResX / (float)iCurrentResY;
-    fAspectMultiplier = fAspectRatio / fNativeAspect;
+    state.fAspectRatio = (float)iCurrentResX / (float)iCurrentResY;
+    state.fAspectMultiplier = state.fAspectRatio / fNativeAspect;
+    state.bWider = state.fAspectRatio > fNativeAspect;
+    state.bNarrower = state.fAspectRatio < fNativeAspect;
+    state.fFOVScale = fNativeAspect / state.fAspectRatio;
 
     // HUD variables
-    fHUDWidth = iCurrentResY * fNativeAspect;
-    fHUDHeight = (float)iCurrentResY;
-    fHUDWidthOffset = (float)(iCurrentResX - fHUDWidth) / 2;
-    fHUDHeightOffset = 0;
-    if (fAspectRatio < fNativeAspect) {
-        fHUDWidth = (float)iCurrentResX;
-        fHUDHeight = (float)iCurrentResX / fNativeAspect;
-        fHUDWidthOffset = 0;
-        fHUDHeightOffset = (float)(iCurrentResY - fHUDHeight) / 2;
+    state.fHUDWidth = iCurrentResY * fNativeAspect;
+    state.fHUDHeight = (float)iCurrentResY;
+    state.fHUDWidthOffset = (float)(iCurrentResX - state.fHUDWidth) / 2;
+    state.fHUDHeightOffset = 0;
+    if (state.bNarrower) {
+        state.fHUDWidth = (float)iCurrentResX;
+        state.fHUDHeight = (float)iCurrentResX / fNativeAspect;
+        state.fHUDWidthOffset = 0;
+        state.fHUDHeightOffset = (float)(iCurrentResY - state.fHUDHeight) / 2;
     }
+    state.iMovieWidth = (int)state.fHUDWidth + (int)state.fHUDWidthOffset;
+    state.iMovieHeight = (int)state.fHUDHeight + (int)state.fHUDHeightOffset;
+    state.iMovieWidthOffset = (int)state.fHUDWidthOffset;
+    state.iMovieHeightOffset = (int)state.fHUDHeightOffset;
+
+    state.fViewportWidth = 480.00f * state.fAspectRatio;
+    state.fHUDScale = 640.00f / state.fViewportWidth;
+    state.iHUDWidth = (int)state.fViewportWidth;
+    state.iProjectionWidth = std::bit_cast<uint32_t>(-1.00f / state.fAspectMultiplier);
+
+    static std::atomic<uint32_t> epoch{ 0 };
+    state.epoch = ++epoch;
+    Display.Store(state);
+    SelectHandlers();
 
     if (bLog) {
         // Log details about current resolution
         spdlog::info("----------");
         spdlog::info("Current Resolution: Resolution: {}x{}", iCurrentResX, iCurrentResY);
-        spdlog::info("Current Resolution: fAspectRatio: {}", fAspectRatio);
-        spdlog::info("Current Resolution: fAspectMultiplier: {}", fAspectMultiplier);
-        spdlog::info("Current Resolution: fHUDWidth: {}", fHUDWidth);
-        spdlog::info("Current Resolution: fHUDHeight: {}", fHUDHeight);
-        spdlog::info("Current Resolution: fHUDWidthOffset: {}", fHUDWidthOffset);
-        spdlog::info("Current Resolution: fHUDHeightOffset: {}", fHUDHeightOffset);
+        spdlog::info("Current Resolution: fAspectRatio: {}", state.fAspectRatio);
+        spdlog::info("Current Resolution: fAspectMultiplier: {}", state.fAspectMultiplier);
+        spdlog::info("Current Resolution: fHUDWidth: {}", state.fHUDWidth);
+        spdlog::info("Current Resolution: fHUDHeight: {}", state.fHUDHeight);
+        spdlog::info("Current Resolution: fHUDWidthOffset: {}", state.fHUDWidthOffset);
+        spdlog::info("Current Resolution: fHUDHeightOffset: {}", state.fHUDHeightOffset);
         spdlog::info("----------");
     }
 }
@@ -100,7 +332,9 @@ void Logging()
     // spdlog initialisation
     {
         try {
-            logger = spdlog::basic_logger_st(sFixName.c_str(), sExePath.string() + sLogFile, true);
+            // Hooks log from game threads, so file I/O is left to the sink's writer thread.
+            logSink = std::make_shared<AsyncFileSink>(sExePath.string() + sLogFile, true);
+            logger = std::make_shared<spdlog::logger>(sFixName, logSink);
             spdlog::set_default_logger(logger);
 
             spdlog::flush_on(spdlog::level::debug);
@@ -158,6 +392,14 @@ void Configuration()
     spdlog::info("Config Parse: bSkipIntro: {}", bSkipIntro);
     inipp::get_value(ini.sections["Fix HUD"], "Enabled", bFixHUD);
     spdlog::info("Config Parse: bFixHUD: {}", bFixHUD);
+    inipp::get_value(ini.sections["Scanner"], "Threads", iScanThreads);
+    spdlog::info("Config Parse: iScanThreads: {}", iScanThreads);
+    inipp::get_value(ini.sections["Hook Stats"], "Enabled", bHookStats);
+    spdlog::info("Config Parse: bHookStats: {}", bHookStats);
+    inipp::get_value(ini.sections["Startup Trace"], "Enabled", bStartupTrace);
+    spdlog::info("Config Parse: bStartupTrace: {}", bStartupTrace);
+    inipp::get_value(ini.sections["Config Reload"], "Enabled", bConfigReload);
+    spdlog::info("Config Parse: bConfigReload: {}", bConfigReload);
 
     // Grab desktop resolution/aspect
     DesktopDimensions = Util::GetPhysicalDesktopDimensions();
@@ -166,422 +408,709 @@ void Configuration()
     CalculateAspectRatio(false);
 }
 
-void IntroSkip()
+void ScanSignatures()
 {
-    if (bSkipIntro)
+    // Register every signature the enabled fixes need, then walk the image once for all of them. With config
+    // reload on, any fix can be switched on later, so that's all of them.
+    Game::Features features{ bSkipIntro, bFixRes, bFixAspect, bFixFOV, bFixHUD };
+    Game::AddSignatures(Signatures, bConfigReload ? Game::Features{} : features);
+
+    // Offsets remembered from a previous launch of the same build only need re-checking, not re-scanning.
+    auto moduleBase = reinterpret_cast<uint8_t*>(baseModule);
+    auto moduleSize = Memory::ModuleSize(baseModule);
+    Scanner::SignatureCache cache(sExePath.string() + sCacheFile, Memory::ModuleTimestamp(baseModule), moduleSize);
+    std::vector<Scanner::SignatureCache::Status> cacheStatus;
     {
-        // Intro Skip
-        uint8_t* IntroSkipScanResult = Memory::PatternScan(baseModule, "80 ?? 08 00 0F 85 ?? ?? ?? ?? 80 7F ?? 00 0F 85 ?? ?? ?? ??");
-        if (IntroSkipScanResult)
+        Profiler::Scope profile("Signature Cache", "scan");
+        if (!cache.Load()) {
+            spdlog::info("Signature Cache: No cache for this build.");
+        }
+        cacheStatus = cache.Apply(Signatures, moduleBase, moduleSize);
+    }
+
+    for (size_t i = 0; i < Signatures.Size(); i++) {
+        switch (cacheStatus[i]) {
+        case Scanner::SignatureCache::Status::Hit:
+            spdlog::info("Signature Cache: {}: Hit.", Signatures[i].name);
+            break;
+        case Scanner::SignatureCache::Status::Stale:
+            spdlog::warn("Signature Cache: {}: Miss (cached address no longer matches).", Signatures[i].name);
+            break;
+        default:
+            spdlog::info("Signature Cache: {}: Miss.", Signatures[i].name);
+            break;
+        }
+    }
+
+    auto pending = Signatures.Unresolved();
+    if (pending) {
+        spdlog::info("Signatures: Scanning with {} thread(s).", WorkerPool->Size());
+    }
+
+    auto scanStart = std::chrono::steady_clock::now();
+    bool scanned = Memory::BatchScan(baseModule, Signatures, WorkerPool.get());
+    auto scanEnd = std::chrono::steady_clock::now();
+    Profiler::Record("Batch Scan", "scan", scanStart, scanEnd);
+    if (scanned) {
+        auto scanTime = std::chrono::duration<double, std::milli>(scanEnd - scanStart).count();
+        spdlog::info("Signatures: Scanned for {} of {} signatures in {:.3f}ms.", pending, Signatures.Size(), scanTime);
+
+        if (!cache.Save(Signatures, moduleBase)) {
+            spdlog::warn("Signature Cache: Failed to write {}", sExePath.string() + sCacheFile);
+        }
+    }
+    else {
+        spdlog::info("Signatures: All {} signatures resolved from cache, no scan needed.", Signatures.Size());
+    }
+}
+
+bool InstallHooks()
+{
+    // Everything set up by the functions above goes live here, with the game's threads frozen only once.
+    size_t count = Hooks.size();
+    auto commit = []
+    {
+        Profiler::Scope profile("Freeze and commit", "freeze");
+        return Hooks.commit();
+    };
+    if (auto result = commit())
+    {
+        spdlog::info("Hooks: Installed {} hook(s).", count);
+        return true;
+    }
+    else
+    {
+        spdlog::error("Hooks: Failed to install hook {} of {} (error {}). No hooks were installed.", result.error().index + 1, count, (int)result.error().type);
+        return false;
+    }
+}
+
+void HookStatistics()
+{
+    if (bHookStats)
+    {
+        // Must be enabled before any hooks are created so their callbacks get wrapped.
+        if (HookStats::Enable())
         {
-            spdlog::info("Skip Intro: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)IntroSkipScanResult - (uintptr_t)baseModule);
-            Memory::Write((uintptr_t)IntroSkipScanResult + 0x3, (BYTE)1); // inLogoSkip = true
-            spdlog::info("Skip Intro: Patched instruction.");
+            spdlog::info("Hook Stats: Enabled. Shared memory block is {}.", HookStats::BlockName);
         }
-        else if (!IntroSkipScanResult)
+        else
         {
-            spdlog::error("Skip Intro: Pattern scan failed.");
+            spdlog::error("Hook Stats: Failed to create shared memory block.");
         }
     }
 }
 
-void Resolution()
+void IntroSkip(Fix& fix)
+{
+    // Skip intro
+    uint8_t* IntroSkipScanResult = Signatures.Find("IntroSkip");
+    if (IntroSkipScanResult)
+    {
+        spdlog::info("Skip Intro: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)IntroSkipScanResult - (uintptr_t)baseModule);
+        if (fix.patches.Write((uintptr_t)IntroSkipScanResult, (BYTE)1).Commit()) // inLogoSkip = true
+            spdlog::info("Skip Intro: Patched instruction.");
+        else
+            spdlog::error("Skip Intro: Failed to patch instruction.");
+    }
+    else if (!IntroSkipScanResult)
+    {
+        spdlog::error("Skip Intro: Pattern scan failed.");
+    }
+}
+
+// Debug build with pdb uses different offsets for this function.
+#ifndef NDEBUG
+constexpr uintptr_t ScreenRectOffset = 0x10;
+#else
+constexpr uintptr_t ScreenRectOffset = 0xC8;
+#endif
+
+SafetyHookMid CurrentResolutionMidHook{};
+safetyhook::MidHookFn CurrentResolutionCallback;
+
+void UpdateResolution(int x, int y)
+{
+    iResX = x;
+    iResY = y;
+
+    // Only log on resolution change
+    if (iResX != iCurrentResX || iResY != iCurrentResY) {
+        iCurrentResX = iResX;
+        iCurrentResY = iResY;
+        CalculateAspectRatio(true);
+    }
+}
+
+// The game's screen rect is left, top, right, bottom. These are swapped in by Fix Resolution.
+void ReadResolution(SafetyHookContext& ctx)
+{
+    if (ctx.esi)
+    {
+        auto rect = reinterpret_cast<int*>(ctx.esi + ScreenRectOffset);
+        UpdateResolution(rect[2] - rect[0], rect[3] - rect[1]);
+    }
+}
+
+void FixResolution(SafetyHookContext& ctx)
+{
+    if (ctx.esi)
+    {
+        auto rect = reinterpret_cast<int*>(ctx.esi + ScreenRectOffset);
+        rect[2] = rect[2] + rect[0];
+        rect[3] = rect[3] + rect[1];
+
+        rect[0] = 0; // Hor
+        rect[1] = 0; // Vert
+
+        UpdateResolution(rect[2], rect[3]);
+    }
+}
+
+void CurrentResolution()
 {
-    // Get current resolution
-    uint8_t* CurrentResolutionScanResult = Memory::PatternScan(baseModule, "8B ?? ?? ?? ?? ?? 6A ?? E8 ?? ?? ?? ?? A1 ?? ?? ?? ?? C7 ?? ?? ?? ?? ?? ??");
+    // Get current resolution. Always hooked, the aspect ratio depends on it.
+    uint8_t* CurrentResolutionScanResult = Signatures.Find("CurrentResolution");
     if (CurrentResolutionScanResult)
     {
         spdlog::info("Current Resolution: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)CurrentResolutionScanResult - (uintptr_t)baseModule);
-        static SafetyHookMid CurrentResolutionMidHook{};
-        CurrentResolutionMidHook = safetyhook::create_mid(CurrentResolutionScanResult,
-            [](SafetyHookContext& ctx)
-            {
-                if (ctx.esi)
-                {
-                    // Debug build with pdb uses different offsets for this function.
-                    #ifndef NDEBUG
-                    if (bFixRes)
-                    {
-                        *reinterpret_cast<int*>(ctx.esi + 0x18) = *reinterpret_cast<int*>(ctx.esi + 0x18) + *reinterpret_cast<int*>(ctx.esi + 0x10);
-                        *reinterpret_cast<int*>(ctx.esi + 0x1C) = *reinterpret_cast<int*>(ctx.esi + 0x1C) + *reinterpret_cast<int*>(ctx.esi + 0x14);
-
-                        *reinterpret_cast<int*>(ctx.esi + 0x10) = 0; // Hor
-                        *reinterpret_cast<int*>(ctx.esi + 0x14) = 0; // Vert
-
-                        iResX = *reinterpret_cast<int*>(ctx.esi + 0x18);
-                        iResY = *reinterpret_cast<int*>(ctx.esi + 0x1C);
-                    }
-                    else
-                    {
-                        iResX = *reinterpret_cast<int*>(ctx.esi + 0x18) - *reinterpret_cast<int*>(ctx.esi + 0x10);
-                        iResY = *reinterpret_cast<int*>(ctx.esi + 0x1C) - *reinterpret_cast<int*>(ctx.esi + 0x14);
-                    }
-                    #else
-                    if (bFixRes)
-                    {
-                        *reinterpret_cast<int*>(ctx.esi + 0xD0) = *reinterpret_cast<int*>(ctx.esi + 0xD0) + *reinterpret_cast<int*>(ctx.esi + 0xC8);
-                        *reinterpret_cast<int*>(ctx.esi + 0xD4) = *reinterpret_cast<int*>(ctx.esi + 0xD4) + *reinterpret_cast<int*>(ctx.esi + 0xCC);
-
-                        *reinterpret_cast<int*>(ctx.esi + 0xC8) = 0; // Hor
-                        *reinterpret_cast<int*>(ctx.esi + 0xCC) = 0; // Vert
-
-                        iResX = *reinterpret_cast<int*>(ctx.esi + 0xD0);
-                        iResY = *reinterpret_cast<int*>(ctx.esi + 0xD4);
-                    }
-                    else
-                    {
-                        iResX = *reinterpret_cast<int*>(ctx.esi + 0xD0) - *reinterpret_cast<int*>(ctx.esi + 0xC8);
-                        iResY = *reinterpret_cast<int*>(ctx.esi + 0xD4) - *reinterpret_cast<int*>(ctx.esi + 0xCC);
-                    }
-                    #endif
-
-                    // Only log on resolution change
-                    if (iResX != iCurrentResX || iResY != iCurrentResY) {
-                        iCurrentResX = iResX;
-                        iCurrentResY = iResY;
-                        CalculateAspectRatio(true);
-                    }
-                }
-            });
+        Profiler::Scope profile("CurrentResolution", "hook");
+        CurrentResolutionCallback = HookStats::Wrap("CurrentResolution", ReadResolution);
+        Hooks.add(CurrentResolutionMidHook, CurrentResolutionScanResult, CurrentResolutionCallback);
     }
     else if (!CurrentResolutionScanResult)
     {
         spdlog::error("Current Resolution: Pattern scan failed.");
     }
+}
 
-    if (bFixRes) {
-        // Viewport
-        uint8_t* ViewportScanResult = Memory::PatternScan(baseModule, "66 0F ?? ?? 0F ?? ?? 5F ?? A3 ?? ?? ?? ??");
-        if (ViewportScanResult)
-        {
-            spdlog::info("Viewport: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)ViewportScanResult - (uintptr_t)baseModule);
+void Resolution(Fix& fix)
+{
+    // Stops the game adding borders to the resolution it reports.
+    fix.switches.push_back([](bool enable)
+    {
+        SetCallback(CurrentResolutionMidHook, HookStats::Rebind(CurrentResolutionCallback, enable ? FixResolution : ReadResolution));
+    });
 
-            static SafetyHookMid ViewportMidHook{};
-            ViewportMidHook = safetyhook::create_mid(ViewportScanResult,
-                [](SafetyHookContext& ctx)
-                {
-                    ctx.eax = iDefaultViewportX;
-                });
-        }
-        else if (!ViewportScanResult)
-        {
-            spdlog::error("Viewport: Pattern scan failed.");
-        }
+    // Viewport
+    uint8_t* ViewportScanResult = Signatures.Find("Viewport");
+    if (ViewportScanResult)
+    {
+        spdlog::info("Viewport: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)ViewportScanResult - (uintptr_t)baseModule);
+
+        static LiteHook::MidHook<LiteHook::Eax> ViewportMidHook{};
+        Profiler::Scope profile("Viewport", "hook");
+        ViewportMidHook.Add(Hooks, ViewportScanResult,
+            HookStats::Wrap("Viewport", [](LiteHook::Context<LiteHook::Eax>& ctx)
+            {
+                ctx.eax() = iDefaultViewportX;
+            }));
+        fix.Track("Viewport", ViewportMidHook);
+    }
+    else if (!ViewportScanResult)
+    {
+        spdlog::error("Viewport: Pattern scan failed.");
     }
 }
 
-void AspectRatio()
+void AspectRatio(Fix& fix)
 {
-    if (bFixAspect) {
-        // Aspect ratio
-        uint8_t* OcclusionAspectScanResult = Memory::PatternScan(baseModule, "F3 0F ?? ?? F3 0F ?? ?? ?? ?? ?? ?? 85 ?? 0F 84 ?? ?? ?? ?? C7 ?? ?? ?? 80 02 00 00");
-        uint8_t* ShadowAspectScanResult = Memory::PatternScan(baseModule, "0F 57 ?? ?? ?? ?? ?? 0F 28 ?? F3 0F ?? ?? 0F 28 ?? C7 05 ?? ?? ?? ?? 00 00 00 00");
-        if (OcclusionAspectScanResult && ShadowAspectScanResult)
-        {
-            spdlog::info("Occlusion Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)OcclusionAspectScanResult - (uintptr_t)baseModule);
-            spdlog::info("Shadow Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)ShadowAspectScanResult - (uintptr_t)baseModule);
+    // Aspect ratio
+    uint8_t* OcclusionAspectScanResult = Signatures.Find("OcclusionAspect");
+    uint8_t* ShadowAspectScanResult = Signatures.Find("ShadowAspect");
+    if (OcclusionAspectScanResult && ShadowAspectScanResult)
+    {
+        spdlog::info("Occlusion Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)OcclusionAspectScanResult - (uintptr_t)baseModule);
+        spdlog::info("Shadow Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)ShadowAspectScanResult - (uintptr_t)baseModule);
 
-            static SafetyHookMid OcclusionAspectMidHook{};
-            OcclusionAspectMidHook = safetyhook::create_mid(OcclusionAspectScanResult + 0x4,
-                [](SafetyHookContext& ctx)
-                {
-                    ctx.xmm0.f32[0] = 1.00f;
-                });
+        Profiler::Scope profile("OcclusionAspect, ShadowAspect", "hook");
+        static LiteHook::MidHook<LiteHook::Xmm0> OcclusionAspectMidHook{};
+        OcclusionAspectMidHook.Add(Hooks, OcclusionAspectScanResult,
+            HookStats::Wrap("OcclusionAspect", [](LiteHook::Context<LiteHook::Xmm0>& ctx)
+            {
+                ctx.xmm<0>().f32[0] = 1.00f;
+            }));
+        fix.Track("OcclusionAspect", OcclusionAspectMidHook);
 
-            static SafetyHookMid ShadowAspectMidHook{};
-            ShadowAspectMidHook = safetyhook::create_mid(ShadowAspectScanResult,
-                [](SafetyHookContext& ctx)
-                {
-                    ctx.xmm0.f32[0] = fAspectRatio;
-                });
-        }
-        else if (!OcclusionAspectScanResult || !ShadowAspectScanResult)
-        {
-            spdlog::error("Aspect Ratio: Pattern scan failed.");
-        }
+        static LiteHook::MidHook<LiteHook::Xmm0> ShadowAspectMidHook{};
+        ShadowAspectMidHook.Add(Hooks, ShadowAspectScanResult,
+            HookStats::Wrap("ShadowAspect", [](LiteHook::Context<LiteHook::Xmm0>& ctx)
+            {
+                auto display = Display.Load();
+                ctx.xmm<0>().f32[0] = display.fAspectRatio;
+            }));
+        fix.Track("ShadowAspect", ShadowAspectMidHook);
+    }
+    else if (!OcclusionAspectScanResult || !ShadowAspectScanResult)
+    {
+        spdlog::error("Aspect Ratio: Pattern scan failed.");
+    }
 
-        // Building pop-in
-        uint8_t* StageTriangleTestScanResult = Memory::PatternScan(baseModule, "34 01 83 ?? ?? 88 ?? ?? 8B ?? ?? ?? ?? ?? 80 ?? ?? ?? ?? ?? 00");
-        if (StageTriangleTestScanResult)
-        {
-            spdlog::info("StageTriangleTest: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)StageTriangleTestScanResult - (uintptr_t)baseModule);
+    // Building pop-in
+    uint8_t* StageTriangleTestScanResult = Signatures.Find("StageTriangleTest");
+    if (StageTriangleTestScanResult)
+    {
+        spdlog::info("StageTriangleTest: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)StageTriangleTestScanResult - (uintptr_t)baseModule);
 
-            static SafetyHookMid StageTriangleTestMidHook{};
-            StageTriangleTestMidHook = safetyhook::create_mid(StageTriangleTestScanResult,
-                [](SafetyHookContext& ctx)
-                {
-                    ctx.eax |= 0x01;
-                });
-        }
-        else if (!StageTriangleTestScanResult)
-        {
-            spdlog::error("StageTriangleTest: Pattern scan failed.");
-        }
+        static LiteHook::MidHook<LiteHook::Eax> StageTriangleTestMidHook{};
+        Profiler::Scope profile("StageTriangleTest", "hook");
+        StageTriangleTestMidHook.Add(Hooks, StageTriangleTestScanResult,
+            HookStats::Wrap("StageTriangleTest", [](LiteHook::Context<LiteHook::Eax>& ctx)
+            {
+                ctx.eax() |= 0x01;
+            }));
+        fix.Track("StageTriangleTest", StageTriangleTestMidHook);
+    }
+    else if (!StageTriangleTestScanResult)
+    {
+        spdlog::error("StageTriangleTest: Pattern scan failed.");
     }
+}
 
-    if (bFixHUD)
+void Movies(Fix& fix)
+{
+    // Movies
+    uint8_t* MovieSizeScanResult = Signatures.Find("MovieSize");
+    uint8_t* MovieAspectScanResult = Signatures.Find("MovieAspect");
+    if (MovieSizeScanResult && MovieAspectScanResult)
     {
-        // Movies
-        uint8_t* MovieSizeScanResult = Memory::PatternScan(baseModule, "0F ?? ?? ?? 83 ?? ?? ?? 83 ?? ?? ?? 83 ?? ?? ?? 8B ?? E8 ?? ?? ?? ??");
-        uint8_t* MovieAspectScanResult = Memory::PatternScan(baseModule, "C7 44 ?? ?? ?? ?? ?? ?? 89 ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? ??");
-        if (MovieSizeScanResult && MovieAspectScanResult)
-        {
-            spdlog::info("HUD: Movies: Size: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)MovieSizeScanResult - (uintptr_t)baseModule);
-            spdlog::info("HUD: Movies: Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)MovieAspectScanResult - (uintptr_t)baseModule);
+        spdlog::info("HUD: Movies: Size: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)MovieSizeScanResult - (uintptr_t)baseModule);
+        spdlog::info("HUD: Movies: Aspect Ratio: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)MovieAspectScanResult - (uintptr_t)baseModule);
+
+        static SafetyHookMid MovieAspectMidHook{};
+        AddAspectHook(fix, MovieAspectMidHook, MovieAspectScanResult, "MovieAspect", AspectHandlers<SafetyHookContext>{
+            .wider = [](SafetyHookContext& ctx)
+            {
+                ctx.xmm0.f32[0] = fNativeAspect;
+            },
+            .narrower = [](SafetyHookContext& ctx)
+            {
+                ctx.xmm0.f32[0] = fNativeAspect;
+            },
+        });
 
-            static SafetyHookMid MovieAspectMidHook{};
-            MovieAspectMidHook = safetyhook::create_mid(MovieAspectScanResult,
-                [](SafetyHookContext& ctx)
+        static SafetyHookMid MovieSizeMidHook{};
+        AddAspectHook(fix, MovieSizeMidHook, MovieSizeScanResult, "MovieSize", AspectHandlers<SafetyHookContext>{
+            .wider = [](SafetyHookContext& ctx)
+            {
+                auto display = Display.Load();
+                if (ctx.eax + 0x20)
                 {
-                    if (fAspectRatio != fNativeAspect)
-                    {
-                        ctx.xmm0.f32[0] = fNativeAspect;
-                    }
-                });
-
-            static SafetyHookMid MovieSizeMidHook{};
-            MovieSizeMidHook = safetyhook::create_mid(MovieSizeScanResult + 0x4,
-                [](SafetyHookContext& ctx)
+                    *reinterpret_cast<int*>(ctx.eax + 0x20) = display.iMovieWidth;          // Width
+                    *reinterpret_cast<int*>(ctx.eax + 0x18) = display.iMovieWidthOffset;    // Horizontal Offset
+                }
+            },
+            .narrower = [](SafetyHookContext& ctx)
+            {
+                auto display = Display.Load();
+                if (ctx.eax + 0x20)
                 {
-                    if (ctx.eax + 0x20)
-                    {
-                        if (fAspectRatio > fNativeAspect)
-                        {
-                            *reinterpret_cast<int*>(ctx.eax + 0x20) = (int)fHUDWidth + (int)fHUDWidthOffset;    // Width
-                            *reinterpret_cast<int*>(ctx.eax + 0x18) = (int)fHUDWidthOffset;                     // Horizontal Offset
-                        }
-                        else if (fAspectRatio < fNativeAspect) {
-                            *reinterpret_cast<int*>(ctx.eax + 0x24) = (int)fHUDHeight + (int)fHUDHeightOffset;  // Height
-                            *reinterpret_cast<int*>(ctx.eax + 0x1C) = (int)fHUDHeightOffset;                    // Vertical Offset
-                        }
-                    }
-                });
-        }
-        else if (!MovieSizeScanResult || !MovieAspectScanResult)
-        {
-            spdlog::error("HUD: Movies: Pattern scan failed.");
-        }
+                    *reinterpret_cast<int*>(ctx.eax + 0x24) = display.iMovieHeight;        // Height
+                    *reinterpret_cast<int*>(ctx.eax + 0x1C) = display.iMovieHeightOffset;  // Vertical Offset
+                }
+            },
+        });
+    }
+    else if (!MovieSizeScanResult || !MovieAspectScanResult)
+    {
+        spdlog::error("HUD: Movies: Pattern scan failed.");
     }
 }
 
-void FOV()
+void FOV(Fix& fix)
 {
-    if (bFixFOV)
+    // Global FOV
+    uint8_t* FOVScanResult = Signatures.Find("FOV");
+    if (FOVScanResult)
     {
-        // Global FOV
-        uint8_t* FOVScanResult = Memory::PatternScan(baseModule, "F3 0F 11 ?? ?? F3 0F 11 ?? ?? ?? ?? ?? F3 0F 59 ?? ?? ?? ?? ?? 56");
-        if (FOVScanResult)
-        {
-            spdlog::info("FOV: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)FOVScanResult - (uintptr_t)baseModule);
+        spdlog::info("FOV: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)FOVScanResult - (uintptr_t)baseModule);
 
-            static SafetyHookMid FOVMidHook{};
-            FOVMidHook = safetyhook::create_mid(FOVScanResult,
-                [](SafetyHookContext& ctx)
-                {
-                    if (fAspectRatio < fNativeAspect)
-                    {
-                        ctx.xmm0.f32[0] = atanf(tanf(ctx.xmm0.f32[0] * (fPi / 360)) / (fAspectRatio) * (fNativeAspect)) * (360 / fPi);
-                    }               
-                });
-        }
-        else if (!FOVScanResult)
-        {
-            spdlog::error("FOV: Pattern scan failed.");
-        }
+        static SafetyHookMid FOVMidHook{};
+        AddAspectHook(fix, FOVMidHook, FOVScanResult, "FOV", AspectHandlers<SafetyHookContext>{
+            .narrower = [](SafetyHookContext& ctx)
+            {
+                auto display = Display.Load();
+                ctx.xmm0.f32[0] = FovMath::Transform(ctx.xmm0.f32[0], display.fFOVScale, display.epoch);
+            },
+        });
+    }
+    else if (!FOVScanResult)
+    {
+        spdlog::error("FOV: Pattern scan failed.");
     }
 }
 
-void HUD()
+void HUD(Fix& fix)
 {
-    if (bFixHUD) {
-        
-        // Set Viewport
-        uint8_t* SetViewportScanResult = Memory::PatternScan(baseModule, "C7 ?? ?? 00 00 F0 43 E8 ?? ?? ?? ??");
-        if (SetViewportScanResult)
-        {
-            spdlog::info("HUD: SetViewport: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)SetViewportScanResult - (uintptr_t)baseModule);
-            uintptr_t SetViewportFuncAddr = (uintptr_t)SetViewportScanResult + 0xC + *reinterpret_cast<std::int32_t*>(SetViewportScanResult + 0x8);
-            spdlog::info("HUD: SetViewport: Function address is {:s}+{:x}", sExeName.c_str(), SetViewportFuncAddr - (uintptr_t)baseModule);
+    // Set Viewport
+    uint8_t* SetViewportScanResult = Signatures.Find("SetViewport");
+    uint8_t* SetViewport2ScanResult = Signatures.Find("SetViewport2");
+    if (SetViewportScanResult && SetViewport2ScanResult)
+    {
+        spdlog::info("HUD: SetViewport: Function address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)SetViewportScanResult - (uintptr_t)baseModule);
+        spdlog::info("HUD: SetViewport: Address 2 is {:s}+{:x}", sExeName.c_str(), (uintptr_t)SetViewport2ScanResult - (uintptr_t)baseModule);
 
-            static SafetyHookMid SetViewportMidHook{};
-            SetViewportMidHook = safetyhook::create_mid(SetViewportFuncAddr,
-                [](SafetyHookContext& ctx)
-                {
-                    if (fAspectRatio > fNativeAspect)
-                    {
-                        ctx.xmm3.f32[0] = 480.00f * fAspectRatio;
-                    }
-                });
-
-            #ifndef NDEBUG
-            static SafetyHookMid SetViewport2MidHook{};
-            SetViewport2MidHook = safetyhook::create_mid(SetViewportFuncAddr + 0x62,
-                [](SafetyHookContext& ctx)
-                {
-                    if (fAspectRatio > fNativeAspect)
-                    {
-                        ctx.xmm3.f32[0] = 854.00f;
-                    }
-                });
-            #else
-            static SafetyHookMid SetViewport2MidHook{};
-            SetViewport2MidHook = safetyhook::create_mid(SetViewportFuncAddr + 0x60,
-                [](SafetyHookContext& ctx)
-                {
-                    if (fAspectRatio > fNativeAspect)
-                    {
-                        ctx.xmm3.f32[0] = 854.00f;
-                    }
-                });
-            #endif
-        }
-        else if (!SetViewportScanResult)
-        {
-            spdlog::error("HUD: SetViewport: Pattern scan failed.");
-        }
+        static SafetyHookMid SetViewportMidHook{};
+        AddAspectHook(fix, SetViewportMidHook, SetViewportScanResult, "SetViewport", AspectHandlers<SafetyHookContext>{
+            .wider = [](SafetyHookContext& ctx)
+            {
+                ctx.xmm3.f32[0] = Display.Load().fViewportWidth;
+            },
+        });
 
-        // HUD Aspect Ratio
-        uint8_t* HUDAspect1ScanResult = Memory::PatternScan(baseModule, "F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? E8 ?? ?? ?? ?? 8B ?? ?? ?? 8D ?? ?? F2 0F ?? ??");
-        uint8_t* HUDAspect2ScanResult = Memory::PatternScan(baseModule, "F3 0F ?? ?? ?? ?? ?? ?? ?? 8B ?? ?? ?? ?? ?? 0F 28 ?? 0F ?? F3 0F ?? ?? 8B ?? ??");
-        if (HUDAspect1ScanResult && HUDAspect2ScanResult)
-        {
-            uintptr_t HUDAspect1Value = *reinterpret_cast<std::int32_t*>(HUDAspect1ScanResult + 0x4);
-            uintptr_t HUDAspect2Value = *reinterpret_cast<std::int32_t*>(HUDAspect2ScanResult + 0x5);
-
-            HUDAspect1Addr = HUDAspect1Value;
-            #ifndef NDEBUG
-            HUDAspect2Addr = HUDAspect2Value - 0xC;
-            #else
-            HUDAspect2Addr = HUDAspect2Value - 0x4;
-            #endif  
-            HUDAspect3Addr = HUDAspect2Value + 0xC;
-            HUDWidthAddr = HUDAspect2Value + 0x10;
-
-            spdlog::info("HUD: Aspect Ratio: To16x9Xpos: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDAspect1Addr - (uintptr_t)baseModule);
-            spdlog::info("HUD: Aspect Ratio: ScreenTable 1: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDAspect2Addr - (uintptr_t)baseModule);
-            spdlog::info("HUD: Aspect Ratio: ScreenTable 2: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDAspect3Addr - (uintptr_t)baseModule);
-            spdlog::info("HUD: Aspect Ratio: Width: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDWidthAddr - (uintptr_t)baseModule);
-        }
-        else if (!HUDAspect1ScanResult || !HUDAspect2ScanResult)
-        {
-            spdlog::error("HUD: Aspect Ratio: Pattern scan failed.");
-        }
+        static SafetyHookMid SetViewport2MidHook{};
+        AddAspectHook(fix, SetViewport2MidHook, SetViewport2ScanResult, "SetViewport2", AspectHandlers<SafetyHookContext>{
+            .wider = [](SafetyHookContext& ctx)
+            {
+                ctx.xmm3.f32[0] = 854.00f;
+            },
+        });
+    }
+    else if (!SetViewportScanResult || !SetViewport2ScanResult)
+    {
+        spdlog::error("HUD: SetViewport: Pattern scan failed.");
+    }
 
-        // HUD Backgrounds
-        uint8_t* HUDBackgroundScanResult = Memory::PatternScan(baseModule, "F3 0F ?? ?? ?? ?? ?? ?? 0F 57 ?? F7 ?? 03 ?? C1 ?? ?? 8B ??");
-        if (HUDBackgroundScanResult)
-        {
-            uintptr_t HUDBackgroundValue = *reinterpret_cast<std::int32_t*>(HUDBackgroundScanResult + 0x4);
+    // HUD Aspect Ratio
+    HUDAspect1Addr = (uintptr_t)Signatures.Find("HUDTo16x9Xpos");
+    HUDAspect2Addr = (uintptr_t)Signatures.Find("HUDScreenTable1");
+    HUDAspect3Addr = (uintptr_t)Signatures.Find("HUDScreenTable2");
+    HUDWidthAddr = (uintptr_t)Signatures.Find("HUDWidth");
+    if (HUDAspect1Addr && HUDAspect2Addr && HUDAspect3Addr && HUDWidthAddr)
+    {
+        spdlog::info("HUD: Aspect Ratio: To16x9Xpos: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDAspect1Addr - (uintptr_t)baseModule);
+        spdlog::info("HUD: Aspect Ratio: ScreenTable 1: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDAspect2Addr - (uintptr_t)baseModule);
+        spdlog::info("HUD: Aspect Ratio: ScreenTable 2: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDAspect3Addr - (uintptr_t)baseModule);
+        spdlog::info("HUD: Aspect Ratio: Width: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDWidthAddr - (uintptr_t)baseModule);
+    }
+    else
+    {
+        spdlog::error("HUD: Aspect Ratio: Pattern scan failed.");
+    }
 
-            HUDBackgroundWidthAddr = HUDBackgroundValue;
-            HUDBackgroundHeightAddr = HUDBackgroundValue - 0x12C;
+    // HUD Backgrounds
+    HUDBackgroundWidthAddr = (uintptr_t)Signatures.Find("HUDBackgroundWidth");
+    HUDBackgroundHeightAddr = (uintptr_t)Signatures.Find("HUDBackgroundHeight");
+    if (HUDBackgroundWidthAddr && HUDBackgroundHeightAddr)
+    {
+        spdlog::info("HUD: Backgrounds: Width: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDBackgroundWidthAddr - (uintptr_t)baseModule);
+        spdlog::info("HUD: Backgrounds: Height: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDBackgroundHeightAddr - (uintptr_t)baseModule);
+    }
+    else
+    {
+        spdlog::error("HUD: Aspect Ratio: Pattern scan failed.");
+    }
+
+    // DrawBox
+    uint8_t* DrawBoxScanResult = Signatures.Find("DrawBox");
+    if (DrawBoxScanResult)
+    {
+        spdlog::info("HUD: DrawBox: Function address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)DrawBoxScanResult - (uintptr_t)baseModule);
 
-            spdlog::info("HUD: Backgrounds: Width: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDBackgroundWidthAddr - (uintptr_t)baseModule);
-            spdlog::info("HUD: Backgrounds: Height: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)HUDBackgroundHeightAddr - (uintptr_t)baseModule);
+        // DrawBox updates these on resolution changes, keep them writable so it never has to call VirtualProtect.
+        for (auto addr : { HUDAspect1Addr, HUDAspect2Addr, HUDAspect3Addr, HUDWidthAddr, HUDBackgroundWidthAddr }) {
+            if (addr)
+                fix.patches.KeepWritable(addr, sizeof(float));
         }
-        else if (!HUDBackgroundScanResult)
+        if (!fix.patches.Commit())
         {
-            spdlog::error("HUD: Aspect Ratio: Pattern scan failed.");
+            spdlog::error("HUD: DrawBox: Failed to make HUD values writable.");
         }
 
-        // DrawBox
-        uint8_t* DrawBoxScanResult = Memory::PatternScan(baseModule, "0F 5B ?? E8 ?? ?? ?? ?? C6 ?? ?? ?? ?? ?? 00 C3");
-        if (DrawBoxScanResult)
-        {
-            spdlog::info("HUD: DrawBox: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)DrawBoxScanResult - (uintptr_t)baseModule);
-            uintptr_t DrawBoxFuncAddr = (uintptr_t)DrawBoxScanResult + 0x8 + *reinterpret_cast<std::int32_t*>(DrawBoxScanResult + 0x4);
-            spdlog::info("HUD: DrawBox: Function address is {:s}+{:x}", sExeName.c_str(), DrawBoxFuncAddr - (uintptr_t)baseModule);
+        static SafetyHookMid DrawBoxMidHook{};
+        AddAspectHook(fix, DrawBoxMidHook, DrawBoxScanResult, "DrawBox", AspectHandlers<SafetyHookContext>{
+            .wider = [](SafetyHookContext& ctx)
+            {
+                auto display = Display.Load();
 
-            static SafetyHookMid DrawBoxMidHook{};
-            DrawBoxMidHook = safetyhook::create_mid(DrawBoxFuncAddr,
-                [](SafetyHookContext& ctx)
+                // These only need writing again after a resolution change.
+                static uint32_t appliedEpoch = 0;
+                if (appliedEpoch == display.epoch)
+                    return;
+                appliedEpoch = display.epoch;
+
+                // The pages were left writable up front, so these are plain stores.
+                if (HUDAspect1Addr && HUDAspect2Addr && HUDAspect3Addr)
                 {
-                    if (HUDAspect1Addr && HUDAspect2Addr && HUDAspect3Addr) 
-                    {
-                        if (fAspectRatio > fNativeAspect)
-                        {
-                            Memory::Write(HUDAspect1Addr, 640.00f / (480.00f * fAspectRatio));
-                            Memory::Write(HUDAspect2Addr, 640.00f / (480.00f * fAspectRatio));
-                            Memory::Write(HUDAspect3Addr, 640.00f / (480.00f * fAspectRatio));
-                        }
-                    }
-
-                    if (HUDWidthAddr)
-                    {
-                        if (fAspectRatio > fNativeAspect)
-                        {
-                            Memory::Write(HUDWidthAddr, (int)(480.00f * fAspectRatio));
-                        }
-                    }
-
-                    if (HUDBackgroundWidthAddr && HUDBackgroundHeightAddr)
-                    {
-                        if (fAspectRatio > fNativeAspect) 
-                        {
-                            Memory::Write(HUDBackgroundWidthAddr, (480.00f * fAspectRatio));
-                        }
-                    }
-                });         
-        }
-        else if (!DrawBoxScanResult)
-        {
-            spdlog::error("HUD: DrawBox: Pattern scan failed.");
-        }
+                    *reinterpret_cast<float*>(HUDAspect1Addr) = display.fHUDScale;
+                    *reinterpret_cast<float*>(HUDAspect2Addr) = display.fHUDScale;
+                    *reinterpret_cast<float*>(HUDAspect3Addr) = display.fHUDScale;
+                }
 
-        // ScreenStatus
-        uint8_t* ScreenStatusBeginScanResult = Memory::PatternScan(baseModule, "BA 03 00 00 00 6A 01 6A 00 6A 01 8D ?? ?? E8 ?? ?? ?? ?? 83 ?? ?? 8B ?? E8 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? F3 0F 10 ?? ?? ?? ?? ??");
-        if (ScreenStatusBeginScanResult)
-        {
-            spdlog::info("HUD: ScreenStatus: Begin: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)ScreenStatusBeginScanResult - (uintptr_t)baseModule);
+                if (HUDWidthAddr)
+                {
+                    *reinterpret_cast<int*>(HUDWidthAddr) = display.iHUDWidth;
+                }
 
-            static SafetyHookMid ScreenStatusBeginMidHook{};
-            ScreenStatusBeginMidHook = safetyhook::create_mid(ScreenStatusBeginScanResult,
-                [](SafetyHookContext& ctx)
+                if (HUDBackgroundWidthAddr && HUDBackgroundHeightAddr)
                 {
-                    bIsHUD = true;
-                });
+                    *reinterpret_cast<float*>(HUDBackgroundWidthAddr) = display.fViewportWidth;
+                }
+            },
+        });
+    }
+    else if (!DrawBoxScanResult)
+    {
+        spdlog::error("HUD: DrawBox: Pattern scan failed.");
+    }
+
+    // ScreenStatus
+    uint8_t* ScreenStatusBeginScanResult = Signatures.Find("ScreenStatusBegin");
+    if (ScreenStatusBeginScanResult)
+    {
+        spdlog::info("HUD: ScreenStatus: Begin: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)ScreenStatusBeginScanResult - (uintptr_t)baseModule);
+
+        static LiteHook::MidHook<0> ScreenStatusBeginMidHook{};
+        Profiler::Scope profile("ScreenStatusBegin", "hook");
+        ScreenStatusBeginMidHook.Add(Hooks, ScreenStatusBeginScanResult,
+            HookStats::Wrap("ScreenStatusBegin", [](LiteHook::Context<0>& ctx)
+            {
+                bIsHUD = true;
+            }));
+        fix.Track("ScreenStatusBegin", ScreenStatusBeginMidHook);
+    }
+    else if (!ScreenStatusBeginScanResult)
+    {
+        spdlog::error("HUD: ScreenStatus: Pattern scan failed.");
+    }
+
+    // SetProjection
+    uint8_t* SetProjectionScanResult = Signatures.Find("SetProjectionOffset");
+    if (SetProjectionScanResult)
+    {
+        spdlog::info("HUD: SetProjection: Offset address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)SetProjectionScanResult - (uintptr_t)baseModule);
+
+        static LiteHook::MidHook<LiteHook::Eax> SetProjectionOffsetMidHook{};
+        AddAspectHook(fix, SetProjectionOffsetMidHook, SetProjectionScanResult, "SetProjectionOffset", AspectHandlers<LiteHook::Context<LiteHook::Eax>>{
+            .wider = [](LiteHook::Context<LiteHook::Eax>& ctx)
+            {
+                if (bIsHUD)
+                {
+                    ctx.eax() = Display.Load().iProjectionWidth;
+                }
+            },
+        });
+    }
+    else if (!SetProjectionScanResult)
+    {
+        spdlog::error("HUD: SetProjection: Pattern scan failed.");
+    }
+}
+
+// Everything the ini can switch on and off. HUD() isn't ready yet, so Fix HUD only covers the movies for now and
+// the signatures HUD() needs aren't scanned for (see Game::Features::hudElements).
+Fix SkipIntroFix{ "Skip Intro", "bSkipIntro", bSkipIntro, IntroSkip };
+Fix ResolutionFix{ "Fix Resolution", "bFixRes", bFixRes, Resolution };
+Fix AspectRatioFix{ "Fix Aspect Ratio", "bFixAspect", bFixAspect, AspectRatio };
+Fix FOVFix{ "Fix FOV", "bFixFOV", bFixFOV, FOV };
+Fix HUDFix{ "Fix HUD", "bFixHUD", bFixHUD, Movies };
+Fix* Fixes[] = { &SkipIntroFix, &ResolutionFix, &AspectRatioFix, &FOVFix, &HUDFix };
+
+size_t LiveHooks()
+{
+    size_t count = 0;
+    for (auto fix : Fixes) {
+        if (fix->live)
+            count += fix->hooks.size();
+    }
+    return count;
+}
+
+// Brings the installed fixes in line with the ini. The hooks of every fix that changed are switched in one thread
+// freeze.
+void ApplyFixes()
+{
+    auto start = std::chrono::steady_clock::now();
+    auto liveBefore = LiveHooks();
+    std::vector<Fix*> changed;
+    std::vector<Fix*> fresh;
+    for (auto fix : Fixes) {
+        if (fix->enabled != fix->live) {
+            if (!fix->built)
+                fresh.push_back(fix);
+            fix->Apply(Hooks, fix->enabled);
+            changed.push_back(fix);
         }
-        else if (!ScreenStatusBeginScanResult)
-        {
-            spdlog::error("HUD: ScreenStatus: Pattern scan failed.");
+    }
+
+    if (changed.empty())
+    {
+        spdlog::info("Config Reload: No fixes changed.");
+        return;
+    }
+
+    if (auto result = Hooks.commit(); !result)
+    {
+        // The disables went through anyway and nothing was enabled. Queueing every changed fix off again puts its
+        // patches and switches in line with its hooks, and the hooks already off are skipped.
+        spdlog::error("Config Reload: Failed to switch hook {} (error {}). Fixes being enabled were left off.", result.error().index + 1, (int)result.error().type);
+        for (auto fix : changed) {
+            if (std::ranges::find(fresh, fix) != fresh.end())
+                fix->Discard();
+            else
+                fix->Apply(Hooks, false);
         }
+        (void)Hooks.commit();
+    }
+    // Fixes built just now picked their handlers before the commit.
+    SelectHandlers();
+    auto applyTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-        // SetProjection
-        uint8_t* SetProjectionScanResult = Memory::PatternScan(baseModule, "8B 3D ?? ?? ?? ?? 89 87 ?? ?? ?? ?? 8D B7 ?? ?? ?? ?? 8B ?? 04");
-        if (SetProjectionScanResult)
-        {
-            spdlog::info("HUD: SetProjection: Address is {:s}+{:x}", sExeName.c_str(), (uintptr_t)SetProjectionScanResult - (uintptr_t)baseModule);
+    for (auto fix : changed) {
+        spdlog::info("Config Reload: {}: {} with {} hook(s).", fix->section, fix->live ? "Enabled" : "Disabled", fix->hooks.size());
 
-            static SafetyHookMid SetProjectionOffsetMidHook{};
-            SetProjectionOffsetMidHook = safetyhook::create_mid(SetProjectionScanResult + 0x21,
-                [](SafetyHookContext& ctx)
-                {
-                    if (bIsHUD)
-                    {
-                        if (fAspectRatio > fNativeAspect) 
-                        {
-                            float fWidth = -1.00f / fAspectMultiplier;
-                            ctx.eax = *(uint32_t*)&fWidth;
-                        }
-                    }
-                });
+        // What each hook has cost per call so far is what disabling it saves, and roughly what enabling it adds.
+        if (HookStats::Enabled()) {
+            for (const auto& [name, queue] : fix->hooks) {
+                auto totals = HookStats::Sum(name);
+                spdlog::info("Config Reload: {}: {}: {} call(s) so far, {:.1f}ns per call.", fix->section, name, totals.calls, totals.NanosecondsPerCall());
+            }
         }
-        else if (!SetProjectionScanResult)
-        {
-            spdlog::error("HUD: SetProjection: Pattern scan failed.");
+    }
+    spdlog::info("Config Reload: Applied in {:.3f}ms. {} hook(s) live, was {}.", applyTime, LiveHooks(), liveBefore);
+}
+
+void ReloadConfig()
+{
+    std::ifstream iniFile(sExePath.string() + sConfigFile);
+    if (!iniFile)
+    {
+        spdlog::warn("Config Reload: Failed to open {}", sExePath.string() + sConfigFile);
+        return;
+    }
+
+    // Only the fixes can change while the game runs, everything else still needs a restart.
+    inipp::Ini<char> reloaded;
+    reloaded.parse(iniFile);
+    reloaded.strip_trailing_comments();
+    for (auto fix : Fixes) {
+        bool enabled = fix->enabled;
+        inipp::get_value(reloaded.sections[fix->section], "Enabled", enabled);
+        if (enabled != fix->enabled) {
+            spdlog::info("Config Reload: {}: {}", fix->setting, enabled);
+            fix->enabled = enabled;
+        }
+    }
+    ApplyFixes();
+}
+
+// Waits for the ini to change and applies it for as long as the game runs. There's no way to stop it, which is
+// fine because the DLL is pinned and never unloaded.
+DWORD __stdcall WatchConfig(void*)
+{
+    HANDLE change = FindFirstChangeNotificationW(sExePath.wstring().c_str(), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (change == INVALID_HANDLE_VALUE)
+    {
+        spdlog::error("Config Reload: Failed to watch {}", sExePath.string());
+        return false;
+    }
+    spdlog::info("Config Reload: Watching {}", sExePath.string() + sConfigFile);
+
+    std::error_code error;
+    auto configPath = std::filesystem::path(sExePath.string() + sConfigFile);
+    auto lastWrite = std::filesystem::last_write_time(configPath, error);
+    while (WaitForSingleObject(change, INFINITE) == WAIT_OBJECT_0) {
+        // The log is in the same folder, so most wake-ups are for that.
+        auto write = std::filesystem::last_write_time(configPath, error);
+        if (!error && write != lastWrite) {
+            // Editors tend to save in more than one write, give them a moment to finish.
+            Sleep(100);
+            lastWrite = std::filesystem::last_write_time(configPath, error);
+            ReloadConfig();
         }
+
+        if (!FindNextChangeNotification(change))
+            break;
+    }
+
+    FindCloseChangeNotification(change);
+    return true;
+}
+
+// Writes the startup trace next to the log, if it's enabled.
+void WriteStartupTrace()
+{
+    if (!bStartupTrace)
+        return;
+
+    if (Profiler::Write(sExePath.string() + sTraceFile))
+    {
+        spdlog::info("Startup Trace: Wrote {}", sExePath.string() + sTraceFile);
+    }
+    else
+    {
+        spdlog::warn("Startup Trace: Failed to write {}", sExePath.string() + sTraceFile);
+    }
+    if (auto dropped = Profiler::Dropped())
+    {
+        spdlog::warn("Startup Trace: {} event(s) didn't fit in the trace buffers and were dropped.", dropped);
     }
 }
 
 DWORD __stdcall Main(void*)
 {
-    Logging();
-    Configuration();
-    IntroSkip();
-    Resolution();
-    AspectRatio();
-    FOV();
-    //HUD();
+    Profiler::NameThread("Main");
+    {
+        Profiler::Scope profile("Logging");
+        Logging();
+    }
+    {
+        Profiler::Scope profile("Configuration");
+        Configuration();
+    }
+
+    // The fixes only need the signatures and each other's hooks don't matter to them, so they run side by side on
+    // the worker pool. Hooks are committed once everything else is done, so no worker is mid-fix when threads freeze.
+    WorkerPool = std::make_unique<ThreadPool>((std::max)(iScanThreads, 0));
+    TaskGraph startup;
+    auto scan = startup.Add("ScanSignatures", ScanSignatures);
+    auto stats = startup.Add("HookStatistics", HookStatistics);
+    auto start = [](Fix& fix)
+    {
+        return [&fix]
+        {
+            if (fix.enabled)
+                fix.Apply(Hooks, true);
+        };
+    };
+    auto current = startup.Add("CurrentResolution", CurrentResolution, { scan, stats });
+    auto introSkip = startup.Add("IntroSkip", start(SkipIntroFix), { scan });
+    // Swaps the callback of the current resolution hook.
+    auto resolution = startup.Add("Resolution", start(ResolutionFix), { current });
+    auto aspectRatio = startup.Add("AspectRatio", start(AspectRatioFix), { scan, stats });
+    auto fov = startup.Add("FOV", start(FOVFix), { scan, stats });
+    auto movies = startup.Add("Movies", start(HUDFix), { scan, stats });
+    //auto hud = startup.Add("HUD", [] { HUD(HUDFix); }, { scan, stats });
+    auto install = startup.Add("InstallHooks", []
+    {
+        // Every hook was reset, so the fixes go back to unbuilt and a later reload can try them again.
+        if (!InstallHooks()) {
+            for (auto fix : Fixes) {
+                if (fix->built)
+                    fix->Discard();
+            }
+        }
+        // Catches a resolution change that landed between adding the hooks and installing them.
+        SelectHandlers();
+    }, { current, introSkip, resolution, aspectRatio, fov, movies });
+    startup.Run(WorkerPool.get(), AttachTime);
+    WorkerPool.reset();
+
+    for (const auto& task : startup.Tasks()) {
+        spdlog::info("Startup: {}: {:.3f}ms, started {:.3f}ms after attach.", task.name, task.duration, task.start);
+    }
+    const auto& installed = startup.Tasks()[install];
+    spdlog::info("Startup: Hooks live {:.3f}ms after attach.", installed.start + installed.duration);
+    WriteStartupTrace();
+
+    if (bConfigReload)
+    {
+        HANDLE watchHandle = CreateThread(NULL, 0, WatchConfig, 0, NULL, 0);
+        if (watchHandle)
+        {
+            CloseHandle(watchHandle);
+        }
+    }
     return true;
 }
 
@@ -594,6 +1123,12 @@ BOOL APIENTRY DllMain(HMODULE hModule,
     {
     case DLL_PROCESS_ATTACH:
     {
+        AttachTime = std::chrono::steady_clock::now();
+        Profiler::SetEpoch(AttachTime);
+        // Hooks, the log writer and the config watcher all run code in here until the game exits, so NMHFix
+        // can't be unloaded. Pinning makes a stray FreeLibrary harmless.
+        HMODULE pinned = NULL;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_PIN | GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS, (LPCWSTR)hModule, &pinned);
         HANDLE mainHandle = CreateThread(NULL, 0, Main, 0, NULL, 0);
         if (mainHandle)
         {
@@ -601,9 +1136,18 @@ BOOL APIENTRY DllMain(HMODULE hModule,
         }
         break;
     }
+    case DLL_PROCESS_DETACH:
+    {
+        // The DLL is pinned, so this is the process exiting. Hooks and patches are left as they are.
+        // Make sure everything queued reaches the log.
+        if (logSink)
+        {
+            logSink->Shutdown();
+        }
+        break;
+    }
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
-    case DLL_PROCESS_DETACH:
         break;
     }
     return TRUE;
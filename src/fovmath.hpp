@@ -0,0 +1,112 @@
+#pragma once
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+// FOV conversion for narrower than 16:9 aspect ratios: widens the vertical FOV so the horizontal FOV stays
+// what it would be at 16:9.
+//
+//   out = 2 * atan(tan(in / 2) * scale)      with scale = (16 / 9) / aspect ratio, angles in degrees
+//
+// Reference() is the original libm expression. Fast() avoids tan entirely by using
+//   atan(k * tan(h)) = h + atan((k - 1) * sin(h) * cos(h) / (cos(h)^2 + k * sin(h)^2))
+// with Cephes style minimax polynomials for sin, cos and atan, so it has no pole at 180 degrees.
+// Transform() puts a small per-thread memo in front of Fast() keyed on the input and the display epoch.
+//
+// Max error of Fast(), checked by tools/fovcheck over every float FOV in (0, 180) degrees for aspect ratios from
+// 16:10 down to 1:2: 6 ulp (3.1e-5 degrees) from Reference(), 5 ulp from the exact result. For comparison
+// Reference() itself is up to 4 ulp from exact. Inputs below 1.4e-36 degrees aren't covered.
+namespace FovMath
+{
+    constexpr float Pi = 3.14159265358979f;
+
+    // Original expression from the FOV hook.
+    inline float Reference(float fov, float aspectRatio, float nativeAspect)
+    {
+        return atanf(tanf(fov * (Pi / 360)) / aspectRatio * nativeAspect) * (360 / Pi);
+    }
+
+    namespace detail
+    {
+        // |x| <= pi/4
+        inline float SinPoly(float x)
+        {
+            float z = x * x;
+            return ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+        }
+
+        // |x| <= pi/4
+        inline float CosPoly(float x)
+        {
+            float z = x * x;
+            return ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+        }
+
+        // Full range, odd.
+        inline float Atan(float x)
+        {
+            float sign = x < 0 ? -1.0f : 1.0f;
+            x = fabsf(x);
+
+            float base = 0;
+            if (x > 2.414213562373095f) {
+                base = Pi / 2;
+                x = -1.0f / x;
+            }
+            else if (x > 0.4142135623730950f) {
+                base = Pi / 4;
+                x = (x - 1.0f) / (x + 1.0f);
+            }
+            float z = x * x;
+            float y = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * x + x;
+            return sign * (base + y);
+        }
+
+        // 0 <= h <= pi/2. Above pi/4 works from pi/2 - h, split into two parts so the subtraction is exact enough.
+        inline void SinCos(float h, float& s, float& c)
+        {
+            if (h <= Pi / 4) {
+                s = SinPoly(h);
+                c = CosPoly(h);
+            }
+            else {
+                float r = (1.5707963705062866f - h) - 4.3711388286737929e-8f;
+                s = CosPoly(r);
+                c = SinPoly(r);
+            }
+        }
+    }
+
+    // scale = nativeAspect / aspectRatio.
+    inline float Fast(float fov, float scale)
+    {
+        float h = fov * (Pi / 360);
+        float s, c;
+        detail::SinCos(h, s, c);
+        float delta = detail::Atan((scale - 1.0f) * s * c / (c * c + scale * s * s));
+        return (h + delta) * (360 / Pi);
+    }
+
+    // Fast() with a memo in front. The game feeds the same FOV in every frame, so almost every call is a hit and
+    // costs a compare. epoch must change whenever scale does.
+    inline float Transform(float fov, float scale, std::uint32_t epoch)
+    {
+        struct Entry
+        {
+            std::uint32_t input;
+            std::uint32_t epoch;
+            float output;
+        };
+        // A few entries so cutscene and gameplay cameras alternating doesn't thrash it.
+        thread_local Entry memo[4] = {};
+
+        auto input = std::bit_cast<std::uint32_t>(fov);
+        auto& entry = memo[(input ^ (input >> 13)) & 3];
+        if (entry.input == input && entry.epoch == epoch)
+            return entry.output;
+
+        entry = { input, epoch, Fast(fov, scale) };
+        return entry.output;
+    }
+}
@@ -1,4 +1,8 @@
 #include "stdafx.h"
+#include "pe.hpp"
+#include "scanner.hpp"
+#include "sigcache.hpp"
+#include "signatures.hpp"
 
 namespace Memory
 {
@@ -19,52 +23,245 @@ namespace Memory
         VirtualProtect((LPVOID)address, numBytes, oldProtect, &oldProtect);
     }
 
-    // CSGOSimple's pattern scan
-    // https://github.com/OneshotGH/CSGOSimple-master/blob/master/CSGOSimple/helpers/utils.cpp
-    std::uint8_t* PatternScan(void* module, const char* signature)
+    // Collects writes and applies them with one VirtualProtect round trip per page instead of two per write.
+    // The original bytes are kept so everything can be put back with Rollback(). Ranges passed to KeepWritable()
+    // are left writable after Commit() so hooks can update them with plain stores and no syscalls at all.
+    // Every member locks, so fixes can add patches from different threads.
+    class PatchSet
     {
-        static auto pattern_to_byte = [](const char* pattern) {
-            auto bytes = std::vector<int>{};
-            auto start = const_cast<char*>(pattern);
-            auto end = const_cast<char*>(pattern) + strlen(pattern);
-
-            for (auto current = start; current < end; ++current) {
-                if (*current == '?') {
-                    ++current;
-                    if (*current == '?')
-                        ++current;
-                    bytes.push_back(-1);
-                }
-                else {
-                    bytes.push_back(strtoul(current, &current, 16));
+    public:
+        template<typename T>
+        PatchSet& Write(uintptr_t address, T value)
+        {
+            return Bytes(address, &value, sizeof(T));
+        }
+
+        PatchSet& Bytes(uintptr_t address, const void* bytes, size_t size)
+        {
+            auto data = static_cast<const uint8_t*>(bytes);
+            std::scoped_lock lock(mutex);
+            patches.push_back({ address, std::vector<uint8_t>(data, data + size), {} });
+            return *this;
+        }
+
+        PatchSet& KeepWritable(uintptr_t address, size_t size)
+        {
+            std::scoped_lock lock(mutex);
+            for (auto page = PageOf(address); page < address + size; page += PageSize())
+                pages[page].keepWritable = true;
+            return *this;
+        }
+
+        // Applies every pending write. Returns false if a page couldn't be made writable, in which case
+        // nothing on that page is written.
+        bool Commit()
+        {
+            std::scoped_lock lock(mutex);
+            for (const auto& patch : patches) {
+                for (auto page = PageOf(patch.address); page < patch.address + patch.bytes.size(); page += PageSize())
+                    pages[page];
+            }
+
+            bool ok = true;
+            for (auto& [page, state] : pages) {
+                if (!state.writable) {
+                    ok &= Unprotect(page, state);
                 }
             }
-            return bytes;
-            };
 
-        auto dosHeader = (PIMAGE_DOS_HEADER)module;
-        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
+            bool flush = false;
+            for (auto& patch : patches) {
+                if (patch.applied || !Writable(patch.address, patch.bytes.size()))
+                    continue;
+                patch.original.resize(patch.bytes.size());
+                memcpy(patch.original.data(), (void*)patch.address, patch.bytes.size());
+                memcpy((void*)patch.address, patch.bytes.data(), patch.bytes.size());
+                patch.applied = true;
+                flush |= pages[PageOf(patch.address)].executable;
+            }
 
-        auto sizeOfImage = ntHeaders->OptionalHeader.SizeOfImage;
-        auto patternBytes = pattern_to_byte(signature);
-        auto scanBytes = reinterpret_cast<std::uint8_t*>(module);
+            Reprotect(false);
+            if (flush)
+                FlushInstructionCache(GetCurrentProcess(), NULL, 0);
+            return ok;
+        }
 
-        auto s = patternBytes.size();
-        auto d = patternBytes.data();
+        // Restores the original bytes of every applied write, newest first, and the original protection
+        // of every page including the ones kept writable.
+        void Rollback()
+        {
+            std::scoped_lock lock(mutex);
+            Restore();
+            Reprotect(true);
+            FlushInstructionCache(GetCurrentProcess(), NULL, 0);
+            patches.clear();
+            pages.clear();
+        }
 
-        for (auto i = 0ul; i < sizeOfImage - s; ++i) {
-            bool found = true;
-            for (auto j = 0ul; j < s; ++j) {
-                if (scanBytes[i + j] != d[j] && d[j] != -1) {
-                    found = false;
+        // Restores the original bytes like Rollback(), but keeps the writes so the next Commit() applies them
+        // again. Pages kept writable stay that way.
+        void Revert()
+        {
+            std::scoped_lock lock(mutex);
+            Restore();
+            Reprotect(false);
+            FlushInstructionCache(GetCurrentProcess(), NULL, 0);
+        }
+
+        size_t Size() const
+        {
+            std::scoped_lock lock(mutex);
+            return patches.size();
+        }
+
+    private:
+        struct Patch
+        {
+            uintptr_t address;
+            std::vector<uint8_t> bytes;
+            std::vector<uint8_t> original;
+            bool applied = false;
+        };
+
+        struct Page
+        {
+            DWORD oldProtect = 0;
+            bool writable = false;
+            bool executable = false;
+            bool keepWritable = false;
+        };
+
+        std::vector<Patch> patches;
+        std::map<uintptr_t, Page> pages;
+        mutable std::mutex mutex;   // fixes set up patches from several startup tasks at once
+
+        static uintptr_t PageSize()
+        {
+            static const uintptr_t size = [] {
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return (uintptr_t)info.dwPageSize;
+            }();
+            return size;
+        }
+
+        static uintptr_t PageOf(uintptr_t address)
+        {
+            return address & ~(PageSize() - 1);
+        }
+
+        bool Writable(uintptr_t address, size_t size)
+        {
+            for (auto page = PageOf(address); page < address + size; page += PageSize()) {
+                if (!pages[page].writable)
+                    return false;
+            }
+            return true;
+        }
+
+        void Restore()
+        {
+            for (auto& [page, state] : pages) {
+                if (!state.writable)
+                    Unprotect(page, state);
+            }
+
+            for (auto patch = patches.rbegin(); patch != patches.rend(); ++patch) {
+                if (!patch->applied || !Writable(patch->address, patch->bytes.size()))
+                    continue;
+                memcpy((void*)patch->address, patch->original.data(), patch->original.size());
+                patch->applied = false;
+            }
+        }
+
+        bool Unprotect(uintptr_t page, Page& state)
+        {
+            MEMORY_BASIC_INFORMATION mbi;
+            if (!VirtualQuery((LPCVOID)page, &mbi, sizeof(mbi)) || mbi.State != MEM_COMMIT)
+                return false;
+
+            constexpr DWORD executable = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+            state.executable = (mbi.Protect & executable) != 0;
+            if (!VirtualProtect((LPVOID)page, PageSize(), state.executable ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE, &state.oldProtect))
+                return false;
+            state.writable = true;
+            return true;
+        }
+
+        void Reprotect(bool all)
+        {
+            for (auto& [page, state] : pages) {
+                if (!state.writable || (state.keepWritable && !all))
+                    continue;
+                DWORD unused;
+                VirtualProtect((LPVOID)page, PageSize(), state.oldProtect, &unused);
+                state.writable = false;
+            }
+        }
+    };
+
+    // Builds the list of section ranges worth scanning, trimmed to committed, readable pages so that
+    // packed or partially mapped images can't fault the scanner. Headers, .rsrc, .reloc and gaps are skipped.
+    std::vector<Scanner::Span> ImageSpans(void* module)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        auto dosHeader = (PIMAGE_DOS_HEADER)module;
+        auto ntHeaders = (PIMAGE_NT_HEADERS)(base + dosHeader->e_lfanew);
+        auto headers = Pe::Parse(base, ntHeaders->OptionalHeader.SizeOfHeaders);
+
+        std::vector<Scanner::Span> spans;
+        for (const auto& section : headers.sections) {
+            bool code = section.IsCode();
+            bool data = section.IsData();
+            if (!code && !data)
+                continue;
+
+            auto current = base + section.virtualAddress;
+            auto end = current + section.virtualSize;
+            std::uint8_t* runStart = nullptr;
+            while (current < end) {
+                MEMORY_BASIC_INFORMATION mbi;
+                if (!VirtualQuery(current, &mbi, sizeof(mbi)))
                     break;
+
+                auto regionEnd = (std::min)(end, (std::uint8_t*)mbi.BaseAddress + mbi.RegionSize);
+                constexpr DWORD readable = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+                bool ok = mbi.State == MEM_COMMIT && (mbi.Protect & readable) && !(mbi.Protect & PAGE_GUARD);
+
+                if (ok && !runStart) {
+                    runStart = current;
                 }
+                else if (!ok && runStart) {
+                    spans.push_back({ runStart, (size_t)(current - runStart), code, data });
+                    runStart = nullptr;
+                }
+                current = regionEnd;
             }
-            if (found) {
-                return &scanBytes[i];
+            if (runStart) {
+                spans.push_back({ runStart, (size_t)(current - runStart), code, data });
             }
         }
-        return nullptr;
+        return spans;
+    }
+
+    // Scans the sections a signature can live in (executable sections by default). Engine::Scalar is the
+    // original byte-by-byte loop, the SIMD engines anchor on the rarest fixed byte and must always return
+    // the same address.
+    std::uint8_t* PatternScan(void* module, const Scanner::Signature& signature, Scanner::Region region = Scanner::Region::Code, Scanner::Engine engine = Scanner::Engine::Auto)
+    {
+        return const_cast<std::uint8_t*>(Scanner::Find(ImageSpans(module), signature.pattern, region, engine));
+    }
+
+    // Runs every unresolved signature in the batch over the sections it can live in, in a single pass.
+    // With a pool the sections are split into chunks that are scanned in parallel.
+    // Returns false if there was nothing left to scan for. Either way the batch is pointed at the module, so
+    // Find() can follow operands out of the matches.
+    bool BatchScan(void* module, Scanner::Batch& batch, ThreadPool* pool = nullptr)
+    {
+        auto base = reinterpret_cast<std::uint8_t*>(module);
+        auto ntHeaders = (PIMAGE_NT_HEADERS)(base + ((PIMAGE_DOS_HEADER)module)->e_lfanew);
+        batch.SetModule({ base, ntHeaders->OptionalHeader.SizeOfImage, reinterpret_cast<std::uintptr_t>(module) });
+        return batch.Run(ImageSpans(module), pool);
     }
 
     static HMODULE GetThisDllHandle()
@@ -81,6 +278,13 @@ namespace Memory
         auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
         return ntHeaders->FileHeader.TimeDateStamp;
     }
+
+    uint32_t ModuleSize(void* module)
+    {
+        auto dosHeader = (PIMAGE_DOS_HEADER)module;
+        auto ntHeaders = (PIMAGE_NT_HEADERS)((std::uint8_t*)module + dosHeader->e_lfanew);
+        return ntHeaders->OptionalHeader.SizeOfImage;
+    }
 }
 
 namespace Util
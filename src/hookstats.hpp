@@ -0,0 +1,235 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include <safetyhook.hpp>
+
+// Opt-in call counters and latency histograms for the mid hooks.
+//
+// When enabled, every callback passed through Wrap() is called from a small thunk that counts the call and
+// times it with the TSC. The numbers live in a named shared memory block (BlockName) so an external tool can
+// open it and read them while the game is running. When disabled, Wrap() hands back the callback untouched
+// and the hook calls it directly, so there is no overhead at all.
+//
+// Each hook keeps one slot per thread, so a thread only ever writes to its own cache lines. Threads past
+// MaxThreads - 1 share the last slot, which is updated with atomic adds instead.
+namespace HookStats
+{
+    constexpr const char* BlockName = "Local\\NMHFix_HookStats";
+    constexpr std::uint32_t Magic = 0x53484D4E;     // "NMHS"
+    constexpr std::uint32_t Version = 1;
+    constexpr std::size_t MaxHooks = 32;
+    constexpr std::size_t MaxThreads = 8;
+    constexpr std::size_t Buckets = 32;             // bucket i counts calls that took less than 2^i ticks (and at least 2^(i-1))
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free);
+
+    struct alignas(64) Slot
+    {
+        std::atomic<std::uint64_t> calls;
+        std::atomic<std::uint64_t> ticks;
+        std::atomic<std::uint64_t> histogram[Buckets];
+    };
+
+    struct Hook
+    {
+        char name[48];
+        Slot slots[MaxThreads];
+    };
+
+    // Layout of the shared memory block. Readers should check magic and version before trusting the rest,
+    // and only look at the first hookCount hooks.
+    struct Block
+    {
+        std::uint32_t magic;
+        std::uint32_t version;
+        std::uint32_t maxHooks;
+        std::uint32_t maxThreads;
+        std::uint32_t buckets;
+        std::atomic<std::uint32_t> hookCount;
+        std::uint64_t ticksPerSecond;
+        Hook hooks[MaxHooks];
+    };
+
+    namespace detail
+    {
+        inline Block* block = nullptr;
+        inline std::atomic<std::uint32_t> nextThread{ 0 };
+        inline std::mutex wrapMutex;      // hooks are set up from several startup tasks at once
+        // Stored type-erased, each thunk casts back to the callback type it was instantiated for. Atomic because
+        // Rebind() can replace them while the hooks are running.
+        inline std::atomic<void (*)()> callbacks[MaxHooks];
+
+        inline void Record(std::size_t hook, std::uint64_t ticks)
+        {
+            thread_local std::uint32_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+            auto index = thread < MaxThreads ? thread : MaxThreads - 1;
+            auto& slot = block->hooks[hook].slots[index];
+            auto bucket = (std::min)(static_cast<std::size_t>(std::bit_width(ticks)), Buckets - 1);
+
+            if (thread < MaxThreads - 1) {
+                // Only this thread writes here, a plain load and store is enough.
+                slot.calls.store(slot.calls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                slot.ticks.store(slot.ticks.load(std::memory_order_relaxed) + ticks, std::memory_order_relaxed);
+                slot.histogram[bucket].store(slot.histogram[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            else {
+                slot.calls.fetch_add(1, std::memory_order_relaxed);
+                slot.ticks.fetch_add(ticks, std::memory_order_relaxed);
+                slot.histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        template<typename Context, std::size_t Index>
+        void Thunk(Context& ctx)
+        {
+            auto start = __rdtsc();
+            reinterpret_cast<void (*)(Context&)>(callbacks[Index].load(std::memory_order_acquire))(ctx);
+            Record(Index, __rdtsc() - start);
+        }
+
+        template<typename Context, std::size_t... Index>
+        constexpr std::array<void (*)(Context&), MaxHooks> MakeThunks(std::index_sequence<Index...>)
+        {
+            return { &Thunk<Context, Index>... };
+        }
+
+        // Context is SafetyHookContext or a LiteHook::Context.
+        template<typename Context>
+        inline constexpr auto thunks = MakeThunks<Context>(std::make_index_sequence<MaxHooks>{});
+    }
+
+    inline bool Enabled()
+    {
+        return detail::block != nullptr;
+    }
+
+    // Creates the shared memory block. Must be called before any hooks are wrapped.
+    inline bool Enable()
+    {
+        if (detail::block)
+            return true;
+
+        auto mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(Block), BlockName);
+        if (!mapping)
+            return false;
+        auto view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Block));
+        if (!view)
+            return false;
+        // The mapping handle is deliberately kept open for the life of the process.
+
+        auto block = static_cast<Block*>(view);
+        memset(block, 0, sizeof(Block));
+        block->version = Version;
+        block->maxHooks = MaxHooks;
+        block->maxThreads = MaxThreads;
+        block->buckets = Buckets;
+
+        // Calibrate the TSC against the performance counter so readers can turn ticks into time.
+        LARGE_INTEGER frequency, qpcStart, qpcEnd;
+        QueryPerformanceFrequency(&frequency);
+        QueryPerformanceCounter(&qpcStart);
+        auto tscStart = __rdtsc();
+        Sleep(20);
+        auto tscEnd = __rdtsc();
+        QueryPerformanceCounter(&qpcEnd);
+        block->ticksPerSecond = (tscEnd - tscStart) * frequency.QuadPart / (qpcEnd.QuadPart - qpcStart.QuadPart);
+
+        std::atomic_thread_fence(std::memory_order_release);
+        block->magic = Magic;
+        detail::block = block;
+        return true;
+    }
+
+    // Returns the callback to hand to the hook. If stats are disabled, or every slot is taken, that's
+    // the callback itself.
+    template<typename Context>
+    void (*Wrap(const char* name, void (*callback)(Context&)))(Context&)
+    {
+        if (!detail::block)
+            return callback;
+
+        std::scoped_lock lock(detail::wrapMutex);
+        auto index = detail::block->hookCount.load();
+        if (index >= MaxHooks)
+            return callback;
+
+        strncpy(detail::block->hooks[index].name, name, sizeof(Hook::name) - 1);
+        detail::callbacks[index].store(reinterpret_cast<void (*)()>(callback), std::memory_order_relaxed);
+        detail::block->hookCount.store(index + 1, std::memory_order_release);
+        return detail::thunks<Context>[index];
+    }
+
+    // Captureless lambdas.
+    template<typename Callback>
+    auto Wrap(const char* name, Callback callback)
+    {
+        return Wrap(name, +callback);
+    }
+
+    struct Totals
+    {
+        std::uint64_t calls = 0;
+        std::uint64_t ticks = 0;
+
+        double NanosecondsPerCall() const
+        {
+            if (!calls || !detail::block || !detail::block->ticksPerSecond)
+                return 0;
+            return static_cast<double>(ticks) * 1e9 / static_cast<double>(detail::block->ticksPerSecond) / static_cast<double>(calls);
+        }
+    };
+
+    // Every thread's counts for the hook wrapped as name added up. Zero if stats are off or there's no such hook.
+    inline Totals Sum(const char* name)
+    {
+        Totals totals;
+        if (!detail::block)
+            return totals;
+
+        auto count = detail::block->hookCount.load(std::memory_order_acquire);
+        for (std::uint32_t index = 0; index < count; ++index) {
+            const auto& hook = detail::block->hooks[index];
+            if (strncmp(hook.name, name, sizeof(Hook::name)) != 0)
+                continue;
+            for (const auto& slot : hook.slots) {
+                totals.calls += slot.calls.load(std::memory_order_relaxed);
+                totals.ticks += slot.ticks.load(std::memory_order_relaxed);
+            }
+        }
+        return totals;
+    }
+
+    // For hooks that swap callbacks: given what Wrap() returned for the hook, returns what the hook should call to
+    // run callback instead. When that's a thunk, the thunk is pointed at callback and keeps counting under the same
+    // name.
+    template<typename Context>
+    void (*Rebind(void (*wrapped)(Context&), void (*callback)(Context&)))(Context&)
+    {
+        if (!detail::block)
+            return callback;
+
+        auto count = detail::block->hookCount.load(std::memory_order_acquire);
+        for (std::uint32_t index = 0; index < count; ++index) {
+            if (detail::thunks<Context>[index] == wrapped) {
+                detail::callbacks[index].store(reinterpret_cast<void (*)()>(callback), std::memory_order_release);
+                return wrapped;
+            }
+        }
+        return callback;
+    }
+}
@@ -0,0 +1,370 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+#include <safetyhook.hpp>
+
+// Mid hooks that only save the registers their callback uses.
+//
+// safetyhook's MidHook stub saves and restores every general purpose register, the flags and every XMM register
+// on every call to build a full SafetyHookContext. LiteHook::MidHook<Regs> instead uses a stub generated at compile
+// time for the register set Regs. The stub saves those registers, plus the ones the callback is allowed to clobber
+// under its calling convention (scratch GPRs, flags, scratch XMM), into a Context<Regs>, and restores them
+// afterwards. Callee-saved registers that aren't named are left alone, because the compiled callback preserves
+// them anyway. Only the named registers can be accessed through the context. Using any other register is a
+// compile error. The callback can be swapped with SetCallback() while the hook is live.
+//
+// On 32-bit every XMM register is scratch, so the saving there comes from the general purpose registers and from
+// skipping the bookkeeping that a full context carries.
+namespace LiteHook
+{
+    using Registers = std::uint64_t;
+
+    // Bit n is GPR n in encoding order, then the flags, then XMM n from bit 32.
+    enum : Registers
+    {
+#if SAFETYHOOK_ARCH_X86_32
+        Eax = 1ull << 0, Ecx = 1ull << 1, Edx = 1ull << 2, Ebx = 1ull << 3,
+        Esp = 1ull << 4, Ebp = 1ull << 5, Esi = 1ull << 6, Edi = 1ull << 7,
+#else
+        Rax = 1ull << 0, Rcx = 1ull << 1, Rdx = 1ull << 2, Rbx = 1ull << 3,
+        Rsp = 1ull << 4, Rbp = 1ull << 5, Rsi = 1ull << 6, Rdi = 1ull << 7,
+        R8 = 1ull << 8, R9 = 1ull << 9, R10 = 1ull << 10, R11 = 1ull << 11,
+        R12 = 1ull << 12, R13 = 1ull << 13, R14 = 1ull << 14, R15 = 1ull << 15,
+#endif
+        Flags = 1ull << 16,
+        Xmm0 = 1ull << 32, Xmm1 = 1ull << 33, Xmm2 = 1ull << 34, Xmm3 = 1ull << 35,
+        Xmm4 = 1ull << 36, Xmm5 = 1ull << 37, Xmm6 = 1ull << 38, Xmm7 = 1ull << 39,
+#if SAFETYHOOK_ARCH_X86_64
+        Xmm8 = 1ull << 40, Xmm9 = 1ull << 41, Xmm10 = 1ull << 42, Xmm11 = 1ull << 43,
+        Xmm12 = 1ull << 44, Xmm13 = 1ull << 45, Xmm14 = 1ull << 46, Xmm15 = 1ull << 47,
+#endif
+    };
+
+    namespace detail
+    {
+        constexpr Registers GprMask = 0xFFFFull;
+        constexpr Registers StackPointer = 1ull << 4;
+        constexpr Registers XmmMask = 0xFFFFull << 32;
+
+#if SAFETYHOOK_ARCH_X86_32
+        // cdecl
+        constexpr Registers Scratch = Eax | Ecx | Edx | (0xFFull << 32);
+        constexpr Registers StubUses = 0;
+#elif SAFETYHOOK_OS_WINDOWS
+        // rbx holds the context pointer across the call.
+        constexpr Registers Scratch = Rax | Rcx | Rdx | R8 | R9 | R10 | R11 | (0x3Full << 32);
+        constexpr Registers StubUses = Rbx;
+#else
+        constexpr Registers Scratch = Rax | Rcx | Rdx | Rsi | Rdi | R8 | R9 | R10 | R11 | (0xFFFFull << 32);
+        constexpr Registers StubUses = Rbx;
+#endif
+
+        // Everything the stub saves for a callback using regs. The stack pointer is worked out from where the
+        // context is instead.
+        constexpr Registers Saved(Registers regs)
+        {
+            return (regs | Scratch | StubUses | Flags) & ~StackPointer;
+        }
+
+        constexpr std::size_t CountBelow(Registers set, Registers bit)
+        {
+            return static_cast<std::size_t>(std::popcount(set & (bit - 1)));
+        }
+
+        struct StubCode
+        {
+            std::array<std::uint8_t, 512> bytes{};
+            std::size_t size = 0;
+            std::size_t callbackOffset = 0;    // pointer aligned slot the call goes through
+            std::size_t callbackReference = 0; // 32-bit: the call's absolute address of that slot
+            std::size_t resumeOffset = 0;      // 32-bit: rel32 of the jmp. 64-bit: absolute address.
+
+            constexpr void Emit(std::initializer_list<std::uint8_t> code)
+            {
+                for (auto byte : code)
+                    bytes[size++] = byte;
+            }
+
+            constexpr void Emit32(std::uint32_t value)
+            {
+                Emit({ static_cast<std::uint8_t>(value), static_cast<std::uint8_t>(value >> 8),
+                    static_cast<std::uint8_t>(value >> 16), static_cast<std::uint8_t>(value >> 24) });
+            }
+
+            constexpr void Align(std::size_t alignment)
+            {
+                while (size % alignment)
+                    Emit({ 0xCC });
+            }
+
+            constexpr void EmitRexW()
+            {
+#if SAFETYHOOK_ARCH_X86_64
+                Emit({ 0x48 });
+#endif
+            }
+
+            // movdqu [esp + offset], xmm (store) or movdqu xmm, [esp + offset] (load)
+            constexpr void EmitMovdqu(bool store, int xmm, std::uint32_t offset)
+            {
+                Emit({ 0xF3 });
+                if (xmm >= 8)
+                    Emit({ 0x44 });
+                Emit({ 0x0F, static_cast<std::uint8_t>(store ? 0x7F : 0x6F), static_cast<std::uint8_t>(0x84 | ((xmm & 7) << 3)), 0x24 });
+                Emit32(offset);
+            }
+        };
+
+        constexpr StubCode BuildStub(Registers saved)
+        {
+            StubCode code;
+            const auto xmmBytes = static_cast<std::uint32_t>(std::popcount(saved & XmmMask) * 16);
+
+            // Lowest addresses first, the context is: saved XMM registers, saved GPRs, flags.
+            code.Emit({ 0x9C });                                    // pushf
+            for (int gpr = 15; gpr >= 0; --gpr) {
+                if (!(saved & (1ull << gpr)))
+                    continue;
+                if (gpr >= 8)
+                    code.Emit({ 0x41 });
+                code.Emit({ static_cast<std::uint8_t>(0x50 + (gpr & 7)) }); // push gpr
+            }
+            if (xmmBytes) {
+                code.EmitRexW();
+                code.Emit({ 0x81, 0xEC });                          // sub esp, xmmBytes
+                code.Emit32(xmmBytes);
+                std::uint32_t offset = 0;
+                for (int xmm = 0; xmm < 16; ++xmm) {
+                    if (saved & (1ull << (32 + xmm))) {
+                        code.EmitMovdqu(true, xmm, offset);
+                        offset += 16;
+                    }
+                }
+            }
+
+#if SAFETYHOOK_ARCH_X86_32
+            code.Emit({ 0x54 });                                    // push esp
+            code.Emit({ 0xFF, 0x15 });                              // call [callback]
+            code.callbackReference = code.size;
+            code.Emit32(0);
+            code.Emit({ 0x83, 0xC4, 0x04 });                        // add esp, 4
+#else
+            code.Emit({ 0x48, 0x89, 0xE3 });                        // mov rbx, rsp
+            code.Emit({ 0x48, 0x83, 0xE4, 0xF0 });                  // and rsp, -16
+#if SAFETYHOOK_OS_WINDOWS
+            code.Emit({ 0x48, 0x83, 0xEC, 0x20 });                  // sub rsp, 32
+            code.Emit({ 0x48, 0x89, 0xD9 });                        // mov rcx, rbx
+#else
+            code.Emit({ 0x48, 0x89, 0xDF });                        // mov rdi, rbx
+#endif
+            code.Emit({ 0xFF, 0x15 });                              // call [rip + callback]
+            const auto callDisplacement = code.size;
+            code.Emit32(0);
+            code.Emit({ 0x48, 0x89, 0xDC });                        // mov rsp, rbx
+#endif
+
+            if (xmmBytes) {
+                std::uint32_t offset = 0;
+                for (int xmm = 0; xmm < 16; ++xmm) {
+                    if (saved & (1ull << (32 + xmm))) {
+                        code.EmitMovdqu(false, xmm, offset);
+                        offset += 16;
+                    }
+                }
+                code.EmitRexW();
+                code.Emit({ 0x81, 0xC4 });                          // add esp, xmmBytes
+                code.Emit32(xmmBytes);
+            }
+            for (int gpr = 0; gpr < 16; ++gpr) {
+                if (!(saved & (1ull << gpr)))
+                    continue;
+                if (gpr >= 8)
+                    code.Emit({ 0x41 });
+                code.Emit({ static_cast<std::uint8_t>(0x58 + (gpr & 7)) }); // pop gpr
+            }
+            code.Emit({ 0x9D });                                    // popf
+
+#if SAFETYHOOK_ARCH_X86_32
+            code.Emit({ 0xE9 });                                    // jmp trampoline
+            code.resumeOffset = code.size;
+            code.Emit32(0);
+            code.Align(4);
+            code.callbackOffset = code.size;
+            code.size += 4;
+#else
+            code.Emit({ 0xFF, 0x25 });                              // jmp [rip + 0]
+            code.Emit32(0);
+            code.resumeOffset = code.size;
+            code.size += 8;
+            code.Align(8);
+            code.callbackOffset = code.size;
+            code.size += 8;
+            auto displacement = static_cast<std::uint32_t>(code.callbackOffset - (callDisplacement + 4));
+            code.bytes[callDisplacement] = static_cast<std::uint8_t>(displacement);
+            code.bytes[callDisplacement + 1] = static_cast<std::uint8_t>(displacement >> 8);
+            code.bytes[callDisplacement + 2] = static_cast<std::uint8_t>(displacement >> 16);
+            code.bytes[callDisplacement + 3] = static_cast<std::uint8_t>(displacement >> 24);
+#endif
+            return code;
+        }
+
+        // Points the jump at offset in the stub at address.
+        inline void Link(std::uint8_t* stub, std::size_t offset, const void* address)
+        {
+#if SAFETYHOOK_ARCH_X86_32
+            auto relative = reinterpret_cast<std::uintptr_t>(address) - reinterpret_cast<std::uintptr_t>(stub + offset + 4);
+            memcpy(stub + offset, &relative, sizeof(relative));
+#else
+            memcpy(stub + offset, &address, sizeof(address));
+#endif
+        }
+    }
+
+    // The registers saved for a callback using Regs, laid out by its stub. Never constructed, the callback gets a
+    // reference to the stub's stack frame.
+    template<Registers Regs>
+    class Context
+    {
+    public:
+        static constexpr Registers Saved = detail::Saved(Regs);
+        static constexpr std::size_t XmmBytes = std::popcount(Saved & detail::XmmMask) * 16;
+        static constexpr std::size_t Size = XmmBytes + (std::popcount(Saved & detail::GprMask) + 1) * sizeof(std::uintptr_t);
+
+        Context() = delete;
+        Context(const Context&) = delete;
+
+#if SAFETYHOOK_ARCH_X86_32
+        std::uintptr_t& eax() requires((Regs & Eax) != 0) { return Gpr<Eax>(); }
+        std::uintptr_t& ecx() requires((Regs & Ecx) != 0) { return Gpr<Ecx>(); }
+        std::uintptr_t& edx() requires((Regs & Edx) != 0) { return Gpr<Edx>(); }
+        std::uintptr_t& ebx() requires((Regs & Ebx) != 0) { return Gpr<Ebx>(); }
+        std::uintptr_t& ebp() requires((Regs & Ebp) != 0) { return Gpr<Ebp>(); }
+        std::uintptr_t& esi() requires((Regs & Esi) != 0) { return Gpr<Esi>(); }
+        std::uintptr_t& edi() requires((Regs & Edi) != 0) { return Gpr<Edi>(); }
+
+        // Stack pointer at the hook site. Read-only.
+        std::uintptr_t esp() const requires((Regs & Esp) != 0) { return reinterpret_cast<std::uintptr_t>(this) + Size; }
+#else
+        std::uintptr_t& rax() requires((Regs & Rax) != 0) { return Gpr<Rax>(); }
+        std::uintptr_t& rcx() requires((Regs & Rcx) != 0) { return Gpr<Rcx>(); }
+        std::uintptr_t& rdx() requires((Regs & Rdx) != 0) { return Gpr<Rdx>(); }
+        std::uintptr_t& rbx() requires((Regs & Rbx) != 0) { return Gpr<Rbx>(); }
+        std::uintptr_t& rbp() requires((Regs & Rbp) != 0) { return Gpr<Rbp>(); }
+        std::uintptr_t& rsi() requires((Regs & Rsi) != 0) { return Gpr<Rsi>(); }
+        std::uintptr_t& rdi() requires((Regs & Rdi) != 0) { return Gpr<Rdi>(); }
+        std::uintptr_t& r8() requires((Regs & R8) != 0) { return Gpr<R8>(); }
+        std::uintptr_t& r9() requires((Regs & R9) != 0) { return Gpr<R9>(); }
+        std::uintptr_t& r10() requires((Regs & R10) != 0) { return Gpr<R10>(); }
+        std::uintptr_t& r11() requires((Regs & R11) != 0) { return Gpr<R11>(); }
+        std::uintptr_t& r12() requires((Regs & R12) != 0) { return Gpr<R12>(); }
+        std::uintptr_t& r13() requires((Regs & R13) != 0) { return Gpr<R13>(); }
+        std::uintptr_t& r14() requires((Regs & R14) != 0) { return Gpr<R14>(); }
+        std::uintptr_t& r15() requires((Regs & R15) != 0) { return Gpr<R15>(); }
+
+        // Stack pointer at the hook site. Read-only.
+        std::uintptr_t rsp() const requires((Regs & Rsp) != 0) { return reinterpret_cast<std::uintptr_t>(this) + Size; }
+#endif
+
+        std::uintptr_t& flags() requires((Regs & Flags) != 0)
+        {
+            return *reinterpret_cast<std::uintptr_t*>(frame + Size - sizeof(std::uintptr_t));
+        }
+
+        // ctx.xmm<0>().f32[0]
+        template<int N>
+        safetyhook::Xmm& xmm() requires((Regs & (Xmm0 << N)) != 0)
+        {
+            return *reinterpret_cast<safetyhook::Xmm*>(frame + detail::CountBelow(Saved & detail::XmmMask, Xmm0 << N) * 16);
+        }
+
+    private:
+        std::uint8_t frame[Size];
+
+        template<Registers Bit>
+        std::uintptr_t& Gpr()
+        {
+            return *reinterpret_cast<std::uintptr_t*>(frame + XmmBytes + detail::CountBelow(Saved & detail::GprMask, Bit) * sizeof(std::uintptr_t));
+        }
+    };
+
+    template<Registers Regs>
+    class MidHook
+    {
+    public:
+        using Context = LiteHook::Context<Regs>;
+        using Callback = void (*)(Context& ctx);
+
+        static constexpr detail::StubCode Code = detail::BuildStub(Context::Saved);
+
+        // Writes the stub for callback to stub (Code.size bytes, pointer aligned), resuming at resume when it's done.
+        static void Build(std::uint8_t* stub, Callback callback, const void* resume)
+        {
+            memcpy(stub, Code.bytes.data(), Code.size);
+#if SAFETYHOOK_ARCH_X86_32
+            auto slot = stub + Code.callbackOffset;
+            memcpy(stub + Code.callbackReference, &slot, sizeof(slot));
+#endif
+            SetCallback(stub, callback);
+            detail::Link(stub, Code.resumeOffset, resume);
+        }
+
+        // Points a built stub at a different callback. Threads already inside the old callback finish it, every
+        // call after the store gets the new one.
+        static void SetCallback(std::uint8_t* stub, Callback callback)
+        {
+            std::atomic_ref(*reinterpret_cast<std::uintptr_t*>(stub + Code.callbackOffset))
+                .store(reinterpret_cast<std::uintptr_t>(callback), std::memory_order_release);
+        }
+
+        // Builds the stub and adds the hook to batch. It goes live when the batch is committed, which also reports
+        // any failure to create the hook. Returns false, without touching the batch, if there was no memory for the
+        // stub.
+        bool Add(safetyhook::HookBatch& batch, void* target, Callback callback)
+        {
+            auto allocation = safetyhook::Allocator::global()->allocate_fixed(Code.size);
+            if (!allocation)
+                return false;
+            stub = std::move(*allocation);
+
+            batch.add(hook, target, stub.data());
+            if (!hook)
+                return false;
+            Build(stub.data(), callback, hook.trampoline().data());
+            return true;
+        }
+
+        void SetCallback(Callback callback)
+        {
+            if (hook)
+                SetCallback(stub.data(), callback);
+        }
+
+        // Queue the hook to be switched on or off by the batch's next commit(). The stub stays allocated while the
+        // hook is off, so switching it back on doesn't rebuild anything.
+        void Enable(safetyhook::HookBatch& batch)
+        {
+            if (hook)
+                batch.enable(hook);
+        }
+
+        void Disable(safetyhook::HookBatch& batch)
+        {
+            if (hook)
+                batch.disable(hook);
+        }
+
+        explicit operator bool() const { return static_cast<bool>(hook); }
+
+    private:
+        // Declared first so the hook is removed before the stub is freed.
+        safetyhook::Allocation stub;
+        safetyhook::InlineHook hook;
+    };
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Minimal PE header parsing that works on a loaded module or a mapped file image.
+// Kept free of windows.h so the scanner can share it on Linux.
+namespace Pe
+{
+    constexpr std::uint16_t DosSignature = 0x5A4D;      // MZ
+    constexpr std::uint32_t NtSignature = 0x00004550;   // PE\0\0
+
+    constexpr std::uint32_t ScnCntCode = 0x00000020;
+    constexpr std::uint32_t ScnCntInitializedData = 0x00000040;
+    constexpr std::uint32_t ScnCntUninitializedData = 0x00000080;
+    constexpr std::uint32_t ScnMemDiscardable = 0x02000000;
+    constexpr std::uint32_t ScnMemExecute = 0x20000000;
+    constexpr std::uint32_t ScnMemRead = 0x40000000;
+    constexpr std::uint32_t ScnMemWrite = 0x80000000;
+
+    struct Section
+    {
+        std::string name;
+        std::uint32_t virtualAddress = 0;
+        std::uint32_t virtualSize = 0;
+        std::uint32_t rawOffset = 0;
+        std::uint32_t rawSize = 0;
+        std::uint32_t characteristics = 0;
+
+        bool IsCode() const { return (characteristics & (ScnMemExecute | ScnCntCode)) != 0; }
+
+        // .rdata/.data style sections: initialised, readable, not code. Resources and relocations are skipped.
+        bool IsData() const
+        {
+            return !IsCode() && (characteristics & ScnCntInitializedData) && (characteristics & ScnMemRead) &&
+                !(characteristics & ScnMemDiscardable) && name != ".rsrc";
+        }
+    };
+
+    struct Headers
+    {
+        bool valid = false;
+        bool is64 = false;
+        std::uint16_t machine = 0;
+        std::uint32_t timestamp = 0;
+        std::uint32_t sizeOfImage = 0;
+        std::uint32_t sizeOfHeaders = 0;
+        std::uint64_t imageBase = 0;
+        std::vector<Section> sections;
+    };
+
+    template<typename T>
+    inline T Read(const std::uint8_t* p)
+    {
+        T value;
+        memcpy(&value, p, sizeof(T));
+        return value;
+    }
+
+    // Parses the headers at the start of an image. size is how many bytes are readable from base,
+    // which for a loaded module only needs to cover the headers.
+    inline Headers Parse(const std::uint8_t* base, std::size_t size)
+    {
+        Headers headers;
+        if (size < 0x40 || Read<std::uint16_t>(base) != DosSignature)
+            return headers;
+
+        auto ntOffset = Read<std::uint32_t>(base + 0x3C);
+        if (ntOffset > size || size - ntOffset < 24 || Read<std::uint32_t>(base + ntOffset) != NtSignature)
+            return headers;
+
+        auto fileHeader = base + ntOffset + 4;
+        headers.machine = Read<std::uint16_t>(fileHeader);
+        auto numberOfSections = Read<std::uint16_t>(fileHeader + 2);
+        headers.timestamp = Read<std::uint32_t>(fileHeader + 4);
+        auto sizeOfOptionalHeader = Read<std::uint16_t>(fileHeader + 16);
+
+        auto optionalHeader = fileHeader + 20;
+        auto sectionTable = optionalHeader + sizeOfOptionalHeader;
+        if (static_cast<std::size_t>(sectionTable - base) + numberOfSections * 40ull > size)
+            return headers;
+
+        auto magic = Read<std::uint16_t>(optionalHeader);
+        headers.is64 = magic == 0x20B;
+        headers.imageBase = headers.is64 ? Read<std::uint64_t>(optionalHeader + 24) : Read<std::uint32_t>(optionalHeader + 28);
+        headers.sizeOfImage = Read<std::uint32_t>(optionalHeader + 56);
+        headers.sizeOfHeaders = Read<std::uint32_t>(optionalHeader + 60);
+
+        for (std::uint16_t i = 0; i < numberOfSections; ++i) {
+            auto entry = sectionTable + i * 40;
+            Section section;
+            char name[9] = {};
+            memcpy(name, entry, 8);
+            section.name = name;
+            section.virtualSize = Read<std::uint32_t>(entry + 8);
+            section.virtualAddress = Read<std::uint32_t>(entry + 12);
+            section.rawSize = Read<std::uint32_t>(entry + 16);
+            section.rawOffset = Read<std::uint32_t>(entry + 20);
+            section.characteristics = Read<std::uint32_t>(entry + 36);
+            // Some linkers leave VirtualSize at zero.
+            if (section.virtualSize == 0)
+                section.virtualSize = section.rawSize;
+            headers.sections.push_back(section);
+        }
+
+        headers.valid = true;
+        return headers;
+    }
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Scoped timers for startup, written out as a Chrome trace-event file (chrome://tracing, ui.perfetto.dev).
+//
+// A Scope records one complete event (name, start, duration) when it ends. Each thread claims a fixed buffer
+// from a static pool the first time it records, so recording never allocates or locks, and the buffers outlive
+// the threads, which matters for the worker pool. Threads past MaxThreads, and events past MaxEvents on a thread,
+// are dropped and counted. Recording is always on; it costs two clock reads and a copy per scope, so whether the
+// trace gets written is the only thing that's configurable.
+namespace Profiler
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t MaxThreads = 32;
+    constexpr std::size_t MaxEvents = 128;
+    constexpr std::size_t MaxName = 48;
+
+    struct Event
+    {
+        char name[MaxName];         // copied, so names built at runtime don't have to outlive the trace
+        const char* category;       // string literal
+        Clock::time_point start;
+        Clock::duration duration;
+    };
+
+    namespace detail
+    {
+        struct Buffer
+        {
+            Event events[MaxEvents];
+            std::atomic<std::size_t> count{ 0 };    // published with release once an event is complete
+            char threadName[MaxName] = {};
+        };
+
+        inline Buffer buffers[MaxThreads];
+        inline std::atomic<std::size_t> claimed{ 0 };
+        inline std::atomic<std::size_t> dropped{ 0 };
+        inline Clock::time_point epoch = Clock::now();
+
+        inline Buffer* ThisThread()
+        {
+            thread_local Buffer* buffer = nullptr;
+            thread_local bool full = false;
+            if (!buffer && !full) {
+                auto index = claimed.fetch_add(1, std::memory_order_relaxed);
+                if (index < MaxThreads)
+                    buffer = &buffers[index];
+                else
+                    full = true;
+            }
+            return buffer;
+        }
+
+        inline void Copy(char (&to)[MaxName], const char* from)
+        {
+            auto length = (std::min)(strlen(from), MaxName - 1);
+            memcpy(to, from, length);
+            to[length] = '\0';
+        }
+
+        inline void WriteString(std::ofstream& file, const char* text)
+        {
+            file << '"';
+            for (auto c = text; *c; ++c) {
+                if (*c == '"' || *c == '\\')
+                    file << '\\' << *c;
+                else if (static_cast<unsigned char>(*c) >= 0x20)
+                    file << *c;
+            }
+            file << '"';
+        }
+    }
+
+    // Times are written relative to this, e.g. the moment the DLL was attached.
+    inline void SetEpoch(Clock::time_point epoch) { detail::epoch = epoch; }
+
+    // Labels the calling thread in the trace.
+    inline void NameThread(const char* name)
+    {
+        if (auto buffer = detail::ThisThread())
+            detail::Copy(buffer->threadName, name);
+    }
+
+    // Records an event timed by the caller.
+    inline void Record(const char* name, const char* category, Clock::time_point start, Clock::time_point end)
+    {
+        auto buffer = detail::ThisThread();
+        auto count = buffer ? buffer->count.load(std::memory_order_relaxed) : MaxEvents;
+        if (count == MaxEvents) {
+            detail::dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto& event = buffer->events[count];
+        detail::Copy(event.name, name);
+        event.category = category;
+        event.start = start;
+        event.duration = end - start;
+        buffer->count.store(count + 1, std::memory_order_release);
+    }
+
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name, const char* category = "startup") : name(name), category(category), start(Clock::now()) {}
+        ~Scope() { Record(name, category, start, Clock::now()); }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        const char* category;
+        Clock::time_point start;
+    };
+
+    inline std::size_t Dropped() { return detail::dropped.load(std::memory_order_relaxed); }
+
+    // Writes every event recorded so far. Safe to call while other threads are still recording; their newer
+    // events just aren't in this file.
+    inline bool Write(const std::string& path)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        if (!file)
+            return false;
+
+        auto micros = [](Clock::duration duration) { return std::chrono::duration<double, std::micro>(duration).count(); };
+        char number[32];
+        bool first = true;
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        auto threads = (std::min)(detail::claimed.load(std::memory_order_relaxed), MaxThreads);
+        for (std::size_t thread = 0; thread < threads; ++thread) {
+            auto& buffer = detail::buffers[thread];
+            auto count = buffer.count.load(std::memory_order_acquire);
+            // Threads nobody named, like the pool's workers, are labelled by the order they first recorded in.
+            char threadName[MaxName];
+            if (buffer.threadName[0])
+                detail::Copy(threadName, buffer.threadName);
+            else
+                snprintf(threadName, sizeof(threadName), "Worker %zu", thread + 1);
+            file << (first ? "\n" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << thread + 1 << ",\"args\":{\"name\":";
+            detail::WriteString(file, threadName);
+            file << "}}";
+            first = false;
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto& event = buffer.events[i];
+                file << (first ? "\n" : ",\n") << "{\"ph\":\"X\",\"name\":";
+                detail::WriteString(file, event.name);
+                file << ",\"cat\":";
+                detail::WriteString(file, event.category);
+                snprintf(number, sizeof(number), "%.3f", micros(event.start - detail::epoch));
+                file << ",\"ts\":" << number;
+                snprintf(number, sizeof(number), "%.3f", micros(event.duration));
+                file << ",\"dur\":" << number << ",\"pid\":1,\"tid\":" << thread + 1 << "}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        return static_cast<bool>(file);
+    }
+}
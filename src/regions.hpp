@@ -0,0 +1,459 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cstdio>
+#endif
+
+#include "scanner.hpp"
+#include "threadpool.hpp"
+
+// Pattern scanning over the process's memory at run time, for data the game allocates rather than the image.
+//
+// A Map keeps a snapshot of the committed, readable regions, sorted by address, together with the matches found
+// in each. Scan() takes a new snapshot and only scans regions that are new or whose size or protection changed
+// since the last one; the other regions keep their matches, which are re-checked in place and dropped if the
+// bytes there no longer match. That keeps repeated lookups cheap enough to run during play, at the cost of missing
+// a new match inside a region that didn't change shape until Invalidate() is called.
+//
+// Regions can be freed by other threads while they're being scanned, so nothing is read in place: every chunk is
+// copied out with a read that fails instead of faulting (ReadProcessMemory, process_vm_readv). A region that
+// couldn't be read in full is scanned again next time. The copy buffers, and the patterns the Map holds, are
+// skipped so they can't match themselves, but other copies of a pattern's bytes (on a caller's stack, or left in
+// freed memory) are real matches as far as the scanner knows. Treat results as candidates and check them, like
+// signature hits.
+namespace Regions
+{
+    struct Region
+    {
+        std::uintptr_t base = 0;
+        std::size_t size = 0;
+        bool writable = false;
+        bool executable = false;
+        bool image = false;         // backed by a module or another file
+
+        std::uintptr_t End() const { return base + size; }
+    };
+
+#if defined(_WIN32)
+    // Every committed, readable region, in address order.
+    inline std::vector<Region> Query()
+    {
+        constexpr DWORD readable = PAGE_READONLY | PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+        constexpr DWORD writable = PAGE_READWRITE | PAGE_WRITECOPY | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+        constexpr DWORD executable = PAGE_EXECUTE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE_WRITECOPY;
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        std::vector<Region> regions;
+        auto current = reinterpret_cast<std::uintptr_t>(info.lpMinimumApplicationAddress);
+        auto end = reinterpret_cast<std::uintptr_t>(info.lpMaximumApplicationAddress);
+        MEMORY_BASIC_INFORMATION mbi;
+        while (current < end && VirtualQuery(reinterpret_cast<LPCVOID>(current), &mbi, sizeof(mbi))) {
+            auto base = reinterpret_cast<std::uintptr_t>(mbi.BaseAddress);
+            if (mbi.State == MEM_COMMIT && (mbi.Protect & readable) && !(mbi.Protect & PAGE_GUARD)) {
+                regions.push_back({ base, mbi.RegionSize, (mbi.Protect & writable) != 0, (mbi.Protect & executable) != 0,
+                    mbi.Type == MEM_IMAGE || mbi.Type == MEM_MAPPED });
+            }
+            if (base + mbi.RegionSize <= current)
+                break;
+            current = base + mbi.RegionSize;
+        }
+        return regions;
+    }
+
+    // Copies size bytes at address into buffer. Returns false, instead of faulting, if any of it isn't readable.
+    inline bool Read(std::uintptr_t address, void* buffer, std::size_t size)
+    {
+        SIZE_T read = 0;
+        return ReadProcessMemory(GetCurrentProcess(), reinterpret_cast<LPCVOID>(address), buffer, size, &read) && read == size;
+    }
+
+    inline void* AllocatePages(std::size_t size)
+    {
+        return VirtualAlloc(NULL, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+
+    inline void FreePages(void* pages, std::size_t)
+    {
+        VirtualFree(pages, 0, MEM_RELEASE);
+    }
+#else
+    // Every readable mapping, in address order, from /proc/self/maps.
+    inline std::vector<Region> Query()
+    {
+        std::vector<Region> regions;
+        auto maps = fopen("/proc/self/maps", "r");
+        if (!maps)
+            return regions;
+
+        char line[4096 + 128];
+        while (fgets(line, sizeof(line), maps)) {
+            unsigned long start = 0;
+            unsigned long end = 0;
+            char perms[5] = {};
+            int pathStart = 0;
+            if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %n", &start, &end, perms, &pathStart) < 3)
+                continue;
+            if (perms[0] != 'r')
+                continue;
+            auto path = pathStart ? line + pathStart : line + strlen(line);
+            regions.push_back({ start, end - start, perms[1] == 'w', perms[2] == 'x', *path == '/' });
+        }
+        fclose(maps);
+        return regions;
+    }
+
+    // Copies size bytes at address into buffer. Returns false, instead of faulting, if any of it isn't readable.
+    inline bool Read(std::uintptr_t address, void* buffer, std::size_t size)
+    {
+        iovec local{ buffer, size };
+        iovec remote{ reinterpret_cast<void*>(address), size };
+        return process_vm_readv(getpid(), &local, 1, &remote, 1, 0) == static_cast<ssize_t>(size);
+    }
+
+    inline void* AllocatePages(std::size_t size)
+    {
+        auto pages = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return pages == MAP_FAILED ? nullptr : pages;
+    }
+
+    inline void FreePages(void* pages, std::size_t size)
+    {
+        munmap(pages, size);
+    }
+#endif
+
+    struct Stats
+    {
+        std::size_t regions = 0;    // in the snapshot, after filtering
+        std::size_t added = 0;
+        std::size_t resized = 0;    // or reprotected
+        std::size_t removed = 0;
+        std::size_t failed = 0;     // couldn't be read in full, scanned again next time
+        std::size_t bytesScanned = 0;
+        std::size_t dropped = 0;    // matches in unchanged regions that no longer match
+        double milliseconds = 0;
+    };
+
+    class Map
+    {
+    public:
+        struct Options
+        {
+            bool writableOnly = true;       // runtime objects live in writable memory
+            bool skipImages = true;         // modules and mapped files have their own scanners
+            std::size_t chunkSize = 1 << 20;
+            std::function<bool(const Region&)> filter;  // optional, further narrows the regions scanned
+        };
+
+        Map() = default;
+        explicit Map(Options options) : options(std::move(options)) {}
+
+        ~Map()
+        {
+            for (auto buffer : buffers)
+                FreePages(buffer, BufferSize());
+        }
+
+        Map(const Map&) = delete;
+        Map& operator=(const Map&) = delete;
+
+        // Every match of pattern is collected. The next Scan() covers every region, so the new pattern is looked
+        // for everywhere.
+        std::size_t Add(const std::string& name, const Scanner::Pattern& pattern)
+        {
+            searches.push_back({ name, pattern });
+            Invalidate();
+            return searches.size() - 1;
+        }
+
+        std::size_t Add(const std::string& name, const Scanner::Signature& signature)
+        {
+            return Add(name, signature.pattern);
+        }
+
+        // Forgets every region, so the next Scan() covers all of them.
+        void Invalidate()
+        {
+            regions.clear();
+        }
+
+        Stats Scan(ThreadPool* pool = nullptr)
+        {
+            auto start = std::chrono::steady_clock::now();
+            Stats stats;
+
+            // Carry over what hasn't changed shape, the rest goes on the list to scan.
+            std::map<std::uintptr_t, Entry> next;
+            std::vector<Entry*> dirty;
+            for (const auto& region : TakeSnapshot()) {
+                auto& entry = next[region.base];
+                entry.region = region;
+                auto previous = regions.find(region.base);
+                if (previous != regions.end() && previous->second.complete && Same(previous->second.region, region)) {
+                    entry.matches = std::move(previous->second.matches);
+                    entry.complete = true;
+                    regions.erase(previous);
+                    stats.dropped += Recheck(entry);
+                    continue;
+                }
+
+                // Same shape but not read in full last time: retried without counting as a change.
+                if (previous == regions.end())
+                    ++stats.added;
+                else {
+                    stats.resized += !Same(previous->second.region, region);
+                    regions.erase(previous);
+                }
+                entry.matches.assign(searches.size(), {});
+                dirty.push_back(&entry);
+            }
+            stats.removed = regions.size();
+            stats.regions = next.size();
+            regions = std::move(next);
+
+            ScanRegions(dirty, pool, stats);
+            stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return stats;
+        }
+
+        // Every match of a pattern, in address order.
+        std::vector<std::uintptr_t> Results(std::size_t id) const
+        {
+            std::vector<std::uintptr_t> results;
+            for (const auto& [base, entry] : regions) {
+                if (id < entry.matches.size())
+                    results.insert(results.end(), entry.matches[id].begin(), entry.matches[id].end());
+            }
+            return results;
+        }
+
+        std::vector<std::uintptr_t> Results(const std::string& name) const
+        {
+            for (std::size_t id = 0; id < searches.size(); ++id) {
+                if (searches[id].name == name)
+                    return Results(id);
+            }
+            return {};
+        }
+
+        // The regions of the last snapshot, in address order.
+        std::vector<Region> Snapshot() const
+        {
+            std::vector<Region> result;
+            result.reserve(regions.size());
+            for (const auto& [base, entry] : regions)
+                result.push_back(entry.region);
+            return result;
+        }
+
+    private:
+        struct Search
+        {
+            std::string name;
+            Scanner::Pattern pattern;
+        };
+
+        struct Entry
+        {
+            Region region;
+            std::vector<std::vector<std::uintptr_t>> matches;   // per search, in address order
+            bool complete = false;                              // every chunk was read
+        };
+
+        // A piece of a dirty region, read with enough extra bytes to finish a match that starts in it.
+        struct Chunk
+        {
+            Entry* entry;
+            std::uintptr_t begin;
+            std::size_t size;
+            std::size_t limit;
+        };
+
+        Options options;
+        std::vector<Search> searches;
+        std::map<std::uintptr_t, Entry> regions;
+
+        // Copy buffers are whole allocations of their own, so they're easy to leave out of the snapshot.
+        std::vector<void*> buffers;
+        std::vector<void*> freeBuffers;
+        std::mutex bufferMutex;
+
+        std::size_t BufferSize() const
+        {
+            return options.chunkSize + Scanner::MaxPatternLength;
+        }
+
+        void* AcquireBuffer()
+        {
+            std::scoped_lock lock(bufferMutex);
+            if (!freeBuffers.empty()) {
+                auto buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+                return buffer;
+            }
+            auto buffer = AllocatePages(BufferSize());
+            if (buffer)
+                buffers.push_back(buffer);
+            return buffer;
+        }
+
+        void ReleaseBuffer(void* buffer)
+        {
+            std::scoped_lock lock(bufferMutex);
+            freeBuffers.push_back(buffer);
+        }
+
+        static bool Same(const Region& a, const Region& b)
+        {
+            return a.size == b.size && a.writable == b.writable && a.executable == b.executable && a.image == b.image;
+        }
+
+        // Filtered regions with the copy buffers cut out. Anonymous mappings next to each other can be reported as
+        // one region, so the buffers are removed by range rather than by dropping the regions that hold them.
+        std::vector<Region> TakeSnapshot()
+        {
+            std::vector<std::pair<std::uintptr_t, std::uintptr_t>> owned;
+            {
+                std::scoped_lock lock(bufferMutex);
+                for (auto buffer : buffers) {
+                    auto begin = reinterpret_cast<std::uintptr_t>(buffer);
+                    owned.emplace_back(begin, begin + BufferSize());
+                }
+            }
+            std::sort(owned.begin(), owned.end());
+
+            std::vector<Region> snapshot;
+            for (auto region : Regions::Query()) {
+                if ((options.writableOnly && !region.writable) || (options.skipImages && region.image))
+                    continue;
+                if (options.filter && !options.filter(region))
+                    continue;
+
+                auto begin = region.base;
+                for (const auto& [ownedBegin, ownedEnd] : owned) {
+                    if (ownedEnd <= begin || ownedBegin >= region.End())
+                        continue;
+                    if (ownedBegin > begin)
+                        snapshot.push_back({ begin, ownedBegin - begin, region.writable, region.executable, region.image });
+                    begin = (std::max)(begin, ownedEnd);
+                }
+                if (begin < region.End())
+                    snapshot.push_back({ begin, region.End() - begin, region.writable, region.executable, region.image });
+            }
+            return snapshot;
+        }
+
+        // Matches inside the patterns themselves don't count.
+        bool InSearches(std::uintptr_t address) const
+        {
+            for (const auto& search : searches) {
+                auto begin = reinterpret_cast<std::uintptr_t>(&search.pattern);
+                if (address >= begin && address < begin + sizeof(search.pattern))
+                    return true;
+            }
+            return false;
+        }
+
+        // Drops the matches of an unchanged region that no longer match. Returns how many.
+        std::size_t Recheck(Entry& entry) const
+        {
+            std::size_t dropped = 0;
+            std::uint8_t bytes[Scanner::MaxPatternLength];
+            for (std::size_t id = 0; id < entry.matches.size(); ++id) {
+                const auto& pattern = searches[id].pattern;
+                std::erase_if(entry.matches[id], [&](std::uintptr_t match) {
+                    bool still = Read(match, bytes, pattern.size()) && Scanner::detail::VerifyScalar(bytes, pattern);
+                    dropped += !still;
+                    return !still;
+                });
+            }
+            return dropped;
+        }
+
+        void ScanRegions(const std::vector<Entry*>& dirty, ThreadPool* pool, Stats& stats)
+        {
+            std::size_t longest = 0;
+            for (const auto& search : searches)
+                longest = (std::max)(longest, search.pattern.size());
+
+            std::vector<Chunk> chunks;
+            for (auto entry : dirty) {
+                const auto& region = entry->region;
+                for (std::size_t offset = 0; offset < region.size; offset += options.chunkSize) {
+                    auto size = (std::min)(options.chunkSize, region.size - offset);
+                    auto limit = (std::min)(region.size - offset, size + (longest ? longest - 1 : 0));
+                    chunks.push_back({ entry, region.base + offset, size, limit });
+                }
+                entry->complete = true;
+                stats.bytesScanned += region.size;
+            }
+
+            // Chunks of one region are consecutive, so merging them in order keeps every region's matches sorted.
+            std::vector<std::vector<std::pair<std::size_t, std::uintptr_t>>> found(chunks.size());
+            std::unique_ptr<std::atomic<bool>[]> failed(new std::atomic<bool>[chunks.size()]);
+            auto scanChunk = [&](std::size_t c) {
+                const auto& chunk = chunks[c];
+                failed[c] = false;
+                auto buffer = static_cast<std::uint8_t*>(AcquireBuffer());
+                if (!buffer || !Read(chunk.begin, buffer, chunk.limit)) {
+                    failed[c] = true;
+                    if (buffer)
+                        ReleaseBuffer(buffer);
+                    return;
+                }
+
+                for (std::size_t id = 0; id < searches.size(); ++id) {
+                    const auto& pattern = searches[id].pattern;
+                    if (pattern.size() == 0 || pattern.size() > chunk.limit)
+                        continue;
+                    const std::uint8_t* p = buffer;
+                    auto end = buffer + chunk.limit;
+                    while (auto hit = Scanner::Find(p, end - p, pattern)) {
+                        auto offset = static_cast<std::size_t>(hit - buffer);
+                        if (offset >= chunk.size)
+                            break;
+                        if (!InSearches(chunk.begin + offset))
+                            found[c].emplace_back(id, chunk.begin + offset);
+                        p = hit + 1;
+                    }
+                }
+                ReleaseBuffer(buffer);
+            };
+
+            if (pool)
+                pool->ParallelFor(chunks.size(), scanChunk);
+            else
+                for (std::size_t c = 0; c < chunks.size(); ++c)
+                    scanChunk(c);
+
+            for (std::size_t c = 0; c < chunks.size(); ++c) {
+                auto entry = chunks[c].entry;
+                if (failed[c])
+                    entry->complete = false;
+                for (const auto& [id, address] : found[c])
+                    entry->matches[id].push_back(address);
+            }
+            for (auto entry : dirty)
+                stats.failed += !entry->complete;
+        }
+    };
+}
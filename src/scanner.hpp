@@ -0,0 +1,1063 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+
+#include "threadpool.hpp"
+
+#if defined(_MSC_VER)
+#define SCANNER_TARGET_AVX2
+#else
+#define SCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+// Platform-independent pattern matching kernels used by Memory::PatternScan.
+// Nothing in here touches the Win32 API so it can be built and compared on Linux against synthetic buffers.
+namespace Scanner
+{
+    enum class Engine
+    {
+        Auto,
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    inline const char* EngineName(Engine engine)
+    {
+        switch (engine) {
+        case Engine::Scalar: return "scalar";
+        case Engine::SSE2: return "sse2";
+        case Engine::AVX2: return "avx2";
+        default: return "auto";
+        }
+    }
+
+    // Longest signature that can be registered. Patterns live in fixed arrays so they can be built at compile time
+    // and copied around without allocating.
+    constexpr std::size_t MaxPatternLength = 64;
+
+    // Pattern bytes are stored pre-masked, so a position matches when (data[i] & mask[i]) == bytes[i].
+    // anchor is the index of the least common fixed byte, used to find candidates before verifying the rest.
+    // Everything past size() is zero in both arrays and therefore always compares equal.
+    struct Pattern
+    {
+        std::array<std::uint8_t, MaxPatternLength> bytes{};
+        std::array<std::uint8_t, MaxPatternLength> mask{};
+        std::size_t length = 0;
+        std::size_t anchor = 0;
+
+        constexpr std::size_t size() const { return length; }
+    };
+
+    inline unsigned int CountTrailingZeros(std::uint32_t bits)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, bits);
+        return index;
+#else
+        return __builtin_ctz(bits);
+#endif
+    }
+
+    // Rough byte frequencies in 32-bit MSVC code. Only the ordering matters, higher is more common.
+    inline constexpr auto ByteWeights = [] {
+        struct Entry { std::uint8_t byte; std::uint8_t weight; };
+        constexpr Entry common[] = {
+            { 0x00, 255 }, { 0xFF, 200 }, { 0x8B, 190 }, { 0x24, 150 }, { 0x89, 140 }, { 0x44, 120 },
+            { 0x0F, 120 }, { 0xE8, 110 }, { 0x83, 110 }, { 0x45, 100 }, { 0x01, 100 }, { 0x04, 95 },
+            { 0x08, 95 }, { 0x10, 90 }, { 0x8D, 90 }, { 0xCC, 90 }, { 0xC0, 85 }, { 0x85, 80 },
+            { 0x4C, 75 }, { 0x74, 75 }, { 0x75, 70 }, { 0x50, 70 }, { 0x56, 65 }, { 0x57, 65 },
+            { 0xF3, 65 }, { 0x0C, 60 }, { 0x14, 60 }, { 0x18, 60 }, { 0x1C, 55 }, { 0x20, 55 },
+            { 0x6A, 55 }, { 0xC7, 50 }, { 0x02, 50 }, { 0x03, 50 }, { 0x5E, 50 }, { 0x5F, 50 },
+            { 0x55, 45 }, { 0xC3, 45 }, { 0xEB, 45 }, { 0x11, 45 }, { 0x33, 40 }, { 0x84, 40 },
+            { 0x46, 40 }, { 0x47, 40 }, { 0x40, 40 }, { 0x80, 40 }, { 0x28, 35 }, { 0x3C, 35 },
+            { 0x3B, 35 }, { 0x53, 35 }, { 0x5B, 35 }, { 0xE9, 30 }, { 0x5D, 30 }, { 0x51, 30 },
+            { 0x52, 30 }, { 0x7C, 30 }, { 0xC4, 30 }, { 0xEC, 30 }, { 0x30, 25 }, { 0x38, 25 },
+            { 0x06, 25 }, { 0x05, 25 }, { 0xF8, 25 }, { 0x0D, 20 }, { 0x15, 20 }, { 0x1D, 20 },
+        };
+        std::uint8_t table[256] = {};
+        for (std::size_t i = 0; i < 256; ++i) {
+            table[i] = 10;
+        }
+        for (const auto& entry : common) {
+            if (entry.weight > table[entry.byte]) {
+                table[entry.byte] = entry.weight;
+            }
+        }
+        struct Table { std::uint8_t weight[256]; } result{};
+        for (std::size_t i = 0; i < 256; ++i) {
+            result.weight[i] = table[i];
+        }
+        return result;
+    }();
+
+    constexpr std::size_t PickAnchor(const std::uint8_t* bytes, const std::uint8_t* mask, std::size_t size)
+    {
+        std::size_t anchor = 0;
+        int best = 256;
+        for (std::size_t i = 0; i < size; ++i) {
+            if (mask[i] != 0xFF)
+                continue;
+            if (ByteWeights.weight[bytes[i]] < best) {
+                best = ByteWeights.weight[bytes[i]];
+                anchor = i;
+            }
+        }
+        return anchor;
+    }
+
+    // Longest operand program a signature can carry.
+    constexpr std::size_t MaxOperations = 8;
+
+    // Steps run at a match to get from the matched bytes to the address a fix actually wants. They work on a
+    // cursor that starts at the capture point, or at the match itself if the signature has none.
+    enum class Opcode : std::uint8_t
+    {
+        Offset,     // cursor += operand
+        Rel32,      // cursor = cursor + 4 + *(int32_t*)cursor: the target of a call/jmp whose rel32 is at cursor
+        Abs32,      // cursor = *(uint32_t*)cursor: an absolute address (disp32 or imm32) at cursor
+    };
+
+    struct Operation
+    {
+        Opcode code = Opcode::Offset;
+        std::int32_t operand = 0;
+    };
+
+    // Compiled operand program. Neighbouring offsets are folded together, so a plain signature has no operations.
+    struct Program
+    {
+        std::array<Operation, MaxOperations> operations{};
+        std::size_t length = 0;
+
+        constexpr std::size_t size() const { return length; }
+    };
+
+    enum class ParseError
+    {
+        None,
+        Empty,
+        BadToken,       // anything other than a byte, "^", "rel32", "abs32" or a +/- hex offset
+        TooLong,
+        NoFixedBytes,
+        BadCapture,     // more than one "^", or one after an operation
+        BadOperation    // offset out of range, too many operations, or a byte after an operation
+    };
+
+    namespace detail
+    {
+        constexpr int HexDigit(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            return -1;
+        }
+
+        constexpr bool Matches(const char* token, std::size_t length, const char* word)
+        {
+            std::size_t i = 0;
+            for (; i < length && word[i]; ++i) {
+                if (token[i] != word[i])
+                    return false;
+            }
+            return i == length && !word[i];
+        }
+
+        // Appends an operation, folding it into the previous one if both are offsets. An offset that folds to
+        // zero disappears.
+        constexpr bool Emit(Program& program, Opcode code, std::int64_t operand = 0)
+        {
+            if (code == Opcode::Offset && program.length && program.operations[program.length - 1].code == Opcode::Offset) {
+                auto& last = program.operations[program.length - 1];
+                operand += last.operand;
+                if (operand < INT32_MIN || operand > INT32_MAX)
+                    return false;
+                last.operand = static_cast<std::int32_t>(operand);
+                if (operand == 0)
+                    --program.length;
+                return true;
+            }
+            if (code == Opcode::Offset && operand == 0)
+                return true;
+            if (program.length == MaxOperations || operand < INT32_MIN || operand > INT32_MAX)
+                return false;
+            program.operations[program.length++] = { code, static_cast<std::int32_t>(operand) };
+            return true;
+        }
+
+        // Shared by the compile-time and runtime parsers so both accept exactly the same syntax.
+        constexpr ParseError ParseInto(const char* text, Pattern& pattern, Program& program)
+        {
+            pattern = {};
+            program = {};
+            bool fixed = false;
+            bool captured = false;
+            bool operating = false;     // past the bytes, only operations from here on
+            for (auto c = text; *c;) {
+                if (*c == ' ') {
+                    ++c;
+                    continue;
+                }
+                auto token = c;
+                while (*c && *c != ' ')
+                    ++c;
+                std::size_t length = c - token;
+
+                if (Matches(token, length, "^")) {
+                    if (captured || operating)
+                        return ParseError::BadCapture;
+                    captured = true;
+                    Emit(program, Opcode::Offset, pattern.length);
+                    continue;
+                }
+                if (Matches(token, length, "rel32") || Matches(token, length, "abs32")) {
+                    operating = true;
+                    if (!Emit(program, token[0] == 'r' ? Opcode::Rel32 : Opcode::Abs32))
+                        return ParseError::BadOperation;
+                    continue;
+                }
+                if (token[0] == '+' || token[0] == '-') {
+                    if (length < 2 || length > 9)
+                        return length < 2 ? ParseError::BadToken : ParseError::BadOperation;
+                    std::int64_t offset = 0;
+                    for (std::size_t i = 1; i < length; ++i) {
+                        auto digit = HexDigit(token[i]);
+                        if (digit < 0)
+                            return ParseError::BadToken;
+                        offset = offset << 4 | digit;
+                    }
+                    operating = true;
+                    if (!Emit(program, Opcode::Offset, token[0] == '-' ? -offset : offset))
+                        return ParseError::BadOperation;
+                    continue;
+                }
+
+                // A byte: two hex digits, either of which can be "?", or a lone "?".
+                if (length > 2 || (length == 1 && token[0] != '?'))
+                    return ParseError::BadToken;
+                if (operating)
+                    return ParseError::BadOperation;
+                if (pattern.length == MaxPatternLength)
+                    return ParseError::TooLong;
+
+                std::uint8_t byte = 0;
+                std::uint8_t mask = 0;
+                for (std::size_t i = 0; i < length; ++i) {
+                    std::uint8_t shift = i + 1 == length ? 0 : 4;
+                    if (token[i] == '?')
+                        continue;
+                    auto digit = HexDigit(token[i]);
+                    if (digit < 0)
+                        return ParseError::BadToken;
+                    byte |= static_cast<std::uint8_t>(digit << shift);
+                    mask |= static_cast<std::uint8_t>(0xF << shift);
+                }
+                fixed |= mask != 0;
+
+                pattern.bytes[pattern.length] = byte;
+                pattern.mask[pattern.length] = mask;
+                ++pattern.length;
+            }
+
+            if (pattern.length == 0)
+                return ParseError::Empty;
+            if (!fixed)
+                return ParseError::NoFixedBytes;
+            pattern.anchor = PickAnchor(pattern.bytes.data(), pattern.mask.data(), pattern.length);
+            return ParseError::None;
+        }
+
+        // Deliberately not constexpr: reaching one of these while evaluating a Signature stops the build,
+        // and the compiler error names the problem.
+        inline void SignatureIsEmpty() {}
+        inline void SignatureHasBadToken() {}
+        inline void SignatureIsTooLong() {}
+        inline void SignatureHasNoFixedBytes() {}
+        inline void SignatureHasBadCapture() {}
+        inline void SignatureHasBadOperation() {}
+    }
+
+    // A signature literal parsed at compile time, e.g. Scanner::Signature("8B ?? ?? E8").
+    // Accepts the usual IDA-style syntax with two-digit hex bytes and "??" (or "?") wildcards, plus:
+    //   8? ?F      nibble wildcards
+    //   ^          capture point: the address comes from the byte after it instead of the start of the match
+    //   rel32      follow the rel32 at the cursor, e.g. "E8 ^ ?? ?? ?? ?? rel32" for the callee of a call
+    //   abs32      read the absolute address at the cursor, e.g. "A1 ^ ?? ?? ?? ?? abs32" for the global
+    //   +1C -4     move the cursor by a hex offset
+    // Operations go after the last byte and run left to right at the match, see Execute().
+    // A malformed literal fails the build. The text is kept because the signature cache hashes it.
+    struct Signature
+    {
+        Pattern pattern;
+        Program program;
+        const char* text;
+
+        consteval Signature(const char* text) : text(text)
+        {
+            switch (detail::ParseInto(text, pattern, program)) {
+            case ParseError::None: break;
+            case ParseError::Empty: detail::SignatureIsEmpty(); break;
+            case ParseError::BadToken: detail::SignatureHasBadToken(); break;
+            case ParseError::TooLong: detail::SignatureIsTooLong(); break;
+            case ParseError::NoFixedBytes: detail::SignatureHasNoFixedBytes(); break;
+            case ParseError::BadCapture: detail::SignatureHasBadCapture(); break;
+            case ParseError::BadOperation: detail::SignatureHasBadOperation(); break;
+            }
+        }
+    };
+
+    // Runtime parser for patterns that aren't known at compile time. Returns an empty pattern if the text
+    // is malformed, which never matches.
+    inline Pattern Parse(const char* signature, ParseError* error = nullptr, Program* program = nullptr)
+    {
+        Pattern pattern;
+        Program operations;
+        auto result = detail::ParseInto(signature, pattern, operations);
+        if (error)
+            *error = result;
+        if (result != ParseError::None) {
+            pattern = {};
+            operations = {};
+        }
+        if (program)
+            *program = operations;
+        return pattern;
+    }
+
+    // Where a scanned image sits, so operands can be followed out of a match and checked against it.
+    // addressBase is what absolute operands are relative to: the module base once it's loaded, or the preferred
+    // image base for a file on disk.
+    struct Module
+    {
+        const std::uint8_t* base = nullptr;
+        std::size_t size = 0;
+        std::uint64_t addressBase = 0;
+    };
+
+    // Runs a signature's program on a match. Returns nullptr if an operand would be read from outside the module
+    // or the result lands outside it. Without a module nothing is checked and absolute addresses are pointers.
+    inline const std::uint8_t* Execute(const Program& program, const std::uint8_t* match, const Module& module = {})
+    {
+        auto begin = reinterpret_cast<std::uintptr_t>(module.base);
+        auto inside = [&](std::uintptr_t address, std::size_t bytes) {
+            return !module.base || (address >= begin && address - begin <= module.size && module.size - (address - begin) >= bytes);
+        };
+
+        auto cursor = reinterpret_cast<std::uintptr_t>(match);
+        for (std::size_t i = 0; i < program.size(); ++i) {
+            const auto& operation = program.operations[i];
+            switch (operation.code) {
+            case Opcode::Offset:
+                cursor += static_cast<std::intptr_t>(operation.operand);
+                break;
+            case Opcode::Rel32: {
+                if (!inside(cursor, 4))
+                    return nullptr;
+                std::int32_t rel;
+                memcpy(&rel, reinterpret_cast<const void*>(cursor), sizeof(rel));
+                cursor += 4 + static_cast<std::intptr_t>(rel);
+                break;
+            }
+            case Opcode::Abs32: {
+                if (!inside(cursor, 4))
+                    return nullptr;
+                std::uint32_t address;
+                memcpy(&address, reinterpret_cast<const void*>(cursor), sizeof(address));
+                cursor = module.base ? begin + static_cast<std::uint32_t>(address - module.addressBase) : address;
+                break;
+            }
+            }
+        }
+        if (!inside(cursor, 1))
+            return nullptr;
+        return reinterpret_cast<const std::uint8_t*>(cursor);
+    }
+
+    // Reference implementation. Every other engine must return exactly what this returns.
+    inline const std::uint8_t* FindScalar(const std::uint8_t* data, std::size_t size, const Pattern& pattern)
+    {
+        auto s = pattern.size();
+        auto b = pattern.bytes.data();
+        auto m = pattern.mask.data();
+
+        if (s == 0 || size < s)
+            return nullptr;
+
+        for (std::size_t i = 0; i <= size - s; ++i) {
+            bool found = true;
+            for (std::size_t j = 0; j < s; ++j) {
+                if ((data[i + j] & m[j]) != b[j]) {
+                    found = false;
+                    break;
+                }
+            }
+            if (found) {
+                return &data[i];
+            }
+        }
+        return nullptr;
+    }
+
+    namespace detail
+    {
+        // Checks eight bytes at a time. Wildcards are just zero mask bits, so there is no per-byte branch.
+        inline bool VerifyScalar(const std::uint8_t* p, const Pattern& pattern)
+        {
+            auto s = pattern.size();
+            std::size_t j = 0;
+            for (; j + 8 <= s; j += 8) {
+                std::uint64_t data, bytes, mask;
+                memcpy(&data, p + j, 8);
+                memcpy(&bytes, pattern.bytes.data() + j, 8);
+                memcpy(&mask, pattern.mask.data() + j, 8);
+                if ((data & mask) != bytes)
+                    return false;
+            }
+            std::uint8_t diff = 0;
+            for (; j < s; ++j)
+                diff |= (p[j] & pattern.mask[j]) ^ pattern.bytes[j];
+            return diff == 0;
+        }
+
+        // Pattern and mask padded out to whole vectors. Padding has mask 0 and byte 0 so it always compares equal.
+        template<std::size_t Width>
+        struct Blocks
+        {
+            alignas(32) std::uint8_t bytes[4 * Width];
+            alignas(32) std::uint8_t mask[4 * Width];
+            std::size_t count = 0;
+        };
+
+        template<std::size_t Width>
+        inline bool BuildBlocks(const Pattern& pattern, Blocks<Width>& blocks)
+        {
+            blocks.count = (pattern.size() + Width - 1) / Width;
+            if (blocks.count * Width > sizeof(blocks.bytes))
+                return false;
+            memset(blocks.bytes, 0, sizeof(blocks.bytes));
+            memset(blocks.mask, 0, sizeof(blocks.mask));
+            memcpy(blocks.bytes, pattern.bytes.data(), pattern.size());
+            memcpy(blocks.mask, pattern.mask.data(), pattern.size());
+            return true;
+        }
+    }
+
+    inline const std::uint8_t* FindSSE2(const std::uint8_t* data, std::size_t size, const Pattern& pattern)
+    {
+        auto s = pattern.size();
+        if (s == 0 || size < s)
+            return nullptr;
+
+        // Nothing to anchor on if every byte is a wildcard.
+        detail::Blocks<16> blocks;
+        if (pattern.mask[pattern.anchor] != 0xFF || !detail::BuildBlocks(pattern, blocks))
+            return FindScalar(data, size, pattern);
+
+        auto k = pattern.anchor;
+        auto last = size - s;                       // last valid match position
+        auto vectorEnd = size - blocks.count * 16;  // last position where the padded verify stays in bounds
+        auto needle = _mm_set1_epi8(static_cast<char>(pattern.bytes[k]));
+
+        auto verify = [&](std::size_t pos) {
+            if (size < blocks.count * 16 || pos > vectorEnd)
+                return detail::VerifyScalar(data + pos, pattern);
+            for (std::size_t b = 0; b < blocks.count; ++b) {
+                auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos + b * 16));
+                auto m = _mm_load_si128(reinterpret_cast<const __m128i*>(blocks.mask + b * 16));
+                auto p = _mm_load_si128(reinterpret_cast<const __m128i*>(blocks.bytes + b * 16));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(d, m), p)) != 0xFFFF)
+                    return false;
+            }
+            return true;
+        };
+
+        std::size_t i = 0;
+        for (; i + 16 <= last + 1; i += 16) {
+            auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + k));
+            auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+            while (bits) {
+                auto pos = i + CountTrailingZeros(bits);
+                if (verify(pos))
+                    return &data[pos];
+                bits &= bits - 1;
+            }
+        }
+        for (; i <= last; ++i) {
+            if (data[i + k] == pattern.bytes[k] && detail::VerifyScalar(data + i, pattern))
+                return &data[i];
+        }
+        return nullptr;
+    }
+
+    SCANNER_TARGET_AVX2 inline const std::uint8_t* FindAVX2(const std::uint8_t* data, std::size_t size, const Pattern& pattern)
+    {
+        auto s = pattern.size();
+        if (s == 0 || size < s)
+            return nullptr;
+
+        // Nothing to anchor on if every byte is a wildcard.
+        detail::Blocks<32> blocks;
+        if (pattern.mask[pattern.anchor] != 0xFF || !detail::BuildBlocks(pattern, blocks))
+            return FindScalar(data, size, pattern);
+
+        auto k = pattern.anchor;
+        auto last = size - s;
+        auto vectorEnd = size - blocks.count * 32;
+        auto needle = _mm256_set1_epi8(static_cast<char>(pattern.bytes[k]));
+
+        std::size_t i = 0;
+        for (; i + 32 <= last + 1; i += 32) {
+            auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + k));
+            auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+            while (bits) {
+                auto pos = i + CountTrailingZeros(bits);
+                bool found = true;
+                if (size < blocks.count * 32 || pos > vectorEnd) {
+                    found = detail::VerifyScalar(data + pos, pattern);
+                }
+                else {
+                    for (std::size_t b = 0; b < blocks.count && found; ++b) {
+                        auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos + b * 32));
+                        auto m = _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks.mask + b * 32));
+                        auto p = _mm256_load_si256(reinterpret_cast<const __m256i*>(blocks.bytes + b * 32));
+                        found = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(d, m), p))) == 0xFFFFFFFFu;
+                    }
+                }
+                if (found)
+                    return &data[pos];
+                bits &= bits - 1;
+            }
+        }
+        for (; i <= last; ++i) {
+            if (data[i + k] == pattern.bytes[k] && detail::VerifyScalar(data + i, pattern))
+                return &data[i];
+        }
+        return nullptr;
+    }
+
+    inline bool CpuHasAVX2()
+    {
+        static const bool hasAVX2 = [] {
+            unsigned int regs[4] = {};
+#if defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            regs[2] = info[2];
+#else
+            __get_cpuid(1, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+            // OSXSAVE + AVX, then check the OS actually saves YMM state.
+            if ((regs[2] & (1u << 27)) == 0 || (regs[2] & (1u << 28)) == 0)
+                return false;
+#if defined(_MSC_VER)
+            auto xcr0 = _xgetbv(0);
+#else
+            unsigned int lo, hi;
+            __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+            auto xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+            if ((xcr0 & 0x6) != 0x6)
+                return false;
+#if defined(_MSC_VER)
+            __cpuidex(info, 7, 0);
+            regs[1] = info[1];
+#else
+            __get_cpuid_count(7, 0, &regs[0], &regs[1], &regs[2], &regs[3]);
+#endif
+            return (regs[1] & (1u << 5)) != 0;
+        }();
+        return hasAVX2;
+    }
+
+    inline Engine Resolve(Engine engine)
+    {
+        if (engine == Engine::Auto)
+            return CpuHasAVX2() ? Engine::AVX2 : Engine::SSE2;
+        if (engine == Engine::AVX2 && !CpuHasAVX2())
+            return Engine::SSE2;
+        return engine;
+    }
+
+    inline const std::uint8_t* Find(const std::uint8_t* data, std::size_t size, const Pattern& pattern, Engine engine = Engine::Auto)
+    {
+        switch (Resolve(engine)) {
+        case Engine::Scalar: return FindScalar(data, size, pattern);
+        case Engine::AVX2: return FindAVX2(data, size, pattern);
+        default: return FindSSE2(data, size, pattern);
+        }
+    }
+
+    enum class Match
+    {
+        First,
+        All
+    };
+
+    // Which part of the image a signature can live in.
+    enum class Region
+    {
+        Code,   // executable sections
+        Data,   // .rdata/.data style sections
+        Any
+    };
+
+    // A contiguous, readable piece of the image. Spans are expected in ascending address order.
+    struct Span
+    {
+        const std::uint8_t* begin = nullptr;
+        std::size_t size = 0;
+        bool code = true;
+        bool data = true;
+
+        bool Contains(Region region) const
+        {
+            return region == Region::Any || (region == Region::Code ? code : data);
+        }
+    };
+
+    // Piece of a span handed to one worker. Matches starting in [begin, begin + size) belong to the chunk;
+    // the worker may read up to limit bytes so that a match starting near the end is still seen whole.
+    struct Chunk
+    {
+        const std::uint8_t* begin = nullptr;
+        std::size_t size = 0;
+        std::size_t limit = 0;
+    };
+
+    constexpr std::size_t ChunkSize = 1 << 20;
+
+    // Splits spans into chunks in ascending address order. Without a pool each span is one chunk.
+    inline std::vector<Chunk> MakeChunks(const std::vector<Span>& spans, Region region, const ThreadPool* pool)
+    {
+        std::vector<Chunk> chunks;
+        for (const auto& span : spans) {
+            if (!span.Contains(region))
+                continue;
+            auto step = (pool && pool->Size() > 1) ? ChunkSize : span.size;
+            for (std::size_t offset = 0; offset < span.size; offset += step) {
+                chunks.push_back({ span.begin + offset, (std::min)(step, span.size - offset), span.size - offset });
+            }
+        }
+        return chunks;
+    }
+
+    namespace detail
+    {
+        inline void AtomicMin(std::atomic<std::size_t>& value, std::size_t candidate)
+        {
+            auto current = value.load();
+            while (candidate < current && !value.compare_exchange_weak(current, candidate)) {}
+        }
+    }
+
+    // First match across a list of spans. Matches never straddle two spans.
+    // With a pool the spans are split into overlapping chunks scanned in parallel; the lowest-address match
+    // still wins, so the result is the same as the sequential scan.
+    inline const std::uint8_t* Find(const std::vector<Span>& spans, const Pattern& pattern, Region region = Region::Code, Engine engine = Engine::Auto, ThreadPool* pool = nullptr)
+    {
+        if (!pool || pool->Size() == 1) {
+            for (const auto& span : spans) {
+                if (!span.Contains(region))
+                    continue;
+                if (auto hit = Find(span.begin, span.size, pattern, engine))
+                    return hit;
+            }
+            return nullptr;
+        }
+
+        auto chunks = MakeChunks(spans, region, pool);
+        std::vector<const std::uint8_t*> hits(chunks.size());
+        std::atomic<std::size_t> best{ SIZE_MAX };
+
+        pool->ParallelFor(chunks.size(), [&](std::size_t i) {
+            // A lower chunk already has a match.
+            if (i > best.load())
+                return;
+            const auto& chunk = chunks[i];
+            auto readable = (std::min)(chunk.limit, chunk.size + pattern.size() - 1);
+            auto hit = Find(chunk.begin, readable, pattern, engine);
+            // A hit past the chunk's own range is found again by the next chunk.
+            if (hit && hit < chunk.begin + chunk.size) {
+                hits[i] = hit;
+                detail::AtomicMin(best, i);
+            }
+        });
+
+        return best.load() == SIZE_MAX ? nullptr : hits[best.load()];
+    }
+
+    namespace detail
+    {
+        // Most distinct anchor bytes a Batch pass compares each block against. Each one costs a compare per block,
+        // so past this the remaining patterns are cheaper scanned on their own.
+        constexpr std::size_t MaxAnchors = 32;
+
+        // Calls visit(i) for every i < size where data[i] is one of the anchors, in ascending order, until visit
+        // returns true. Each block is loaded once and compared against all of them. Bytes in the last partial
+        // block are passed to visit unfiltered.
+        template<typename Visit>
+        inline void ForEachAnchorSSE2(const std::uint8_t* data, std::size_t size, const std::uint8_t* anchors, std::size_t count, Visit& visit)
+        {
+            __m128i needles[MaxAnchors];
+            for (std::size_t a = 0; a < count; ++a)
+                needles[a] = _mm_set1_epi8(static_cast<char>(anchors[a]));
+
+            std::size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                auto hits = _mm_cmpeq_epi8(block, needles[0]);
+                for (std::size_t a = 1; a < count; ++a)
+                    hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[a]));
+                auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(hits));
+                while (bits) {
+                    if (visit(i + CountTrailingZeros(bits)))
+                        return;
+                    bits &= bits - 1;
+                }
+            }
+            for (; i < size; ++i) {
+                if (visit(i))
+                    return;
+            }
+        }
+
+        template<typename Visit>
+        SCANNER_TARGET_AVX2 inline void ForEachAnchorAVX2(const std::uint8_t* data, std::size_t size, const std::uint8_t* anchors, std::size_t count, Visit& visit)
+        {
+            __m256i needles[MaxAnchors];
+            for (std::size_t a = 0; a < count; ++a)
+                needles[a] = _mm256_set1_epi8(static_cast<char>(anchors[a]));
+
+            std::size_t i = 0;
+            for (; i + 32 <= size; i += 32) {
+                auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                auto hits = _mm256_cmpeq_epi8(block, needles[0]);
+                for (std::size_t a = 1; a < count; ++a)
+                    hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[a]));
+                auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(hits));
+                while (bits) {
+                    if (visit(i + CountTrailingZeros(bits)))
+                        return;
+                    bits &= bits - 1;
+                }
+            }
+            for (; i < size; ++i) {
+                if (visit(i))
+                    return;
+            }
+        }
+
+        inline bool SamePattern(const Pattern& a, const Pattern& b)
+        {
+            return a.size() == b.size() && memcmp(a.bytes.data(), b.bytes.data(), a.size()) == 0 &&
+                memcmp(a.mask.data(), b.mask.data(), a.size()) == 0;
+        }
+    }
+
+    // Scans for many signatures in a single pass over the image (one pass per region in use).
+    // Entries with the same pattern share one needle, so each distinct pattern is matched once. The anchor bytes
+    // of every needle are compared against each SIMD block together, and each hit is verified against the needles
+    // anchored on that byte. Needles without a fixed byte, or past MaxAnchors distinct anchors, are scanned on
+    // their own.
+    class Batch
+    {
+    public:
+        struct Entry
+        {
+            std::string name;
+            std::string signature;
+            Pattern pattern;
+            Program program;
+            Match mode = Match::First;
+            Region region = Region::Code;
+            std::vector<const std::uint8_t*> results;
+            bool resolved = false;  // results are final, Run() leaves the entry alone
+        };
+
+        std::size_t Add(const std::string& name, const Signature& signature, Match mode = Match::First, Region region = Region::Code)
+        {
+            return Add(name, signature.text, signature.pattern, signature.program, mode, region);
+        }
+
+        // For signatures parsed at runtime with Parse().
+        std::size_t Add(const std::string& name, const std::string& text, const Pattern& pattern, const Program& program,
+            Match mode = Match::First, Region region = Region::Code)
+        {
+            Entry entry;
+            entry.name = name;
+            entry.signature = text;
+            entry.pattern = pattern;
+            entry.program = program;
+            entry.mode = mode;
+            entry.region = region;
+            entries.push_back(std::move(entry));
+            return entries.size() - 1;
+        }
+
+        // Checks the masked pattern of an entry at a given offset, e.g. to validate a remembered address.
+        bool Verify(std::size_t id, const std::uint8_t* data, std::size_t size, std::size_t offset) const
+        {
+            const auto& pattern = entries[id].pattern;
+            if (offset > size || size - offset < pattern.size())
+                return false;
+            return detail::VerifyScalar(data + offset, pattern);
+        }
+
+        // Supplies results from somewhere other than a scan, so Run() skips the entry.
+        void Resolve(std::size_t id, std::vector<const std::uint8_t*> results)
+        {
+            entries[id].results = std::move(results);
+            entries[id].resolved = true;
+        }
+
+        std::size_t Unresolved() const
+        {
+            std::size_t count = 0;
+            for (const auto& entry : entries) {
+                if (!entry.resolved)
+                    ++count;
+            }
+            return count;
+        }
+
+        std::size_t Size() const { return entries.size(); }
+        Entry& operator[](std::size_t id) { return entries[id]; }
+        const Entry& operator[](std::size_t id) const { return entries[id]; }
+
+        const Entry* Get(const std::string& name) const
+        {
+            for (const auto& entry : entries) {
+                if (entry.name == name)
+                    return &entry;
+            }
+            return nullptr;
+        }
+
+        // The module the results are in, used to follow and check operands. See Execute().
+        void SetModule(const Module& module) { this->module = module; }
+
+        // Address a signature resolves to at its first (lowest address) match, or nullptr if it wasn't found or
+        // its operands lead outside the module. Entry::results holds the matches themselves.
+        std::uint8_t* Find(const std::string& name) const
+        {
+            auto entry = Get(name);
+            if (!entry || entry->results.empty())
+                return nullptr;
+            return const_cast<std::uint8_t*>(Execute(entry->program, entry->results.front(), module));
+        }
+
+        // Scans for every unresolved entry. Returns false without touching the image if there was nothing to do.
+        bool Run(const std::uint8_t* data, std::size_t size)
+        {
+            return Run({ Span{ data, size, true, true } });
+        }
+
+        // Same as above, restricted to the spans each entry's region allows. One pass is made per region that has
+        // unresolved entries. With a pool the spans are split into chunks overlapping by the longest pattern and
+        // scanned in parallel; results are identical to the sequential scan.
+        bool Run(const std::vector<Span>& spans, ThreadPool* pool = nullptr)
+        {
+            if (Unresolved() == 0)
+                return false;
+
+            for (auto& entry : entries) {
+                if (!entry.resolved)
+                    entry.results.clear();
+            }
+
+            for (auto region : { Region::Code, Region::Data, Region::Any })
+                Pass(spans, region, pool);
+
+            MarkResolved();
+            return true;
+        }
+
+    private:
+        // Distinct pattern in a pass and the entries that share it.
+        struct Needle
+        {
+            const Pattern* pattern = nullptr;
+            std::vector<std::size_t> ids;
+            bool all = false;   // some entry wants every match
+            std::vector<const std::uint8_t*> results;
+        };
+
+        std::vector<Entry> entries;
+        Module module;
+
+        void MarkResolved()
+        {
+            for (auto& entry : entries)
+                entry.resolved = true;
+        }
+
+        static void ScanSingle(Needle& needle, Region region, const std::vector<Span>& spans, ThreadPool* pool)
+        {
+            if (!needle.all) {
+                if (auto hit = Scanner::Find(spans, *needle.pattern, region, Engine::Auto, pool))
+                    needle.results.push_back(hit);
+                return;
+            }
+
+            for (const auto& span : spans) {
+                if (!span.Contains(region))
+                    continue;
+                auto p = span.begin;
+                auto end = span.begin + span.size;
+                while (auto hit = Scanner::Find(p, end - p, *needle.pattern)) {
+                    needle.results.push_back(hit);
+                    p = hit + 1;
+                }
+            }
+        }
+
+        void Pass(const std::vector<Span>& spans, Region region, ThreadPool* pool)
+        {
+            std::vector<Needle> needles;
+            for (std::size_t id = 0; id < entries.size(); ++id) {
+                const auto& entry = entries[id];
+                if (entry.resolved || entry.region != region)
+                    continue;
+                auto it = std::find_if(needles.begin(), needles.end(),
+                    [&](const Needle& needle) { return detail::SamePattern(*needle.pattern, entry.pattern); });
+                if (it == needles.end()) {
+                    needles.emplace_back();
+                    it = needles.end() - 1;
+                    it->pattern = &entry.pattern;
+                }
+                it->ids.push_back(id);
+                it->all |= entry.mode == Match::All;
+            }
+            if (needles.empty())
+                return;
+
+            // Needles by the value of their anchor byte.
+            std::array<std::vector<std::uint32_t>, 256> byAnchor;
+            std::uint8_t anchors[detail::MaxAnchors];
+            std::size_t anchorCount = 0;
+            std::size_t maxLength = 0;
+            std::size_t shared = 0;
+            bool wantAll = false;
+            for (std::uint32_t n = 0; n < needles.size(); ++n) {
+                auto& needle = needles[n];
+                const auto& pattern = *needle.pattern;
+                auto byte = pattern.bytes[pattern.anchor];
+                bool fixed = pattern.size() && pattern.mask[pattern.anchor] == 0xFF;
+                if (!fixed || (byAnchor[byte].empty() && anchorCount == detail::MaxAnchors)) {
+                    ScanSingle(needle, region, spans, pool);
+                    continue;
+                }
+                if (byAnchor[byte].empty())
+                    anchors[anchorCount++] = byte;
+                byAnchor[byte].push_back(n);
+                maxLength = (std::max)(maxLength, pattern.size());
+                wantAll |= needle.all;
+                ++shared;
+            }
+
+            if (shared) {
+                auto chunks = MakeChunks(spans, region, pool);
+                std::vector<std::vector<std::pair<std::uint32_t, const std::uint8_t*>>> found(chunks.size());
+
+                // Lowest chunk each first-match needle has been found in so far.
+                std::unique_ptr<std::atomic<std::size_t>[]> firstChunk(new std::atomic<std::size_t>[needles.size()]);
+                for (std::size_t n = 0; n < needles.size(); ++n)
+                    firstChunk[n] = SIZE_MAX;
+
+                // True once nothing at or after chunk i can change the outcome.
+                auto finishedBy = [&](std::size_t i) {
+                    if (wantAll)
+                        return false;
+                    for (std::size_t byte = 0; byte < 256; ++byte) {
+                        for (auto n : byAnchor[byte]) {
+                            if (firstChunk[n].load() > i)
+                                return false;
+                        }
+                    }
+                    return true;
+                };
+
+                auto engine = Scanner::Resolve(Engine::Auto);
+                auto scanChunk = [&](std::size_t c) {
+                    if (c > 0 && finishedBy(c - 1))
+                        return;
+
+                    const auto& chunk = chunks[c];
+                    auto data = chunk.begin;
+                    auto readable = (std::min)(chunk.limit, chunk.size + maxLength - 1);
+                    auto visit = [&](std::size_t i) {
+                        bool hit = false;
+                        for (auto n : byAnchor[data[i]]) {
+                            const auto& needle = needles[n];
+                            const auto& pattern = *needle.pattern;
+                            if (!needle.all && firstChunk[n].load() <= c)
+                                continue;
+                            // Matches starting before the chunk belong to the previous one.
+                            if (i < pattern.anchor)
+                                continue;
+                            auto start = i - pattern.anchor;
+                            if (start >= chunk.size || start + pattern.size() > chunk.limit)
+                                continue;
+                            if (!detail::VerifyScalar(data + start, pattern))
+                                continue;
+                            found[c].emplace_back(n, data + start);
+                            if (!needle.all) {
+                                detail::AtomicMin(firstChunk[n], c);
+                                hit = true;
+                            }
+                        }
+                        return hit && finishedBy(c);
+                    };
+                    if (engine == Engine::AVX2)
+                        detail::ForEachAnchorAVX2(data, readable, anchors, anchorCount, visit);
+                    else
+                        detail::ForEachAnchorSSE2(data, readable, anchors, anchorCount, visit);
+                };
+
+                if (pool)
+                    pool->ParallelFor(chunks.size(), scanChunk);
+                else
+                    for (std::size_t c = 0; c < chunks.size(); ++c)
+                        scanChunk(c);
+
+                // Chunks are in address order, so merging in order keeps results sorted.
+                for (const auto& hits : found) {
+                    for (const auto& [n, address] : hits) {
+                        auto& needle = needles[n];
+                        if (!needle.all && !needle.results.empty())
+                            continue;
+                        needle.results.push_back(address);
+                    }
+                }
+            }
+
+            for (const auto& needle : needles) {
+                for (auto id : needle.ids) {
+                    auto& results = entries[id].results;
+                    if (entries[id].mode == Match::All)
+                        results = needle.results;
+                    else if (!needle.results.empty())
+                        results.assign(1, needle.results.front());
+                }
+            }
+        }
+    };
+}
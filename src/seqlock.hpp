@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+// Publishes a small trivially copyable value to any number of readers without locks.
+//
+// Writers bump the sequence to an odd number, copy the value in and bump it back to even. Readers copy the value
+// out and retry if the sequence was odd or changed underneath them, so they always see one complete Store().
+// The value is held as an array of relaxed atomic words so concurrent reads aren't a data race; on x86 those
+// compile down to plain moves.
+//
+// Writers are serialised by claiming the odd sequence number, so Store() may be called from several threads.
+template<typename T>
+class alignas(64) SeqLock
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    SeqLock() : SeqLock(T{}) {}
+
+    explicit SeqLock(const T& value)
+    {
+        Write(value);
+    }
+
+    T Load() const
+    {
+        std::uint32_t buffer[WordCount];
+        for (;;) {
+            auto before = sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                _mm_pause();
+                continue;
+            }
+            for (std::size_t i = 0; i < WordCount; ++i)
+                buffer[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T value;
+        memcpy(&value, buffer, sizeof(T));
+        return value;
+    }
+
+    void Store(const T& value)
+    {
+        auto current = sequence.load(std::memory_order_relaxed);
+        for (;;) {
+            if (current & 1) {
+                _mm_pause();
+                current = sequence.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (sequence.compare_exchange_weak(current, current + 1, std::memory_order_acquire, std::memory_order_relaxed))
+                break;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        Write(value);
+        sequence.store(current + 2, std::memory_order_release);
+    }
+
+private:
+    static constexpr std::size_t WordCount = (sizeof(T) + sizeof(std::uint32_t) - 1) / sizeof(std::uint32_t);
+
+    std::atomic<std::uint32_t> sequence{ 0 };
+    std::atomic<std::uint32_t> words[WordCount];
+
+    void Write(const T& value)
+    {
+        std::uint32_t buffer[WordCount] = {};
+        memcpy(buffer, &value, sizeof(T));
+        for (std::size_t i = 0; i < WordCount; ++i)
+            words[i].store(buffer[i], std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "scanner.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Remembers where each signature was found for one particular build of the executable.
+// The cache is only trusted when the module timestamp and SizeOfImage match, and every remembered
+// address is still checked against the masked pattern before it is used.
+namespace Scanner
+{
+    inline std::uint64_t HashSignature(const std::string& signature)
+    {
+        // FNV-1a
+        std::uint64_t hash = 0xCBF29CE484222325ull;
+        for (auto c : signature) {
+            hash ^= static_cast<std::uint8_t>(c);
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    class SignatureCache
+    {
+    public:
+        enum class Status
+        {
+            Hit,
+            Miss,
+            Stale   // in the cache, but the bytes at the remembered address no longer match
+        };
+
+        SignatureCache(std::string path, std::uint32_t timestamp, std::uint32_t sizeOfImage)
+            : path(std::move(path)), timestamp(timestamp), sizeOfImage(sizeOfImage) {}
+
+        // Returns false if the file is missing or belongs to a different build.
+        bool Load()
+        {
+            records.clear();
+            std::ifstream file(path);
+            if (!file)
+                return false;
+
+            std::string line;
+            std::uint32_t fileTimestamp = 0;
+            std::uint32_t fileSizeOfImage = 0;
+            while (std::getline(file, line)) {
+                if (line.empty() || line[0] == ';')
+                    continue;
+
+                std::istringstream ss(line);
+                std::string key;
+                ss >> key;
+                if (key == "Timestamp") {
+                    ss >> std::hex >> fileTimestamp;
+                }
+                else if (key == "SizeOfImage") {
+                    ss >> std::hex >> fileSizeOfImage;
+                }
+                else {
+                    Record record;
+                    ss >> std::hex >> record.hash;
+                    std::uint32_t rva;
+                    while (ss >> rva)
+                        record.rvas.push_back(rva);
+                    records[key] = record;
+                }
+            }
+
+            if (fileTimestamp != timestamp || fileSizeOfImage != sizeOfImage) {
+                records.clear();
+                return false;
+            }
+            return true;
+        }
+
+        // Resolves every batch entry that has a valid cached address. The status of each entry is
+        // returned in batch order.
+        std::vector<Status> Apply(Batch& batch, const std::uint8_t* base, std::size_t size) const
+        {
+            std::vector<Status> status(batch.Size(), Status::Miss);
+            for (std::size_t id = 0; id < batch.Size(); ++id) {
+                const auto& entry = batch[id];
+                auto it = records.find(entry.name);
+                if (it == records.end() || it->second.hash != HashSignature(entry.signature))
+                    continue;
+
+                std::vector<const std::uint8_t*> results;
+                bool valid = true;
+                for (auto rva : it->second.rvas) {
+                    if (!batch.Verify(id, base, size, rva)) {
+                        valid = false;
+                        break;
+                    }
+                    results.push_back(base + rva);
+                }
+
+                if (!valid) {
+                    status[id] = Status::Stale;
+                    continue;
+                }
+
+                // An empty list is a remembered "not found" for this build.
+                batch.Resolve(id, std::move(results));
+                status[id] = Status::Hit;
+            }
+            return status;
+        }
+
+        bool Save(const Batch& batch, const std::uint8_t* base)
+        {
+            for (std::size_t id = 0; id < batch.Size(); ++id) {
+                const auto& entry = batch[id];
+                Record record;
+                record.hash = HashSignature(entry.signature);
+                for (auto result : entry.results)
+                    record.rvas.push_back(static_cast<std::uint32_t>(result - base));
+                records[entry.name] = record;
+            }
+
+            std::ofstream file(path, std::ios::trunc);
+            if (!file)
+                return false;
+
+            file << "; Signature offsets for one build of the game. Safe to delete.\n";
+            file << std::hex;
+            file << "Timestamp " << timestamp << "\n";
+            file << "SizeOfImage " << sizeOfImage << "\n";
+            for (const auto& [name, record] : records) {
+                file << name << " " << record.hash;
+                for (auto rva : record.rvas)
+                    file << " " << rva;
+                file << "\n";
+            }
+            return static_cast<bool>(file);
+        }
+
+    private:
+        struct Record
+        {
+            std::uint64_t hash = 0;
+            std::vector<std::uint32_t> rvas;
+        };
+
+        std::string path;
+        std::uint32_t timestamp;
+        std::uint32_t sizeOfImage;
+        std::map<std::string, Record> records;
+    };
+}
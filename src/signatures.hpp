@@ -0,0 +1,75 @@
+#pragma once
+
+#include "scanner.hpp"
+
+// The signatures the fixes rely on. Each one resolves straight to the address its fix uses: the arithmetic on
+// the match (following a call, reading a global, stepping past an instruction) is part of the signature.
+// Shared between the DLL and the tools so a new game build can be checked without launching it.
+namespace Game
+{
+    // Which fixes are enabled. Signatures for disabled fixes aren't registered.
+    struct Features
+    {
+        bool skipIntro = true;
+        bool fixRes = true;
+        bool fixAspect = true;
+        bool fixFOV = true;
+        bool fixHUD = true;
+        bool hudElements = false;       // for HUD(), which the DLL doesn't install yet
+    };
+
+    inline void AddSignatures(Scanner::Batch& batch, const Features& features)
+    {
+        if (features.skipIntro) {
+            batch.Add("IntroSkip", "80 ?? 08 ^ 00 0F 85 ?? ?? ?? ?? 80 7F ?? 00 0F 85 ?? ?? ?? ??");
+        }
+
+        batch.Add("CurrentResolution", "8B ?? ?? ?? ?? ?? 6A ?? E8 ?? ?? ?? ?? A1 ?? ?? ?? ?? C7 ?? ?? ?? ?? ?? ??");
+        if (features.fixRes) {
+            batch.Add("Viewport", "66 0F ?? ?? 0F ?? ?? 5F ?? A3 ?? ?? ?? ??");
+        }
+
+        if (features.fixAspect) {
+            batch.Add("OcclusionAspect", "F3 0F ?? ?? ^ F3 0F ?? ?? ?? ?? ?? ?? 85 ?? 0F 84 ?? ?? ?? ?? C7 ?? ?? ?? 80 02 00 00");
+            batch.Add("ShadowAspect", "0F 57 ?? ?? ?? ?? ?? 0F 28 ?? F3 0F ?? ?? 0F 28 ?? C7 05 ?? ?? ?? ?? 00 00 00 00");
+            batch.Add("StageTriangleTest", "34 01 83 ?? ?? 88 ?? ?? 8B ?? ?? ?? ?? ?? 80 ?? ?? ?? ?? ?? 00");
+        }
+
+        if (features.fixFOV) {
+            batch.Add("FOV", "F3 0F 11 ?? ?? F3 0F 11 ?? ?? ?? ?? ?? F3 0F 59 ?? ?? ?? ?? ?? 56");
+        }
+
+        if (features.fixHUD) {
+            batch.Add("MovieSize", "0F ?? ?? ?? ^ 83 ?? ?? ?? 83 ?? ?? ?? 83 ?? ?? ?? 8B ?? E8 ?? ?? ?? ??");
+            batch.Add("MovieAspect", "C7 44 ?? ?? ?? ?? ?? ?? 89 ?? ?? ?? F3 0F ?? ?? ?? ?? ?? ?? F3 0F ?? ?? F3 0F ?? ?? F3 0F ?? ?? ?? ??");
+        }
+
+        if (features.fixHUD && features.hudElements) {
+            // Called function, and a spot further into it. Debug build with pdb has different code in between.
+            batch.Add("SetViewport", "C7 ?? ?? 00 00 F0 43 E8 ^ ?? ?? ?? ?? rel32");
+            #ifndef NDEBUG
+            batch.Add("SetViewport2", "C7 ?? ?? 00 00 F0 43 E8 ^ ?? ?? ?? ?? rel32 +62");
+            #else
+            batch.Add("SetViewport2", "C7 ?? ?? 00 00 F0 43 E8 ^ ?? ?? ?? ?? rel32 +60");
+            #endif
+
+            batch.Add("HUDTo16x9Xpos", "F3 0F ?? ?? ^ ?? ?? ?? ?? F3 0F ?? ?? E8 ?? ?? ?? ?? 8B ?? ?? ?? 8D ?? ?? F2 0F ?? ?? abs32");
+            // The screen table and width sit around the global this reads. Debug build with pdb uses different
+            // offsets for the first table.
+            #ifndef NDEBUG
+            batch.Add("HUDScreenTable1", "F3 0F ?? ?? ?? ^ ?? ?? ?? ?? 8B ?? ?? ?? ?? ?? 0F 28 ?? 0F ?? F3 0F ?? ?? 8B ?? ?? abs32 -C");
+            #else
+            batch.Add("HUDScreenTable1", "F3 0F ?? ?? ?? ^ ?? ?? ?? ?? 8B ?? ?? ?? ?? ?? 0F 28 ?? 0F ?? F3 0F ?? ?? 8B ?? ?? abs32 -4");
+            #endif
+            batch.Add("HUDScreenTable2", "F3 0F ?? ?? ?? ^ ?? ?? ?? ?? 8B ?? ?? ?? ?? ?? 0F 28 ?? 0F ?? F3 0F ?? ?? 8B ?? ?? abs32 +C");
+            batch.Add("HUDWidth", "F3 0F ?? ?? ?? ^ ?? ?? ?? ?? 8B ?? ?? ?? ?? ?? 0F 28 ?? 0F ?? F3 0F ?? ?? 8B ?? ?? abs32 +10");
+
+            batch.Add("HUDBackgroundWidth", "F3 0F ?? ?? ^ ?? ?? ?? ?? 0F 57 ?? F7 ?? 03 ?? C1 ?? ?? 8B ?? abs32");
+            batch.Add("HUDBackgroundHeight", "F3 0F ?? ?? ^ ?? ?? ?? ?? 0F 57 ?? F7 ?? 03 ?? C1 ?? ?? 8B ?? abs32 -12C");
+
+            batch.Add("DrawBox", "0F 5B ?? E8 ^ ?? ?? ?? ?? C6 ?? ?? ?? ?? ?? 00 C3 rel32");
+            batch.Add("ScreenStatusBegin", "BA 03 00 00 00 6A 01 6A 00 6A 01 8D ?? ?? E8 ?? ?? ?? ?? 83 ?? ?? 8B ?? E8 ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? ?? F3 0F 10 ?? ?? ?? ?? ??");
+            batch.Add("SetProjectionOffset", "8B 3D ?? ?? ?? ?? 89 87 ?? ?? ?? ?? 8D B7 ?? ?? ?? ?? 8B ?? 04 +21");
+        }
+    }
+}
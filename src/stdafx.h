@@ -1,8 +1,13 @@
 #define WIN32_LEAN_AND_MEAN
 
+#include <bit>
 #include <cassert>
+#include <chrono>
 #include <windows.h>
 #include <fstream>
 #include <inttypes.h>
 #include <filesystem>
-#include <string>
\ No newline at end of file
+#include <string>
+#include <map>
+#include <mutex>
+#include <vector>
\ No newline at end of file
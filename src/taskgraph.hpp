@@ -0,0 +1,110 @@
+#pragma once
+
+#include "profiler.hpp"
+#include "threadpool.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Runs a fixed set of tasks on a ThreadPool, each one as soon as everything it depends on has finished.
+//
+// A task can only depend on tasks added before it, so the graph can't have cycles. Run() blocks until every task
+// has finished and records when each one started and how long it took, in milliseconds from the time point it's
+// given, so startup can be logged against the moment the DLL was attached. Each task also goes to the Profiler.
+class TaskGraph
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Id = std::size_t;
+
+    struct Task
+    {
+        std::string name;
+        std::function<void()> fn;
+        std::vector<Id> successors;
+        std::size_t dependencies = 0;
+        double start = 0;       // ms from the time point passed to Run()
+        double duration = 0;    // ms
+    };
+
+    Id Add(std::string name, std::function<void()> fn, std::initializer_list<Id> after = {})
+    {
+        Id id = tasks.size();
+        tasks.push_back({ std::move(name), std::move(fn), {}, after.size() });
+        for (auto dependency : after) {
+            assert(dependency < id);
+            tasks[dependency].successors.push_back(id);
+        }
+        return id;
+    }
+
+    // Runs every task on pool, or inline on the calling thread with no pool.
+    void Run(ThreadPool* pool, Clock::time_point epoch = Clock::now())
+    {
+        if (tasks.empty())
+            return;
+
+        this->pool = pool;
+        this->epoch = epoch;
+        remaining = std::make_unique<std::atomic<std::size_t>[]>(tasks.size());
+        for (Id id = 0; id < tasks.size(); ++id)
+            remaining[id].store(tasks[id].dependencies, std::memory_order_relaxed);
+        finished = 0;
+
+        for (Id id = 0; id < tasks.size(); ++id) {
+            if (tasks[id].dependencies == 0)
+                Launch(id);
+        }
+
+        std::unique_lock lock(mutex);
+        done.wait(lock, [this] { return finished == tasks.size(); });
+    }
+
+    const std::vector<Task>& Tasks() const { return tasks; }
+
+private:
+    std::vector<Task> tasks;
+    std::unique_ptr<std::atomic<std::size_t>[]> remaining;
+    ThreadPool* pool = nullptr;
+    Clock::time_point epoch;
+    std::mutex mutex;
+    std::condition_variable done;
+    std::size_t finished = 0;
+
+    void Launch(Id id)
+    {
+        if (pool)
+            pool->Submit([this, id] { Execute(id); });
+        else
+            Execute(id);
+    }
+
+    void Execute(Id id)
+    {
+        auto& task = tasks[id];
+        auto start = Clock::now();
+        task.fn();
+        auto end = Clock::now();
+        task.start = std::chrono::duration<double, std::milli>(start - epoch).count();
+        task.duration = std::chrono::duration<double, std::milli>(end - start).count();
+        Profiler::Record(task.name.c_str(), "task", start, end);
+
+        for (auto successor : task.successors) {
+            if (remaining[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                Launch(successor);
+        }
+
+        std::scoped_lock lock(mutex);
+        if (++finished == tasks.size())
+            done.notify_all();
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size worker pool. The calling thread always takes part in ParallelFor, so a pool
+// created with one thread has no workers at all and runs everything inline.
+class ThreadPool
+{
+public:
+    // 0 picks the number of hardware threads.
+    explicit ThreadPool(std::size_t threads = 0)
+    {
+        if (threads == 0)
+            threads = (std::max)(1u, std::thread::hardware_concurrency());
+        for (std::size_t i = 1; i < threads; ++i)
+            workers.emplace_back([this] { WorkerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::scoped_lock lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Total threads including the caller.
+    std::size_t Size() const { return workers.size() + 1; }
+
+    void Submit(std::function<void()> task)
+    {
+        if (workers.empty()) {
+            task();
+            return;
+        }
+        {
+            std::scoped_lock lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // Runs fn(i) for every i in [0, count) and returns once all calls have finished.
+    // Indices are handed out in ascending order.
+    void ParallelFor(std::size_t count, const std::function<void(std::size_t)>& fn)
+    {
+        if (count == 0)
+            return;
+
+        struct Shared
+        {
+            std::atomic<std::size_t> next{ 0 };
+            std::atomic<std::size_t> done{ 0 };
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto shared = std::make_shared<Shared>();
+
+        auto drain = [shared, count, &fn] {
+            std::size_t completed = 0;
+            for (auto i = shared->next.fetch_add(1); i < count; i = shared->next.fetch_add(1)) {
+                fn(i);
+                ++completed;
+            }
+            if (completed && shared->done.fetch_add(completed) + completed == count) {
+                std::scoped_lock lock(shared->mutex);
+                shared->finished.notify_all();
+            }
+        };
+
+        auto helpers = (std::min)(workers.size(), count - 1);
+        for (std::size_t i = 0; i < helpers; ++i)
+            Submit(drain);
+        drain();
+
+        std::unique_lock lock(shared->mutex);
+        shared->finished.wait(lock, [&] { return shared->done.load() == count; });
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void WorkerLoop()
+    {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "pe.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <Zydis.h>
+
+// Cross-reference index of a module's code, built with one linear Zydis sweep of its executable sections.
+//
+// Records every direct call (caller -> callee) and every operand that names an address inside the image:
+// absolute and RIP-relative memory operands (including table bases like [eax*4 + table]), and on 32-bit, immediates
+// that hold an image address (push offset, mov reg, offset). Everything is stored as RVAs in sorted vectors, so
+// queries are binary searches and the index doesn't care where the image is loaded. Takes a few MB for a game
+// sized executable.
+//
+// A linear sweep can decode data embedded in code (jump tables, padding) as instructions, so treat the results as
+// candidates and check them, the same as a signature hit.
+namespace Xrefs
+{
+    struct Call
+    {
+        std::uint32_t from;     // the call instruction
+        std::uint32_t to;       // the callee
+    };
+
+    enum class Access : std::uint8_t
+    {
+        Address,                // the operand is the address itself: an immediate or lea
+        Read,
+        Write,
+        ReadWrite,
+    };
+
+    struct Reference
+    {
+        std::uint32_t from;     // the instruction
+        std::uint32_t to;       // the address it names
+        Access access;
+
+        bool Writes() const { return access == Access::Write || access == Access::ReadWrite; }
+    };
+
+    class Index
+    {
+    public:
+        // image is laid out at its RVAs: a loaded module, or a file mapped the way the loader would. addressBase is
+        // what absolute addresses in the code are relative to, which is the module's actual base once the loader
+        // has applied relocations, or headers.imageBase for a file on disk.
+        bool Build(const std::uint8_t* image, const Pe::Headers& headers, std::uint64_t addressBase)
+        {
+            calls.clear();
+            callsBySource.clear();
+            references.clear();
+            instructions = 0;
+            if (!headers.valid)
+                return false;
+
+            ZydisDecoder decoder;
+            if (ZYAN_FAILED(ZydisDecoderInit(&decoder, headers.is64 ? ZYDIS_MACHINE_MODE_LONG_64 : ZYDIS_MACHINE_MODE_LEGACY_32,
+                headers.is64 ? ZYDIS_STACK_WIDTH_64 : ZYDIS_STACK_WIDTH_32)))
+                return false;
+
+            const std::uint64_t addressMask = headers.is64 ? ~0ull : 0xFFFFFFFFull;
+            auto toRva = [&](std::uint64_t address, std::uint32_t& rva) {
+                auto offset = (address - addressBase) & addressMask;
+                if (offset >= headers.sizeOfImage)
+                    return false;
+                rva = static_cast<std::uint32_t>(offset);
+                return true;
+            };
+
+            ZydisDecodedInstruction instruction;
+            ZydisDecodedOperand operands[ZYDIS_MAX_OPERAND_COUNT];
+            for (const auto& section : headers.sections) {
+                if (!section.IsCode())
+                    continue;
+                std::uint32_t rva = section.virtualAddress;
+                const std::uint32_t end = (std::min)(section.virtualAddress + section.virtualSize, headers.sizeOfImage);
+                while (rva < end) {
+                    if (ZYAN_FAILED(ZydisDecoderDecodeFull(&decoder, image + rva, end - rva, &instruction, operands))) {
+                        ++rva;
+                        continue;
+                    }
+                    ++instructions;
+                    const std::uint64_t runtimeAddress = addressBase + rva;
+
+                    for (std::uint8_t i = 0; i < instruction.operand_count_visible; ++i) {
+                        const auto& operand = operands[i];
+                        std::uint32_t target;
+
+                        if (operand.type == ZYDIS_OPERAND_TYPE_IMMEDIATE) {
+                            if (operand.imm.is_relative) {
+                                std::uint64_t address;
+                                if (instruction.meta.category == ZYDIS_CATEGORY_CALL &&
+                                    ZYAN_SUCCESS(ZydisCalcAbsoluteAddress(&instruction, &operand, runtimeAddress, &address)) &&
+                                    toRva(address, target))
+                                    calls.push_back({ rva, target });
+                            }
+                            // 32-bit code puts addresses in immediates, 64-bit code uses RIP-relative lea instead.
+                            else if (!headers.is64 && operand.size == 32 && toRva(operand.imm.value.u, target)) {
+                                references.push_back({ rva, target, Access::Address });
+                            }
+                        }
+                        else if (operand.type == ZYDIS_OPERAND_TYPE_MEMORY) {
+                            const auto& mem = operand.mem;
+                            if (mem.type != ZYDIS_MEMOP_TYPE_MEM && mem.type != ZYDIS_MEMOP_TYPE_AGEN)
+                                continue;
+                            if (mem.segment == ZYDIS_REGISTER_FS || mem.segment == ZYDIS_REGISTER_GS)
+                                continue;
+
+                            std::uint64_t address;
+                            if (mem.base == ZYDIS_REGISTER_RIP || mem.base == ZYDIS_REGISTER_EIP)
+                                address = runtimeAddress + instruction.length + mem.disp.value;
+                            else if (mem.base == ZYDIS_REGISTER_NONE && mem.disp.has_displacement)
+                                address = static_cast<std::uint64_t>(mem.disp.value);
+                            else
+                                continue;
+                            if (!toRva(address, target))
+                                continue;
+
+                            references.push_back({ rva, target, AccessOf(operand) });
+                        }
+                    }
+                    rva += instruction.length;
+                }
+            }
+
+            std::sort(calls.begin(), calls.end(), [](const Call& a, const Call& b) {
+                return a.to != b.to ? a.to < b.to : a.from < b.from;
+            });
+            callsBySource.resize(calls.size());
+            for (std::uint32_t i = 0; i < calls.size(); ++i)
+                callsBySource[i] = i;
+            std::sort(callsBySource.begin(), callsBySource.end(), [this](std::uint32_t a, std::uint32_t b) {
+                return calls[a].from < calls[b].from;
+            });
+            std::sort(references.begin(), references.end(), [](const Reference& a, const Reference& b) {
+                return a.to != b.to ? a.to < b.to : a.from < b.from;
+            });
+            return true;
+        }
+
+        // Every direct call to callee, ordered by call site.
+        std::span<const Call> CallersOf(std::uint32_t callee) const
+        {
+            auto [first, last] = std::equal_range(calls.begin(), calls.end(), Call{ 0, callee },
+                [](const Call& a, const Call& b) { return a.to < b.to; });
+            return { first, last };
+        }
+
+        // Callee of the direct call instruction starting at callSite, or 0 if there isn't one.
+        std::uint32_t CalleeAt(std::uint32_t callSite) const
+        {
+            auto it = std::lower_bound(callsBySource.begin(), callsBySource.end(), callSite,
+                [this](std::uint32_t index, std::uint32_t rva) { return calls[index].from < rva; });
+            if (it == callsBySource.end() || calls[*it].from != callSite)
+                return 0;
+            return calls[*it].to;
+        }
+
+        // Direct calls made from instructions in [begin, end), such as a function body, ordered by call site.
+        std::vector<Call> CallsFrom(std::uint32_t begin, std::uint32_t end) const
+        {
+            auto it = std::lower_bound(callsBySource.begin(), callsBySource.end(), begin,
+                [this](std::uint32_t index, std::uint32_t rva) { return calls[index].from < rva; });
+            std::vector<Call> result;
+            for (; it != callsBySource.end() && calls[*it].from < end; ++it)
+                result.push_back(calls[*it]);
+            return result;
+        }
+
+        // Instructions naming an address in [begin, end), ordered by address and then by instruction.
+        std::span<const Reference> ReferencesTo(std::uint32_t begin, std::uint32_t end) const
+        {
+            auto first = std::lower_bound(references.begin(), references.end(), begin,
+                [](const Reference& reference, std::uint32_t rva) { return reference.to < rva; });
+            auto last = std::lower_bound(first, references.end(), end,
+                [](const Reference& reference, std::uint32_t rva) { return reference.to < rva; });
+            return { first, last };
+        }
+
+        std::span<const Reference> ReferencesTo(std::uint32_t rva) const
+        {
+            return ReferencesTo(rva, rva + 1);
+        }
+
+        // Instructions that write to rva directly.
+        std::vector<std::uint32_t> WritersOf(std::uint32_t rva) const
+        {
+            std::vector<std::uint32_t> result;
+            for (const auto& reference : ReferencesTo(rva)) {
+                if (reference.Writes())
+                    result.push_back(reference.from);
+            }
+            return result;
+        }
+
+        std::size_t Instructions() const { return instructions; }
+        std::size_t Calls() const { return calls.size(); }
+        std::size_t References() const { return references.size(); }
+
+        std::size_t MemoryUsed() const
+        {
+            return calls.capacity() * sizeof(Call) + callsBySource.capacity() * sizeof(std::uint32_t) +
+                references.capacity() * sizeof(Reference);
+        }
+
+    private:
+        std::vector<Call> calls;                    // by callee, then call site
+        std::vector<std::uint32_t> callsBySource;   // indices into calls, by call site
+        std::vector<Reference> references;          // by address, then instruction
+        std::size_t instructions = 0;
+
+        static Access AccessOf(const ZydisDecodedOperand& operand)
+        {
+            if (operand.mem.type == ZYDIS_MEMOP_TYPE_AGEN)
+                return Access::Address;
+            bool reads = (operand.actions & ZYDIS_OPERAND_ACTION_MASK_READ) != 0;
+            bool writes = (operand.actions & ZYDIS_OPERAND_ACTION_MASK_WRITE) != 0;
+            if (reads && writes)
+                return Access::ReadWrite;
+            return writes ? Access::Write : Access::Read;
+        }
+    };
+}
@@ -0,0 +1,154 @@
+// allocbench: times safetyhook's near allocator with thousands of trampoline and stub sized allocations.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++23 -O2 -Iexternal/safetyhook tools/allocbench.cpp -o allocbench
+//
+// Usage:
+//   allocbench [--count 4096] [--rounds 5] [--seed 1]
+//
+// Hook targets are random addresses inside a reserved 256 MiB region standing in for the game module. Each round
+// uses a fresh Allocator and runs these phases, printing the mean ns per operation:
+//   near:   count allocate_near() calls of 12-40 bytes, the size of a trampoline
+//   churn:  free a random half, then allocate as many again
+//   fixed:  count allocate_fixed_near() calls of one mid hook stub
+//   free:   free everything in random order
+// "blocks" is how many allocation granularity sized blocks the live allocations are spread over.
+
+#include "safetyhook.cpp"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+// The allocator never decodes anything. These stand in for Zydis.c so the tool links on its own.
+extern "C" ZyanStatus ZydisDecoderInit(ZydisDecoder*, ZydisMachineMode, ZydisStackWidth)
+{
+    return ZYAN_STATUS_FAILED;
+}
+
+extern "C" ZyanStatus ZydisDecoderDecodeInstruction(
+    const ZydisDecoder*, ZydisDecoderContext*, const void*, ZyanUSize, ZydisDecodedInstruction*)
+{
+    return ZYAN_STATUS_FAILED;
+}
+
+namespace
+{
+    constexpr size_t StubSize = 171; // 32-bit mid hook stub
+
+    using Clock = std::chrono::steady_clock;
+
+    double NanosecondsPer(Clock::time_point start, size_t operations)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(operations);
+    }
+
+    size_t BlocksUsed(const std::vector<safetyhook::Allocation>& allocations)
+    {
+        const auto granularity = safetyhook::system_info().allocation_granularity;
+        std::set<uintptr_t> blocks;
+        for (const auto& allocation : allocations) {
+            if (allocation)
+                blocks.insert(allocation.address() / granularity);
+        }
+        return blocks.size();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = 4096;
+    int rounds = 5;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--count") == 0)
+            count = strtoul(argv[i + 1], nullptr, 10);
+        else if (strcmp(argv[i], "--rounds") == 0)
+            rounds = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seed") == 0)
+            seed = static_cast<unsigned>(strtoul(argv[i + 1], nullptr, 10));
+    }
+
+    const size_t moduleSize = 256 << 20;
+    auto* module = static_cast<uint8_t*>(mmap(nullptr, moduleSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (module == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t*> targets(count);
+    std::vector<size_t> sizes(count);
+    for (size_t i = 0; i < count; ++i) {
+        targets[i] = module + rng() % moduleSize;
+        sizes[i] = 12 + rng() % 29;
+    }
+
+    printf("%zu allocations, %d round(s), ns per operation:\n", count, rounds);
+    printf("  %-6s %10s %10s %10s %10s %8s %8s\n", "round", "near", "churn", "fixed", "free", "blocks", "stubblk");
+    double totals[4] = {};
+    for (int round = 0; round < rounds; ++round) {
+        auto allocator = safetyhook::Allocator::create();
+        std::vector<safetyhook::Allocation> allocations;
+        allocations.reserve(count * 2);
+        double times[4];
+
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            if (auto allocation = allocator->allocate_near({ targets[i] }, sizes[i]))
+                allocations.push_back(std::move(*allocation));
+        }
+        times[0] = NanosecondsPer(start, count);
+        auto blocks = BlocksUsed(allocations);
+
+        std::vector<size_t> order(allocations.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+        start = Clock::now();
+        for (size_t i = 0; i < order.size() / 2; ++i)
+            allocations[order[i]].free();
+        for (size_t i = 0; i < order.size() / 2; ++i) {
+            auto index = order[i];
+            if (auto allocation = allocator->allocate_near({ targets[index] }, sizes[(index * 7) % count]))
+                allocations[index] = std::move(*allocation);
+        }
+        times[1] = NanosecondsPer(start, order.size());
+
+        std::vector<safetyhook::Allocation> stubs;
+        stubs.reserve(count);
+        start = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            if (auto allocation = allocator->allocate_fixed_near({ targets[i] }, StubSize))
+                stubs.push_back(std::move(*allocation));
+        }
+        times[2] = NanosecondsPer(start, count);
+        auto stubBlocks = BlocksUsed(stubs);
+
+        for (auto& stub : stubs)
+            allocations.push_back(std::move(stub));
+        order.resize(allocations.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+        start = Clock::now();
+        for (auto index : order)
+            allocations[index].free();
+        times[3] = NanosecondsPer(start, order.size());
+
+        printf("  %-6d %10.1f %10.1f %10.1f %10.1f %8zu %8zu\n", round + 1, times[0], times[1], times[2], times[3], blocks, stubBlocks);
+        for (int i = 0; i < 4; ++i)
+            totals[i] += times[i];
+    }
+    printf("  %-6s %10.1f %10.1f %10.1f %10.1f\n", "mean", totals[0] / rounds, totals[1] / rounds, totals[2] / rounds, totals[3] / rounds);
+
+    munmap(module, moduleSize);
+    return 0;
+}
@@ -0,0 +1,112 @@
+// fovcheck: accuracy and speed of the FOV conversion in src/fovmath.hpp.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++20 -O2 -Isrc tools/fovcheck.cpp -o fovcheck
+//
+// Usage:
+//   fovcheck [--stride N]
+//
+// Compares FovMath::Fast() against the original libm expression and against a double precision result for every
+// float in (0, 180) degrees (every Nth with --stride) at a range of narrower than 16:9 aspect ratios, then times
+// the libm path, the polynomial path and a memo hit in ns per call.
+
+#include "fovmath.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Distance in representable floats, for finite values of the same sign.
+    std::int64_t UlpDistance(float a, float b)
+    {
+        return std::abs(static_cast<std::int64_t>(std::bit_cast<std::int32_t>(a)) - std::bit_cast<std::int32_t>(b));
+    }
+
+    struct Aspect
+    {
+        const char* name;
+        float ratio;
+    };
+
+    const Aspect Aspects[] = {
+        { "16:10", 16.0f / 10 }, { "3:2", 3.0f / 2 }, { "4:3", 4.0f / 3 }, { "5:4", 5.0f / 4 },
+        { "1:1", 1.0f }, { "9:16", 9.0f / 16 }, { "1:2", 1.0f / 2 },
+    };
+
+    template<typename Fn>
+    double NanosecondsPerCall(const std::vector<float>& inputs, int rounds, Fn fn)
+    {
+        volatile float sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            for (auto input : inputs)
+                sink = sink + fn(input);
+        }
+        auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        return elapsed / (static_cast<double>(inputs.size()) * rounds);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::uint32_t stride = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--stride") == 0)
+            stride = (std::max)(1ul, strtoul(argv[i + 1], nullptr, 10));
+    }
+
+    const float nativeAspect = 16.0f / 9;
+    // Inputs small enough that the half angle in radians is subnormal are left out. Every path loses most of its
+    // bits there, and no camera gets anywhere near 1e-36 degrees.
+    const auto first = std::bit_cast<std::uint32_t>(FLT_MIN / (FovMath::Pi / 360)) + 1;
+    const auto last = std::bit_cast<std::uint32_t>(180.0f);
+
+    printf("Accuracy, every %u%s float in (0, 180):\n", stride, stride == 1 ? "st" : "th");
+    printf("  %-6s %14s %16s %14s %16s\n", "Aspect", "vs libm (ulp)", "vs libm (deg)", "vs exact (ulp)", "libm vs exact");
+    std::int64_t worstUlp = 0;
+    double worstDegrees = 0;
+    for (const auto& aspect : Aspects) {
+        float scale = nativeAspect / aspect.ratio;
+        std::int64_t maxUlp = 0, maxExactUlp = 0, maxLibmExactUlp = 0;
+        double maxDegrees = 0;
+        for (std::uint32_t bits = first; bits < last; bits += stride) {
+            float fov = std::bit_cast<float>(bits);
+            float fast = FovMath::Fast(fov, scale);
+            float libm = FovMath::Reference(fov, aspect.ratio, nativeAspect);
+            double h = static_cast<double>(fov * (FovMath::Pi / 360));
+            float exact = static_cast<float>(atan(tan(h) * nativeAspect / aspect.ratio) * (360 / 3.14159265358979323846));
+
+            maxUlp = (std::max)(maxUlp, UlpDistance(fast, libm));
+            maxExactUlp = (std::max)(maxExactUlp, UlpDistance(fast, exact));
+            maxLibmExactUlp = (std::max)(maxLibmExactUlp, UlpDistance(libm, exact));
+            maxDegrees = (std::max)(maxDegrees, std::fabs(static_cast<double>(fast) - libm));
+        }
+        printf("  %-6s %14lld %16.3g %14lld %16lld\n", aspect.name, static_cast<long long>(maxUlp), maxDegrees,
+            static_cast<long long>(maxExactUlp), static_cast<long long>(maxLibmExactUlp));
+        worstUlp = (std::max)(worstUlp, maxUlp);
+        worstDegrees = (std::max)(worstDegrees, maxDegrees);
+    }
+    printf("  Worst: %lld ulp, %.3g degrees\n\n", static_cast<long long>(worstUlp), worstDegrees);
+
+    // Timing over typical in-game FOVs.
+    std::vector<float> inputs;
+    for (int i = 0; i < 4096; ++i)
+        inputs.push_back(30.0f + 60.0f * i / 4096);
+    const float aspectRatio = 4.0f / 3;
+    const float scale = nativeAspect / aspectRatio;
+    const int rounds = 2000;
+
+    printf("Speed (ns per call):\n");
+    printf("  libm:       %.2f\n", NanosecondsPerCall(inputs, rounds, [&](float fov) { return FovMath::Reference(fov, aspectRatio, nativeAspect); }));
+    printf("  polynomial: %.2f\n", NanosecondsPerCall(inputs, rounds, [&](float fov) { return FovMath::Fast(fov, scale); }));
+    std::vector<float> repeated(inputs.size(), 65.0f);
+    printf("  memo hit:   %.2f\n", NanosecondsPerCall(repeated, rounds, [&](float fov) { return FovMath::Transform(fov, scale, 1); }));
+    return 0;
+}
@@ -0,0 +1,302 @@
+// hookbatchcheck: runs safetyhook's HookBatch against real code on Linux x86-64 and checks what every commit
+// leaves behind.
+//
+// Build (Linux x86-64, from the repository root):
+//   g++ -std=c++23 -O2 -Iexternal/safetyhook tools/hookbatchcheck.cpp -o hookbatchcheck
+//
+// Usage:
+//   hookbatchcheck [--count 16]
+//
+// Copies --count small functions into executable memory and mid hooks all of them in one batch. Checks that one
+// commit turns every hook on, that enable/disable round trips put the original bytes back each time, that
+// toggles with nothing to change are skipped, that a hook that fails to build or a target that can't be made
+// writable resets every hook the batch added and leaves every target as it was while the disables still go
+// through, and that destroying the hooks restores the code. Prints each failure and exits with 1 if there were
+// any.
+
+#include "safetyhook.cpp"
+
+#include <sys/mman.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    // lea eax, [rdi + 1] followed by two 8 byte nops and a ret, so there's room for a jmp and a known result.
+    constexpr uint8_t Function[] = {
+        0x8D, 0x47, 0x01,
+        0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xC3,
+    };
+    constexpr size_t Stride = 64;
+    constexpr size_t Page = 4096;
+
+    int failures = 0;
+    int calls = 0;
+
+    void Fail(const char* what)
+    {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+
+    // The callback makes a hooked function return 101 for an argument of 1, an unhooked one returns 2.
+    void Callback(SafetyHookContext& ctx)
+    {
+        ctx.rdi = 100;
+        ++calls;
+    }
+
+    using Target = int (*)(int);
+}
+
+// Decodes just the instructions in Function, so the tool doesn't need Zydis.c. Anything else fails to decode,
+// which is how a hook is made to fail in add().
+extern "C" ZyanStatus ZydisDecoderInit(ZydisDecoder*, ZydisMachineMode, ZydisStackWidth)
+{
+    return ZYAN_STATUS_SUCCESS;
+}
+
+extern "C" ZyanStatus ZydisDecoderDecodeInstruction(
+    const ZydisDecoder*, ZydisDecoderContext*, const void* buffer, ZyanUSize, ZydisDecodedInstruction* ix)
+{
+    memset(ix, 0, sizeof(*ix));
+    auto p = static_cast<const uint8_t*>(buffer);
+    if (p[0] == 0x8D)
+        ix->length = 3;
+    else if (p[0] == 0x0F && p[1] == 0x1F)
+        ix->length = 8;
+    else if (p[0] == 0xC3)
+        ix->length = 1;
+    else
+        return ZYAN_STATUS_INVALID_ARGUMENT;
+    return ZYAN_STATUS_SUCCESS;
+}
+
+namespace
+{
+    struct Code
+    {
+        uint8_t* base = nullptr;
+        size_t size = 0;
+        size_t count = 0;
+        std::vector<uint8_t> original;
+
+        uint8_t* At(size_t i) const { return base + i * Stride; }
+        uint8_t* Bad() const { return base + count * Stride; }     // int3s, which don't decode
+        uint8_t* Victim() const { return base + size - Page; }     // alone on the last page
+
+        int Call(uint8_t* function) const { return reinterpret_cast<Target volatile>(function)(1); }
+        bool Unchanged() const { return memcmp(base, original.data(), size - Page) == 0; }
+    };
+
+    // Every function in [first, last) returns expected and the callback runs for each that's hooked.
+    void Expect(const char* what, const Code& code, size_t first, size_t last, int expected)
+    {
+        calls = 0;
+        bool wrong = false;
+        for (size_t i = first; i < last; ++i)
+            wrong |= code.Call(code.At(i)) != expected;
+        int hooked = expected == 101 ? static_cast<int>(last - first) : 0;
+        if (wrong || calls != hooked) {
+            printf("FAIL: %s: functions %zu-%zu don't return %d (%d callbacks, expected %d)\n", what, first, last - 1,
+                expected, calls, hooked);
+            ++failures;
+        }
+    }
+
+    void Commit(const char* what, safetyhook::HookBatch& batch)
+    {
+        if (!batch.commit()) {
+            printf("FAIL: %s: commit failed\n", what);
+            ++failures;
+        }
+        if (batch.size() != 0)
+            Fail("batch isn't empty after a commit");
+    }
+
+    bool AllReset(const std::vector<SafetyHookMid>& hooks, size_t first, size_t last)
+    {
+        for (size_t i = first; i < last; ++i) {
+            if (hooks[i])
+                return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t count = 16;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--count") == 0)
+            count = (std::max)(strtoul(argv[i + 1], nullptr, 10), 2ul);
+    }
+
+    // The functions and a run of int3s after them, then a page of its own for the victim function.
+    Code code;
+    code.count = count;
+    code.size = (count + 1) * Stride / Page * Page + 2 * Page;
+    auto mapping = mmap(nullptr, code.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        Fail("couldn't map the code");
+        return 1;
+    }
+    code.base = static_cast<uint8_t*>(mapping);
+    memset(code.base, 0xCC, code.size);
+    for (size_t i = 0; i < count; ++i)
+        memcpy(code.At(i), Function, sizeof(Function));
+    memcpy(code.Victim(), Function, sizeof(Function));
+    mprotect(code.base, code.size, PROT_READ | PROT_EXEC);
+    code.original.assign(code.base, code.base + code.size);
+
+    safetyhook::HookBatch batch;
+    std::vector<SafetyHookMid> hooks(count);
+
+    // Adding builds but doesn't write anything.
+    for (size_t i = 0; i < count; ++i)
+        batch.add(hooks[i], code.At(i), Callback);
+    if (batch.size() != count)
+        Fail("batch doesn't hold every add");
+    if (!code.Unchanged())
+        Fail("add wrote to a target before the commit");
+    Expect("added", code, 0, count, 2);
+
+    // One commit turns them all on.
+    Commit("add", batch);
+    Expect("committed", code, 0, count, 101);
+
+    // Round trips, alternating halves and everything.
+    for (int round = 0; round < 3; ++round) {
+        for (auto& hook : hooks)
+            batch.disable(hook);
+        Commit("disable", batch);
+        Expect("disabled", code, 0, count, 2);
+        if (!code.Unchanged())
+            Fail("disable didn't put the original bytes back");
+
+        for (size_t i = 0; i < count / 2; ++i)
+            batch.enable(hooks[i]);
+        Commit("enable half", batch);
+        Expect("half enabled", code, 0, count / 2, 101);
+        Expect("half enabled", code, count / 2, count, 2);
+
+        for (auto& hook : hooks)
+            batch.enable(hook);
+        Commit("enable", batch);
+        Expect("enabled", code, 0, count, 101);
+    }
+
+    // Toggles that change nothing are skipped, including an enable of a hook that was never built.
+    {
+        SafetyHookMid empty;
+        for (auto& hook : hooks)
+            batch.enable(hook);
+        batch.enable(empty);
+        Commit("no-op enable", batch);
+        Expect("no-op enable", code, 0, count, 101);
+        if (empty)
+            Fail("enable built an empty hook");
+
+        batch.disable(hooks[0]);
+        Commit("disable one", batch);
+        batch.disable(hooks[0]);
+        batch.disable(hooks[0]);
+        Commit("no-op disable", batch);
+        Expect("no-op disable", code, 0, 1, 2);
+        Expect("no-op disable", code, 1, count, 101);
+        batch.enable(hooks[0]);
+        Commit("enable one", batch);
+    }
+
+    // A hook that fails to build resets everything the batch added. The disable in the same batch still goes
+    // through, and the hooks from earlier commits stay as they were.
+    {
+        // Take the first half off so there's room to add them again.
+        std::vector<SafetyHookMid> added(count);
+        for (size_t i = 0; i < count / 2; ++i)
+            hooks[i] = {};
+        std::vector<uint8_t> before(code.base, code.base + code.size - Page);
+        for (size_t i = 0; i < count / 2; ++i)
+            batch.add(added[i], code.At(i), Callback);
+        SafetyHookMid bad;
+        auto badIndex = batch.add(bad, code.Bad(), Callback);
+        batch.disable(hooks[count - 1]);
+
+        auto result = batch.commit();
+        if (result)
+            Fail("a batch with a bad hook committed");
+        else if (result.error().index != badIndex)
+            Fail("the error doesn't point at the bad hook");
+        if (batch.size() != 0)
+            Fail("batch isn't empty after a failed commit");
+        if (!AllReset(added, 0, count / 2) || bad)
+            Fail("failed commit left an added hook built");
+        Expect("failed add", code, 0, count / 2, 2);
+        Expect("failed add", code, count / 2, count - 1, 101);
+        Expect("failed add, disable", code, count - 1, count, 2);
+        if (memcmp(code.base, before.data(), count / 2 * Stride) != 0)
+            Fail("failed add changed the bytes of a target it added");
+
+        // The batch is usable again straight away.
+        for (size_t i = 0; i < count / 2; ++i)
+            batch.add(hooks[i], code.At(i), Callback);
+        batch.enable(hooks[count - 1]);
+        Commit("add after a failed commit", batch);
+        Expect("added again", code, 0, count, 101);
+    }
+
+    // A target that can't be made writable fails the commit before anything is frozen or written, and again
+    // everything the batch added is reset.
+    {
+        std::vector<SafetyHookMid> added(count);
+        for (size_t i = 0; i < count / 2; ++i)
+            hooks[i] = {};
+        std::vector<uint8_t> before(code.base, code.base + code.size - Page);
+        for (size_t i = 0; i < count / 2; ++i)
+            batch.add(added[i], code.At(i), Callback);
+        SafetyHookMid victim;
+        auto victimIndex = batch.add(victim, code.Victim(), Callback);
+        if (!victim)
+            Fail("the victim hook didn't build");
+        munmap(code.Victim(), Page);
+
+        auto result = batch.commit();
+        if (result) {
+            Fail("a batch with an unwritable target committed");
+        }
+        else {
+            const auto& error = result.error();
+            if (error.index != victimIndex || error.type != safetyhook::HookBatch::Error::BAD_MID_HOOK ||
+                error.mid_hook_error.inline_hook_error.type != safetyhook::InlineHook::Error::FAILED_TO_UNPROTECT)
+                Fail("the error doesn't say the victim couldn't be unprotected");
+        }
+        if (!AllReset(added, 0, count / 2) || victim)
+            Fail("failed commit left an added hook built");
+        if (memcmp(code.base, before.data(), before.size()) != 0)
+            Fail("a commit that failed to unprotect changed a target");
+        Expect("failed unprotect", code, 0, count / 2, 2);
+        Expect("failed unprotect", code, count / 2, count, 101);
+        code.size -= Page;
+
+        for (size_t i = 0; i < count / 2; ++i)
+            batch.add(hooks[i], code.At(i), Callback);
+        Commit("add after a failed unprotect", batch);
+        Expect("added again", code, 0, count, 101);
+    }
+
+    // Destroying the hooks takes them out.
+    hooks.clear();
+    Expect("destroyed", code, 0, count, 2);
+    if (memcmp(code.base, code.original.data(), code.size) != 0)
+        Fail("destroyed hooks left bytes behind");
+
+    munmap(code.base, code.size);
+    printf("%zu hooks: %s\n", count, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
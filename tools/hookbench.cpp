@@ -0,0 +1,321 @@
+// hookbench: per-call overhead and create/destroy cost of the hooks the fix uses, on Linux x86-64.
+//
+// Links against Zydis.o, which isn't checked in. tools/README.md says where Zydis.c comes from.
+//
+// Build (Linux x86-64, from the repository root):
+//   gcc -O2 -c external/safetyhook/Zydis.c -o Zydis.o
+//   g++ -std=c++23 -O2 -DNDEBUG -Isrc -Iexternal/safetyhook tools/hookbench.cpp Zydis.o -o hookbench
+//
+// Usage:
+//   hookbench [--calls 10000000] [--repeat 5] [--counts 1,16,128,1024] [--out results.json]
+//
+// Hooks synthetic int(int) functions with the vendored safetyhook's Linux backend and times calls through them,
+// best of --repeat runs, in ns per call:
+//   none           the bare function
+//   inline         InlineHook whose detour calls the original with call(), which takes the hook's mutex
+//   inline-unsafe  the same with unsafe_call()
+//   mid-empty      safetyhook MidHook with an empty callback
+//   mid-write      safetyhook MidHook whose callback changes the argument register
+//   lite-empty     LiteHook::MidHook<0>, src/litehook.hpp, with an empty callback
+//   lite-write     LiteHook::MidHook<Rdi> changing the argument register
+// overheadNs is the difference to "none". Every hook is called once first and its result checked.
+//
+// Then, for each of --counts, creates that many hooks on different functions, and destroys them again, in ns per
+// hook: inline and mid one create() at a time, batch-mid through one HookBatch commit, the way the fix installs
+// its hooks.
+//
+// The JSON goes to --out, or stdout, and a summary to stderr. Exits with 1 if a hook failed or returned the wrong
+// result.
+
+#include "safetyhook.cpp"
+#include "litehook.hpp"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+    using Target = int (*)(int);
+
+    // lea eax, [rdi + 1]; two 8-byte nops; ret. Long enough for the 14-byte absolute jump with nothing relative
+    // in it, so every hook type takes the same path through the trampoline builder.
+    constexpr std::uint8_t TargetCode[] = {
+        0x8D, 0x47, 0x01,
+        0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0xC3,
+    };
+    constexpr std::size_t TargetSlot = 32;
+
+    // Copies of TargetCode in read-only executable memory, like the game's code.
+    class Targets
+    {
+    public:
+        explicit Targets(std::size_t count) : size((count * TargetSlot + 4095) & ~std::size_t(4095))
+        {
+            auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                return;
+            base = static_cast<std::uint8_t*>(memory);
+            memset(base, 0xCC, size);
+            for (std::size_t i = 0; i < count; ++i)
+                memcpy(base + i * TargetSlot, TargetCode, sizeof(TargetCode));
+            mprotect(base, size, PROT_READ | PROT_EXEC);
+        }
+
+        ~Targets()
+        {
+            if (base)
+                munmap(base, size);
+        }
+
+        Targets(const Targets&) = delete;
+        Targets& operator=(const Targets&) = delete;
+
+        explicit operator bool() const { return base != nullptr; }
+        std::uint8_t* Address(std::size_t i) const { return base + i * TargetSlot; }
+        Target Function(std::size_t i) const { return reinterpret_cast<Target>(Address(i)); }
+
+    private:
+        std::uint8_t* base = nullptr;
+        std::size_t size;
+    };
+
+    volatile int sink;
+
+    // Best of repeat runs, in ns per call. The volatile pointer keeps the compiler from looking through the call.
+    double NanosecondsPerCall(Target function, std::size_t calls, int repeat)
+    {
+        Target volatile target = function;
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < repeat; ++run) {
+            int sum = 0;
+            auto start = Clock::now();
+            for (std::size_t i = 0; i < calls; ++i)
+                sum += target(static_cast<int>(i));
+            auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+            sink = sum;
+            best = (std::min)(best, elapsed / static_cast<double>(calls));
+        }
+        return best;
+    }
+
+    // Owned by main(), so they're removed before the functions they hook are unmapped.
+    safetyhook::InlineHook* inlineHook;
+    safetyhook::InlineHook* inlineUnsafeHook;
+
+    int InlineDetour(int x) { return inlineHook->call<int>(x); }
+    int InlineUnsafeDetour(int x) { return inlineUnsafeHook->unsafe_call<int>(x); }
+    int Unused(int x) { return x; }
+
+    struct CallCase
+    {
+        const char* name;
+        int expected;               // result for an argument of 1
+        double ns = 0;
+    };
+
+    struct LifecycleCase
+    {
+        const char* kind;
+        std::size_t hooks;
+        double createNs;
+        double destroyNs;
+    };
+
+    double NanosecondsPer(Clock::time_point start, std::size_t count)
+    {
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(count);
+    }
+
+    // Creates count hooks of one kind and then destroys them, timing both. Returns false if any create failed.
+    bool Lifecycle(const char* kind, std::size_t count, std::vector<LifecycleCase>& results)
+    {
+        Targets targets(count);
+        if (!targets) {
+            results.push_back({ kind, count, 0, 0 });
+            return false;
+        }
+
+        bool ok = true;
+        double createNs = 0;
+        double destroyNs = 0;
+        if (strcmp(kind, "inline") == 0) {
+            std::vector<safetyhook::InlineHook> hooks;
+            hooks.reserve(count);
+            auto start = Clock::now();
+            for (std::size_t i = 0; i < count; ++i) {
+                auto hook = safetyhook::InlineHook::create(targets.Address(i), reinterpret_cast<void*>(&Unused));
+                if (!hook) {
+                    ok = false;
+                    break;
+                }
+                hooks.push_back(std::move(*hook));
+            }
+            createNs = NanosecondsPer(start, count);
+            start = Clock::now();
+            hooks.clear();
+            destroyNs = NanosecondsPer(start, count);
+        }
+        else if (strcmp(kind, "mid") == 0) {
+            std::vector<safetyhook::MidHook> hooks;
+            hooks.reserve(count);
+            auto start = Clock::now();
+            for (std::size_t i = 0; i < count; ++i) {
+                auto hook = safetyhook::MidHook::create(targets.Address(i), [](safetyhook::Context&) {});
+                if (!hook) {
+                    ok = false;
+                    break;
+                }
+                hooks.push_back(std::move(*hook));
+            }
+            createNs = NanosecondsPer(start, count);
+            start = Clock::now();
+            hooks.clear();
+            destroyNs = NanosecondsPer(start, count);
+        }
+        else {
+            std::vector<safetyhook::MidHook> hooks(count);
+            auto start = Clock::now();
+            safetyhook::HookBatch batch;
+            for (std::size_t i = 0; i < count; ++i)
+                batch.add(hooks[i], targets.Address(i), [](safetyhook::Context&) {});
+            ok = batch.commit().has_value();
+            createNs = NanosecondsPer(start, count);
+            start = Clock::now();
+            hooks.clear();
+            destroyNs = NanosecondsPer(start, count);
+        }
+
+        results.push_back({ kind, count, createNs, destroyNs });
+        return ok;
+    }
+
+    std::vector<std::size_t> ParseList(const char* text)
+    {
+        std::vector<std::size_t> values;
+        for (auto current = text; *current;) {
+            char* end;
+            values.push_back(strtoul(current, &end, 10));
+            current = *end == ',' ? end + 1 : end;
+            if (end == current && *end)
+                break;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t calls = 10'000'000;
+    int repeat = 5;
+    std::vector<std::size_t> counts = { 1, 16, 128, 1024 };
+    const char* outPath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--calls") == 0)
+            calls = (std::max)(1ul, strtoul(argv[i + 1], nullptr, 10));
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = (std::max)(1, atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--counts") == 0)
+            counts = ParseList(argv[i + 1]);
+        else if (strcmp(argv[i], "--out") == 0)
+            outPath = argv[i + 1];
+    }
+
+    // One function per case, so every hook stays installed and they can't interfere with each other.
+    CallCase cases[] = {
+        { "none", 2 },
+        { "inline", 2 },
+        { "inline-unsafe", 2 },
+        { "mid-empty", 2 },
+        { "mid-write", 3 },
+        { "lite-empty", 2 },
+        { "lite-write", 3 },
+    };
+    constexpr std::size_t CaseCount = std::size(cases);
+    Targets targets(CaseCount);
+    if (!targets) {
+        fprintf(stderr, "hookbench: can't map target functions\n");
+        return 2;
+    }
+
+    bool ok = true;
+    auto inlineResult = safetyhook::InlineHook::create(targets.Address(1), reinterpret_cast<void*>(&InlineDetour));
+    auto inlineUnsafeResult = safetyhook::InlineHook::create(targets.Address(2), reinterpret_cast<void*>(&InlineUnsafeDetour));
+    auto midEmpty = safetyhook::MidHook::create(targets.Address(3), [](safetyhook::Context&) {});
+    auto midWrite = safetyhook::MidHook::create(targets.Address(4), [](safetyhook::Context& ctx) { ctx.rdi += 1; });
+    ok &= inlineResult.has_value() && inlineUnsafeResult.has_value() && midEmpty.has_value() && midWrite.has_value();
+    if (ok) {
+        inlineHook = &*inlineResult;
+        inlineUnsafeHook = &*inlineUnsafeResult;
+    }
+
+    LiteHook::MidHook<0> liteEmpty;
+    LiteHook::MidHook<LiteHook::Rdi> liteWrite;
+    safetyhook::HookBatch liteBatch;
+    ok &= liteEmpty.Add(liteBatch, targets.Address(5), [](LiteHook::Context<0>&) {});
+    ok &= liteWrite.Add(liteBatch, targets.Address(6), [](LiteHook::Context<LiteHook::Rdi>& ctx) { ctx.rdi() += 1; });
+    ok &= liteBatch.commit().has_value();
+    if (!ok) {
+        fprintf(stderr, "hookbench: failed to install the hooks\n");
+        return 1;
+    }
+
+    for (std::size_t i = 0; i < CaseCount; ++i) {
+        auto result = targets.Function(i)(1);
+        if (result != cases[i].expected) {
+            fprintf(stderr, "hookbench: %s returned %d, expected %d\n", cases[i].name, result, cases[i].expected);
+            ok = false;
+        }
+    }
+    if (!ok)
+        return 1;
+
+    for (std::size_t i = 0; i < CaseCount; ++i) {
+        cases[i].ns = NanosecondsPerCall(targets.Function(i), calls, repeat);
+        fprintf(stderr, "%-14s %8.2f ns/call  (+%.2f)\n", cases[i].name, cases[i].ns, cases[i].ns - cases[0].ns);
+    }
+
+    std::vector<LifecycleCase> lifecycle;
+    for (auto count : counts) {
+        if (count == 0)
+            continue;
+        for (auto kind : { "inline", "mid", "batch-mid" }) {
+            if (!Lifecycle(kind, count, lifecycle)) {
+                fprintf(stderr, "hookbench: creating %zu %s hooks failed\n", count, kind);
+                ok = false;
+            }
+            const auto& last = lifecycle.back();
+            fprintf(stderr, "%-10s %6zu hooks: create %10.0f ns/hook, destroy %10.0f ns/hook\n", kind, count, last.createNs, last.destroyNs);
+        }
+    }
+
+    auto out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "hookbench: can't write %s\n", outPath);
+        return 2;
+    }
+    fprintf(out, "{\n  \"calls\": %zu,\n  \"repeat\": %d,\n  \"perCall\": [", calls, repeat);
+    for (std::size_t i = 0; i < CaseCount; ++i) {
+        fprintf(out, "%s\n    { \"case\": \"%s\", \"ns\": %.3f, \"overheadNs\": %.3f }", i ? "," : "", cases[i].name,
+            cases[i].ns, cases[i].ns - cases[0].ns);
+    }
+    fprintf(out, "\n  ],\n  \"lifecycle\": [");
+    for (std::size_t i = 0; i < lifecycle.size(); ++i) {
+        fprintf(out, "%s\n    { \"kind\": \"%s\", \"hooks\": %zu, \"createNs\": %.1f, \"destroyNs\": %.1f }", i ? "," : "",
+            lifecycle[i].kind, lifecycle[i].hooks, lifecycle[i].createNs, lifecycle[i].destroyNs);
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (outPath)
+        fclose(out);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,324 @@
+// litehookcheck: runs the stubs from src/litehook.hpp on Linux x86-64 and checks that they preserve every register
+// their callback doesn't write.
+//
+// Build (Linux x86-64, from the repository root):
+//   g++ -std=c++23 -O2 -Isrc -Iexternal/safetyhook tools/litehookcheck.cpp -o litehookcheck
+//
+// Usage:
+//   litehookcheck
+//
+// Each case loads a known value into every general purpose register, every XMM register and the status flags,
+// jumps into a stub, and records all of them again where the stub resumes. The callbacks overwrite every register
+// the SysV ABI lets them clobber, so anything the stub fails to save shows up as a mismatch. The game runs the
+// 32-bit stubs, which are built by the same code. Exits with 1 if any case fails.
+
+#include "litehook.hpp"
+
+#include <sys/mman.h>
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    struct RegisterFile
+    {
+        std::uint64_t gpr[16];      // encoding order, rsp included
+        std::uint64_t flags;
+        std::uint64_t xmm[16][2];
+    };
+
+    // Status flags: CF, PF, AF, ZF, SF, OF.
+    constexpr std::uint64_t StatusFlags = 0x8D5;
+}
+
+extern "C"
+{
+    RegisterFile g_in;
+    RegisterFile g_out;
+    void* g_stub;
+    std::uint64_t g_savedRsp;
+
+    void RunStub();
+    void ResumeStub();
+}
+
+// RunStub saves the callee-saved registers, loads g_in and jumps to g_stub. The stub resumes at ResumeStub, which
+// stores everything into g_out and returns to RunStub's caller.
+asm(R"(
+    .text
+    .globl RunStub
+RunStub:
+    push %rbx
+    push %rbp
+    push %r12
+    push %r13
+    push %r14
+    push %r15
+    mov %rsp, g_savedRsp(%rip)
+    mov %rsp, g_in+32(%rip)
+    movdqu g_in+136(%rip), %xmm0
+    movdqu g_in+152(%rip), %xmm1
+    movdqu g_in+168(%rip), %xmm2
+    movdqu g_in+184(%rip), %xmm3
+    movdqu g_in+200(%rip), %xmm4
+    movdqu g_in+216(%rip), %xmm5
+    movdqu g_in+232(%rip), %xmm6
+    movdqu g_in+248(%rip), %xmm7
+    movdqu g_in+264(%rip), %xmm8
+    movdqu g_in+280(%rip), %xmm9
+    movdqu g_in+296(%rip), %xmm10
+    movdqu g_in+312(%rip), %xmm11
+    movdqu g_in+328(%rip), %xmm12
+    movdqu g_in+344(%rip), %xmm13
+    movdqu g_in+360(%rip), %xmm14
+    movdqu g_in+376(%rip), %xmm15
+    pushq g_in+128(%rip)
+    popfq
+    mov g_in+0(%rip), %rax
+    mov g_in+8(%rip), %rcx
+    mov g_in+16(%rip), %rdx
+    mov g_in+24(%rip), %rbx
+    mov g_in+40(%rip), %rbp
+    mov g_in+48(%rip), %rsi
+    mov g_in+56(%rip), %rdi
+    mov g_in+64(%rip), %r8
+    mov g_in+72(%rip), %r9
+    mov g_in+80(%rip), %r10
+    mov g_in+88(%rip), %r11
+    mov g_in+96(%rip), %r12
+    mov g_in+104(%rip), %r13
+    mov g_in+112(%rip), %r14
+    mov g_in+120(%rip), %r15
+    jmp *g_stub(%rip)
+
+    .globl ResumeStub
+ResumeStub:
+    mov %rsp, g_out+32(%rip)
+    pushfq
+    popq g_out+128(%rip)
+    mov %rax, g_out+0(%rip)
+    mov %rcx, g_out+8(%rip)
+    mov %rdx, g_out+16(%rip)
+    mov %rbx, g_out+24(%rip)
+    mov %rbp, g_out+40(%rip)
+    mov %rsi, g_out+48(%rip)
+    mov %rdi, g_out+56(%rip)
+    mov %r8, g_out+64(%rip)
+    mov %r9, g_out+72(%rip)
+    mov %r10, g_out+80(%rip)
+    mov %r11, g_out+88(%rip)
+    mov %r12, g_out+96(%rip)
+    mov %r13, g_out+104(%rip)
+    mov %r14, g_out+112(%rip)
+    mov %r15, g_out+120(%rip)
+    movdqu %xmm0, g_out+136(%rip)
+    movdqu %xmm1, g_out+152(%rip)
+    movdqu %xmm2, g_out+168(%rip)
+    movdqu %xmm3, g_out+184(%rip)
+    movdqu %xmm4, g_out+200(%rip)
+    movdqu %xmm5, g_out+216(%rip)
+    movdqu %xmm6, g_out+232(%rip)
+    movdqu %xmm7, g_out+248(%rip)
+    movdqu %xmm8, g_out+264(%rip)
+    movdqu %xmm9, g_out+280(%rip)
+    movdqu %xmm10, g_out+296(%rip)
+    movdqu %xmm11, g_out+312(%rip)
+    movdqu %xmm12, g_out+328(%rip)
+    movdqu %xmm13, g_out+344(%rip)
+    movdqu %xmm14, g_out+360(%rip)
+    movdqu %xmm15, g_out+376(%rip)
+    mov g_savedRsp(%rip), %rsp
+    pop %r15
+    pop %r14
+    pop %r13
+    pop %r12
+    pop %rbp
+    pop %rbx
+    ret
+)");
+
+namespace
+{
+    static_assert(offsetof(RegisterFile, flags) == 128 && offsetof(RegisterFile, xmm) == 136);
+
+    const char* const GprNames[16] = {
+        "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+    };
+
+    int failures = 0;
+    int calls = 0;
+
+    void Fail(const char* name, const char* what, unsigned long long expected, unsigned long long actual)
+    {
+        printf("  FAIL %s: %s is %#llx, expected %#llx\n", name, what, actual, expected);
+        ++failures;
+    }
+
+    // Overwrites every register a SysV callback may clobber, and makes the compiler save and restore a few
+    // callee-saved ones.
+    void TrashScratch()
+    {
+        asm volatile(
+            "mov $-1, %%rax\n mov $-1, %%rcx\n mov $-1, %%rdx\n mov $-1, %%rsi\n mov $-1, %%rdi\n"
+            "mov $-1, %%r8\n mov $-1, %%r9\n mov $-1, %%r10\n mov $-1, %%r11\n"
+            "pcmpeqd %%xmm0, %%xmm0\n pcmpeqd %%xmm1, %%xmm1\n pcmpeqd %%xmm2, %%xmm2\n pcmpeqd %%xmm3, %%xmm3\n"
+            "pcmpeqd %%xmm4, %%xmm4\n pcmpeqd %%xmm5, %%xmm5\n pcmpeqd %%xmm6, %%xmm6\n pcmpeqd %%xmm7, %%xmm7\n"
+            "pcmpeqd %%xmm8, %%xmm8\n pcmpeqd %%xmm9, %%xmm9\n pcmpeqd %%xmm10, %%xmm10\n pcmpeqd %%xmm11, %%xmm11\n"
+            "pcmpeqd %%xmm12, %%xmm12\n pcmpeqd %%xmm13, %%xmm13\n pcmpeqd %%xmm14, %%xmm14\n pcmpeqd %%xmm15, %%xmm15\n"
+            "xor %%ebx, %%ebx\n xor %%r12d, %%r12d\n"
+            ::: "rax", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11", "rbx", "r12",
+            "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7",
+            "xmm8", "xmm9", "xmm10", "xmm11", "xmm12", "xmm13", "xmm14", "xmm15", "cc", "memory");
+    }
+
+    // Runs callback through a MidHook<Regs> stub and compares the registers at the resume point with the ones
+    // going in, after applying the changes the callback is expected to make. With swap, the stub is built for
+    // callback and then pointed at swap, which is the one expected to run.
+    template<LiteHook::Registers Regs>
+    void Run(const char* name, typename LiteHook::MidHook<Regs>::Callback callback, void (*expect)(RegisterFile&),
+        typename LiteHook::MidHook<Regs>::Callback swap = nullptr)
+    {
+        using Hook = LiteHook::MidHook<Regs>;
+        auto stub = static_cast<std::uint8_t*>(mmap(nullptr, 4096, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (stub == MAP_FAILED) {
+            printf("  FAIL %s: mmap\n", name);
+            ++failures;
+            return;
+        }
+        Hook::Build(stub, callback, reinterpret_cast<const void*>(&ResumeStub));
+        if (swap)
+            Hook::SetCallback(stub, swap);
+        g_stub = stub;
+
+        for (int i = 0; i < 16; ++i) {
+            g_in.gpr[i] = 0x1111111111111111ull * (i + 1) ^ 0x0123456789ABCDEFull;
+            g_in.xmm[i][0] = 0xA5A5A5A500000000ull | i;
+            g_in.xmm[i][1] = 0x5A5A5A5A00000000ull | (i << 8);
+        }
+        g_in.flags = StatusFlags | 0x2;
+        memset(&g_out, 0, sizeof(g_out));
+
+        const auto before = calls;
+        RunStub();
+        printf("%-24s %3zu byte stub, %2d GPR(s) and %2d XMM register(s) saved\n", name, Hook::Code.size,
+            std::popcount(Hook::Context::Saved & 0xFFFF), std::popcount(Hook::Context::Saved >> 32));
+
+        if (calls != before + 1) {
+            printf("  FAIL %s: callback ran %d time(s)\n", name, calls - before);
+            ++failures;
+        }
+
+        RegisterFile expected = g_in;
+        expect(expected);
+        for (int i = 0; i < 16; ++i) {
+            if (g_out.gpr[i] != expected.gpr[i])
+                Fail(name, GprNames[i], expected.gpr[i], g_out.gpr[i]);
+        }
+        if ((g_out.flags & StatusFlags) != (expected.flags & StatusFlags))
+            Fail(name, "flags", expected.flags & StatusFlags, g_out.flags & StatusFlags);
+        if (g_out.flags & 0x400)
+            Fail(name, "DF", 0, 1);
+        for (int i = 0; i < 16; ++i) {
+            for (int half = 0; half < 2; ++half) {
+                if (g_out.xmm[i][half] != expected.xmm[i][half]) {
+                    char what[32];
+                    snprintf(what, sizeof(what), "xmm%d.u64[%d]", i, half);
+                    Fail(name, what, expected.xmm[i][half], g_out.xmm[i][half]);
+                }
+            }
+        }
+        munmap(stub, 4096);
+    }
+
+    // What the callback read, checked against the input afterwards.
+    std::uint64_t observed;
+
+    void Unchanged(RegisterFile&) {}
+}
+
+int main()
+{
+    using namespace LiteHook;
+
+    Run<0>("No registers", [](Context<0>&)
+    {
+        ++calls;
+        TrashScratch();
+    }, Unchanged);
+
+    Run<Rax | Xmm0>("rax, xmm0", [](Context<Rax | Xmm0>& ctx)
+    {
+        ++calls;
+        observed = ctx.rax() ^ ctx.xmm<0>().u64[1];
+        TrashScratch();
+        ctx.rax() = 0xFEEDFACECAFEBEEFull;
+        ctx.xmm<0>().f32[0] = 1.0f;
+    }, [](RegisterFile& r)
+    {
+        if (observed != (r.gpr[0] ^ r.xmm[0][1]))
+            Fail("rax, xmm0", "value read", r.gpr[0] ^ r.xmm[0][1], observed);
+        r.gpr[0] = 0xFEEDFACECAFEBEEFull;
+        r.xmm[0][0] = (r.xmm[0][0] & ~0xFFFFFFFFull) | std::bit_cast<std::uint32_t>(1.0f);
+    });
+
+    Run<Rbx | Rsp | Rbp | R12 | Flags | Xmm8>("rbx, rsp, rbp, r12, flags", [](Context<Rbx | Rsp | Rbp | R12 | Flags | Xmm8>& ctx)
+    {
+        ++calls;
+        observed = ctx.rsp();
+        TrashScratch();
+        ctx.rbx() += 1;
+        ctx.rbp() = ~ctx.rbp();
+        ctx.r12() = ctx.rbx() * 3;
+        ctx.flags() ^= 0x1;         // CF
+        ctx.xmm<8>().u64[0] = 8;
+    }, [](RegisterFile& r)
+    {
+        if (observed != r.gpr[4])
+            Fail("rbx, rsp, rbp, r12, flags", "rsp seen by callback", r.gpr[4], observed);
+        r.gpr[3] += 1;
+        r.gpr[5] = ~r.gpr[5];
+        r.gpr[12] = r.gpr[3] * 3;
+        r.flags ^= 0x1;
+        r.xmm[8][0] = 8;
+    });
+
+    Run<Rax>("Swapped callback", [](Context<Rax>& ctx)
+    {
+        ++calls;
+        ctx.rax() = 1;
+    }, [](RegisterFile& r)
+    {
+        r.gpr[0] = 2;
+    }, [](Context<Rax>& ctx)
+    {
+        ++calls;
+        TrashScratch();
+        ctx.rax() = 2;
+    });
+
+    // Everything, read back.
+    constexpr LiteHook::Registers All = 0xFFEFull | Flags | (0xFFFFull << 32);
+    Run<All>("All registers", [](Context<All>& ctx)
+    {
+        ++calls;
+        observed = ctx.rax() ^ ctx.rcx() ^ ctx.rdx() ^ ctx.rbx() ^ ctx.rbp() ^ ctx.rsi() ^ ctx.rdi() ^ ctx.r8() ^
+            ctx.r9() ^ ctx.r10() ^ ctx.r11() ^ ctx.r12() ^ ctx.r13() ^ ctx.r14() ^ ctx.r15() ^ ctx.xmm<15>().u64[1] ^
+            (ctx.flags() & StatusFlags);
+        TrashScratch();
+        ctx.r15() = 15;
+    }, [](RegisterFile& r)
+    {
+        std::uint64_t value = r.xmm[15][1] ^ (r.flags & StatusFlags);
+        for (int i = 0; i < 16; ++i) {
+            if (i != 4)
+                value ^= r.gpr[i];
+        }
+        if (observed != value)
+            Fail("All registers", "value read", value, observed);
+        r.gpr[15] = 15;
+    });
+
+    printf("%s\n", failures ? "FAILED" : "All cases passed.");
+    return failures ? 1 : 0;
+}
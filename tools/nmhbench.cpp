@@ -0,0 +1,345 @@
+// nmhbench: benchmarks the pattern scanning engines on synthetic x86 images and writes the results as JSON.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++20 -O2 -DNDEBUG -pthread -Isrc tools/nmhbench.cpp -o nmhbench
+//
+// Usage:
+//   nmhbench [--sizes 10,50,200] [--threads 1,2,4] [--repeat 3] [--out results.json]
+//
+// Every NMHFix signature is planted into images of the given sizes (in MiB) in one of these layouts:
+//   early   - within the first 1% of the image
+//   late    - within the last 1% of the image
+//   absent  - not planted at all, so every engine has to walk the whole image
+//   decoys  - planted late, with a near miss (one fixed byte changed) every 64 KiB before it
+// Each engine resolves every signature and we record the best time out of --repeat runs, the resulting
+// throughput, the time until the first signature is found and how much memory the scan needed on top of the image.
+// Every measurement runs in a forked child so the peak memory figures don't bleed into each other.
+
+#include "scanner.hpp"
+#include "signatures.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double Milliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Instruction fragments common in 32-bit MSVC output, mixed in with single bytes drawn from
+    // Scanner::ByteWeights so the byte distribution and the pairs of bytes look like real code.
+    const std::vector<std::vector<std::uint8_t>> Fragments = {
+        { 0x8B, 0x45 }, { 0x8B, 0x4D }, { 0x89, 0x45 }, { 0x8B, 0x44, 0x24 }, { 0x89, 0x44, 0x24 },
+        { 0xE8 }, { 0xFF, 0x15 }, { 0x83, 0xC4 }, { 0x83, 0xEC }, { 0x85, 0xC0 }, { 0x74 }, { 0x75 },
+        { 0x0F, 0x84 }, { 0x0F, 0x85 }, { 0xF3, 0x0F, 0x10 }, { 0xF3, 0x0F, 0x11 }, { 0xF3, 0x0F, 0x59 },
+        { 0x0F, 0x28 }, { 0x0F, 0x57 }, { 0x6A, 0x00 }, { 0x6A, 0x01 }, { 0x50 }, { 0x56 }, { 0x57 },
+        { 0x5F, 0x5E }, { 0xC3 }, { 0xCC, 0xCC, 0xCC }, { 0xC7, 0x44, 0x24 }, { 0x8D, 0x4C, 0x24 },
+    };
+
+    std::vector<std::uint8_t> MakeImage(std::size_t size, std::uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::discrete_distribution<int> byteDist(std::begin(Scanner::ByteWeights.weight), std::end(Scanner::ByteWeights.weight));
+        std::uniform_int_distribution<std::size_t> fragmentDist(0, Fragments.size() - 1);
+
+        std::vector<std::uint8_t> image(size);
+        std::size_t i = 0;
+        while (i < size) {
+            if (rng() % 3 == 0) {
+                for (auto byte : Fragments[fragmentDist(rng)]) {
+                    if (i < size)
+                        image[i++] = byte;
+                }
+            }
+            else {
+                image[i++] = static_cast<std::uint8_t>(byteDist(rng));
+            }
+        }
+        return image;
+    }
+
+    void Plant(std::vector<std::uint8_t>& image, std::size_t offset, const Scanner::Pattern& pattern)
+    {
+        for (std::size_t j = 0; j < pattern.size(); ++j) {
+            if (pattern.mask[j])
+                image[offset + j] = pattern.bytes[j];
+        }
+    }
+
+    // Same as the pattern except one fixed byte (not the anchor) is flipped, so it passes candidate
+    // filtering and fails during verification.
+    void PlantNearMiss(std::vector<std::uint8_t>& image, std::size_t offset, const Scanner::Pattern& pattern)
+    {
+        Plant(image, offset, pattern);
+        for (std::size_t j = pattern.size(); j-- > 0;) {
+            if (pattern.mask[j] && j != pattern.anchor) {
+                image[offset + j] = static_cast<std::uint8_t>(~pattern.bytes[j]);
+                return;
+            }
+        }
+    }
+
+    enum class Layout { Early, Late, Absent, Decoys };
+
+    const char* LayoutName(Layout layout)
+    {
+        switch (layout) {
+        case Layout::Early: return "early";
+        case Layout::Late: return "late";
+        case Layout::Absent: return "absent";
+        default: return "decoys";
+        }
+    }
+
+    void PlantSignatures(std::vector<std::uint8_t>& image, const Scanner::Batch& batch, Layout layout)
+    {
+        if (layout == Layout::Absent)
+            return;
+
+        auto window = image.size() / 100;
+        auto start = layout == Layout::Early ? std::size_t(0) : image.size() - window;
+        auto stride = window / (batch.Size() + 1);
+
+        if (layout == Layout::Decoys) {
+            for (std::size_t offset = 0x10000, id = 0; offset + Scanner::MaxPatternLength < start; offset += 0x10000, ++id)
+                PlantNearMiss(image, offset, batch[id % batch.Size()].pattern);
+        }
+        for (std::size_t id = 0; id < batch.Size(); ++id)
+            Plant(image, start + stride * (id + 1), batch[id].pattern);
+    }
+
+    struct Result
+    {
+        double ms = 0;              // time to resolve every signature
+        double firstHitMs = -1;     // time until the first signature is found, -1 if nothing was
+        std::uint64_t bytesExamined = 0;
+        long peakExtraKiB = 0;      // peak RSS above what the image itself uses
+        int found = 0;
+    };
+
+    long ResidentKiB()
+    {
+        long pages = 0, resident = 0;
+        if (auto file = fopen("/proc/self/statm", "r")) {
+            if (fscanf(file, "%ld %ld", &pages, &resident) != 2)
+                resident = 0;
+            fclose(file);
+        }
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+
+    long PeakResidentKiB()
+    {
+        long peak = 0;
+        if (auto file = fopen("/proc/self/status", "r")) {
+            char line[256];
+            while (fgets(line, sizeof(line), file)) {
+                if (sscanf(line, "VmHWM: %ld", &peak) == 1)
+                    break;
+            }
+            fclose(file);
+        }
+        return peak;
+    }
+
+    // One engine resolving every signature once. "batch" is the shared single pass scan,
+    // everything else looks for the signatures one at a time.
+    Result RunOnce(const std::string& engine, const std::vector<Scanner::Span>& spans, const std::vector<Scanner::Pattern>& patterns, ThreadPool* pool)
+    {
+        Result result;
+        const auto begin = spans.front().begin;
+        const auto size = spans.front().size;
+
+        if (engine == "batch") {
+            Scanner::Batch batch;
+            Game::AddSignatures(batch, { .hudElements = true });
+            auto start = Clock::now();
+            batch.Run(spans, pool);
+            result.ms = Milliseconds(start);
+
+            std::uint64_t furthest = 0;
+            for (std::size_t id = 0; id < batch.Size(); ++id) {
+                if (batch[id].results.empty()) {
+                    furthest = size;
+                    continue;
+                }
+                ++result.found;
+                furthest = (std::max)(furthest, static_cast<std::uint64_t>(batch[id].results.front() - begin + batch[id].pattern.size()));
+            }
+            result.bytesExamined = furthest;
+
+            // A batch only reports once it's done, so time a batch holding just the earliest signature.
+            if (result.found) {
+                Scanner::Batch first;
+                Game::AddSignatures(first, { .hudElements = true });
+                std::size_t earliest = 0;
+                for (std::size_t id = 1; id < batch.Size(); ++id) {
+                    if (!batch[id].results.empty() && (batch[earliest].results.empty() || batch[id].results.front() < batch[earliest].results.front()))
+                        earliest = id;
+                }
+                for (std::size_t id = 0; id < first.Size(); ++id) {
+                    if (id != earliest)
+                        first.Resolve(id, {});
+                }
+                auto firstStart = Clock::now();
+                first.Run(spans, pool);
+                result.firstHitMs = Milliseconds(firstStart);
+            }
+            return result;
+        }
+
+        auto kind = engine == "scalar" ? Scanner::Engine::Scalar
+            : engine == "sse2" ? Scanner::Engine::SSE2
+            : engine == "avx2" ? Scanner::Engine::AVX2
+            : Scanner::Engine::Auto;
+        auto start = Clock::now();
+        for (const auto& pattern : patterns) {
+            auto hit = Scanner::Find(spans, pattern, Scanner::Region::Code, kind, pool);
+            if (hit) {
+                ++result.found;
+                if (result.firstHitMs < 0)
+                    result.firstHitMs = Milliseconds(start);
+                result.bytesExamined += hit - begin + pattern.size();
+            }
+            else {
+                result.bytesExamined += size;
+            }
+        }
+        result.ms = Milliseconds(start);
+        return result;
+    }
+
+    // Runs the measurement in a child process and reads the result back over a pipe.
+    Result Measure(const std::string& engine, const std::vector<Scanner::Span>& spans, const std::vector<Scanner::Pattern>& patterns, std::size_t threads, int repeat)
+    {
+        int fds[2];
+        if (pipe(fds) != 0)
+            return {};
+
+        auto pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            auto baseline = ResidentKiB();
+            ThreadPool pool(threads);
+            Result best;
+            for (int i = 0; i < repeat; ++i) {
+                auto result = RunOnce(engine, spans, patterns, threads > 1 || engine == "batch" ? &pool : nullptr);
+                if (i == 0 || result.ms < best.ms)
+                    best = result;
+            }
+            best.peakExtraKiB = (std::max)(0L, PeakResidentKiB() - baseline);
+            auto written = write(fds[1], &best, sizeof(best));
+            _exit(written == sizeof(best) ? 0 : 1);
+        }
+
+        close(fds[1]);
+        Result result;
+        if (read(fds[0], &result, sizeof(result)) != sizeof(result))
+            result = {};
+        close(fds[0]);
+        waitpid(pid, nullptr, 0);
+        return result;
+    }
+
+    std::vector<std::size_t> ParseList(const char* text)
+    {
+        std::vector<std::size_t> values;
+        for (auto current = text; *current;) {
+            char* end;
+            values.push_back(strtoul(current, &end, 10));
+            current = *end == ',' ? end + 1 : end;
+            if (end == current && *end)
+                break;
+        }
+        return values;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::size_t> sizes = { 10, 50, 200 };
+    std::vector<std::size_t> threadCounts = { 1, (std::max)(1u, std::thread::hardware_concurrency()) };
+    int repeat = 3;
+    const char* outPath = nullptr;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--sizes") == 0)
+            sizes = ParseList(argv[i + 1]);
+        else if (strcmp(argv[i], "--threads") == 0)
+            threadCounts = ParseList(argv[i + 1]);
+        else if (strcmp(argv[i], "--repeat") == 0)
+            repeat = (std::max)(1, atoi(argv[i + 1]));
+        else if (strcmp(argv[i], "--out") == 0)
+            outPath = argv[i + 1];
+    }
+    threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+
+    std::vector<std::string> engines = { "scalar", "sse2" };
+    if (Scanner::CpuHasAVX2())
+        engines.push_back("avx2");
+    engines.push_back("auto");
+    engines.push_back("batch");
+
+    Scanner::Batch signatures;
+    Game::AddSignatures(signatures, { .hudElements = true });
+    std::vector<Scanner::Pattern> patterns;
+    for (std::size_t id = 0; id < signatures.Size(); ++id)
+        patterns.push_back(signatures[id].pattern);
+
+    auto out = outPath ? fopen(outPath, "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "nmhbench: can't write %s\n", outPath);
+        return 2;
+    }
+
+    fprintf(out, "{\n  \"hardwareThreads\": %u,\n  \"avx2\": %s,\n  \"signatures\": %zu,\n  \"repeat\": %d,\n  \"results\": [",
+        std::thread::hardware_concurrency(), Scanner::CpuHasAVX2() ? "true" : "false", patterns.size(), repeat);
+
+    bool firstRecord = true;
+    for (auto sizeMiB : sizes) {
+        for (auto layout : { Layout::Early, Layout::Late, Layout::Absent, Layout::Decoys }) {
+            auto image = MakeImage(sizeMiB << 20, static_cast<std::uint32_t>(sizeMiB));
+            PlantSignatures(image, signatures, layout);
+            std::vector<Scanner::Span> spans = { { image.data(), image.size(), true, false } };
+
+            for (const auto& engine : engines) {
+                // Only the engines that can use the pool are worth sweeping over thread counts.
+                bool parallel = engine == "auto" || engine == "batch";
+                for (auto threads : threadCounts) {
+                    if (!parallel && threads != threadCounts.front())
+                        break;
+                    auto effectiveThreads = parallel ? threads : 1;
+                    auto result = Measure(engine, spans, patterns, effectiveThreads, repeat);
+
+                    fprintf(out, "%s\n    { \"engine\": \"%s\", \"layout\": \"%s\", \"sizeMiB\": %zu, \"threads\": %zu, "
+                        "\"ms\": %.3f, \"firstHitMs\": %.3f, \"gbPerSec\": %.3f, \"bytesExamined\": %llu, \"found\": %d, \"peakExtraKiB\": %ld }",
+                        firstRecord ? "" : ",", engine.c_str(), LayoutName(layout), sizeMiB, effectiveThreads,
+                        result.ms, result.firstHitMs, result.ms > 0 ? result.bytesExamined / (result.ms * 1e6) : 0.0,
+                        static_cast<unsigned long long>(result.bytesExamined), result.found, result.peakExtraKiB);
+                    fflush(out);
+                    firstRecord = false;
+
+                    fprintf(stderr, "%4zu MiB %-6s %-6s %2zu thread(s): %9.3fms\n", sizeMiB, LayoutName(layout), engine.c_str(), effectiveThreads, result.ms);
+                }
+            }
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,157 @@
+// nmhxref: builds the cross-reference index from src/xrefs.hpp for a game executable on disk, without Windows or
+// the game.
+//
+// Links against Zydis.o, which isn't checked in. tools/README.md says where Zydis.c comes from.
+//
+// Build (Linux, from the repository root):
+//   gcc -O2 -c external/safetyhook/Zydis.c -o Zydis.o
+//   g++ -std=c++20 -O2 -DNDEBUG -pthread -Isrc -Iexternal/safetyhook tools/nmhxref.cpp Zydis.o -o nmhxref
+// Leave out -DNDEBUG to get the offsets the Debug build of the fix uses.
+//
+// Usage:
+//   nmhxref <NoMoreHeroes.exe> [--callers RVA]... [--refs RVA]...
+//
+// Prints how long the index took to build and how big it is. Then, for the functions and data the fixes derive
+// from their signatures, it prints who calls them and which instructions touch them. --callers and --refs query
+// any other RVA (hex). Exits with 1 if a signature resolves to a function that no call inside its match targets
+// according to the index.
+
+#include "peimage.hpp"
+#include "scanner.hpp"
+#include "signatures.hpp"
+#include "xrefs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double Milliseconds(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    const char* AccessName(Xrefs::Access access)
+    {
+        switch (access) {
+        case Xrefs::Access::Read: return "read";
+        case Xrefs::Access::Write: return "write";
+        case Xrefs::Access::ReadWrite: return "read/write";
+        default: return "address";
+        }
+    }
+
+    constexpr std::size_t MaxListed = 8;
+
+    void PrintCallers(const Xrefs::Index& index, const char* name, std::uint32_t callee)
+    {
+        auto callers = index.CallersOf(callee);
+        printf("  %-28s %08x  %zu caller(s)\n", name, callee, callers.size());
+        for (std::size_t i = 0; i < callers.size() && i < MaxListed; ++i)
+            printf("      call at %08x\n", callers[i].from);
+        if (callers.size() > MaxListed)
+            printf("      ...\n");
+    }
+
+    void PrintReferences(const Xrefs::Index& index, const char* name, std::uint32_t rva)
+    {
+        auto references = index.ReferencesTo(rva);
+        printf("  %-28s %08x  %zu reference(s), %zu writer(s)\n", name, rva, references.size(), index.WritersOf(rva).size());
+        for (std::size_t i = 0; i < references.size() && i < MaxListed; ++i)
+            printf("      %-10s at %08x\n", AccessName(references[i].access), references[i].from);
+        if (references.size() > MaxListed)
+            printf("      ...\n");
+    }
+
+    // These signatures follow a call in their match with rel32. The index has to agree on where it goes.
+    bool CheckCall(const Image& image, const Xrefs::Index& index, const Scanner::Batch& batch, const char* name)
+    {
+        auto entry = batch.Get(name);
+        auto function = batch.Find(name);
+        if (!entry || !function)
+            return true;
+
+        auto expected = image.Rva(function);
+        auto match = image.Rva(entry->results.front());
+        auto calls = index.CallsFrom(match, match + static_cast<std::uint32_t>(entry->pattern.size()));
+        if (std::none_of(calls.begin(), calls.end(), [&](const Xrefs::Call& call) { return call.to == expected; })) {
+            printf("  %-28s resolves to %08x, but no call in its match at %08x goes there\n", name, expected, match);
+            return false;
+        }
+        PrintCallers(index, name, expected);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* path = nullptr;
+    std::vector<std::uint32_t> callerQueries;
+    std::vector<std::uint32_t> referenceQueries;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--callers") == 0 && i + 1 < argc) {
+            callerQueries.push_back(static_cast<std::uint32_t>(strtoul(argv[++i], nullptr, 16)));
+        }
+        else if (strcmp(argv[i], "--refs") == 0 && i + 1 < argc) {
+            referenceQueries.push_back(static_cast<std::uint32_t>(strtoul(argv[++i], nullptr, 16)));
+        }
+        else if (!path && argv[i][0] != '-') {
+            path = argv[i];
+        }
+        else {
+            path = nullptr;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "usage: nmhxref <exe> [--callers RVA]... [--refs RVA]...\n");
+        return 2;
+    }
+
+    Image image("nmhxref");
+    if (!image.Open(path))
+        return 2;
+
+    auto buildStart = Clock::now();
+    Xrefs::Index index;
+    if (!index.Build(image.base, image.headers, image.headers.imageBase)) {
+        fprintf(stderr, "nmhxref: can't decode %s\n", path);
+        return 2;
+    }
+    auto buildTime = Milliseconds(buildStart);
+
+    printf("%s\n", path);
+    printf("  Indexed %zu instructions in %.3fms: %zu calls, %zu references, %zu KB\n\n", index.Instructions(), buildTime,
+        index.Calls(), index.References(), index.MemoryUsed() / 1024);
+
+    Scanner::Batch batch;
+    Game::AddSignatures(batch, { .hudElements = true });
+    batch.SetModule(image.Module());
+    batch.Run(image.Spans());
+
+    bool agrees = true;
+    printf("  Functions\n");
+    for (auto name : { "SetViewport", "DrawBox" })
+        agrees &= CheckCall(image, index, batch, name);
+
+    printf("\n  Data\n");
+    for (auto name : { "HUDTo16x9Xpos", "HUDScreenTable1", "HUDScreenTable2", "HUDWidth", "HUDBackgroundWidth", "HUDBackgroundHeight" }) {
+        if (auto address = batch.Find(name))
+            PrintReferences(index, name, image.Rva(address));
+    }
+
+    if (!callerQueries.empty() || !referenceQueries.empty())
+        printf("\n  Queries\n");
+    for (auto rva : callerQueries)
+        PrintCallers(index, "Callers of", rva);
+    for (auto rva : referenceQueries)
+        PrintReferences(index, "References to", rva);
+
+    return agrees ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+// Loads a PE file on disk for the Linux tools. Shared by nmhscan and nmhxref.
+
+#include "pe.hpp"
+#include "scanner.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A PE file laid out at its section RVAs, the way the loader would map it.
+// Sections whose file offset and RVA agree modulo the page size are mapped straight from the file;
+// the rest are read in. Only code and data sections are brought in at all.
+class Image
+{
+public:
+    // tool prefixes error messages.
+    explicit Image(const char* tool) : tool(tool) {}
+    Image(const Image&) = delete;
+    Image& operator=(const Image&) = delete;
+
+    ~Image()
+    {
+        if (base)
+            munmap(base, headers.sizeOfImage);
+        if (fd >= 0)
+            close(fd);
+    }
+
+    bool Open(const char* path)
+    {
+        fd = open(path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0)
+            return Fail("can't open %s", path);
+        fileSize = static_cast<std::size_t>(st.st_size);
+
+        // Map just the start of the file to read the headers.
+        auto headerSize = (std::min)(fileSize, static_cast<std::size_t>(0x1000));
+        auto file = mmap(nullptr, headerSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (file == MAP_FAILED)
+            return Fail("can't map %s", path);
+        headers = Pe::Parse(static_cast<const std::uint8_t*>(file), headerSize);
+        munmap(file, headerSize);
+        if (!headers.valid || headers.sizeOfImage == 0)
+            return Fail("%s is not a PE image", path);
+
+        // Reserve the whole image. Untouched pages are never committed.
+        auto reserved = mmap(nullptr, headers.sizeOfImage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED)
+            return Fail("can't reserve %x bytes", headers.sizeOfImage);
+        base = static_cast<std::uint8_t*>(reserved);
+
+        auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        for (const auto& section : headers.sections) {
+            if (!section.IsCode() && !section.IsData())
+                continue;
+            if (section.virtualAddress >= headers.sizeOfImage)
+                continue;
+
+            std::size_t length = (std::min)(section.rawSize, section.virtualSize);
+            length = (std::min)(length, static_cast<std::size_t>(headers.sizeOfImage - section.virtualAddress));
+            if (section.rawOffset >= fileSize)
+                continue;
+            length = (std::min)(length, fileSize - section.rawOffset);
+            if (length == 0)
+                continue;
+
+            auto target = base + section.virtualAddress;
+            if (section.rawOffset % page == 0 && section.virtualAddress % page == 0) {
+                auto mapped = mmap(target, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, section.rawOffset);
+                if (mapped == MAP_FAILED)
+                    return Fail("can't map section %s", section.name.c_str());
+                // The last page holds whatever follows in the file; the loader zero-fills it.
+                auto mappedEnd = (length + page - 1) / page * page;
+                auto tail = (std::min)(mappedEnd, static_cast<std::size_t>(headers.sizeOfImage - section.virtualAddress));
+                memset(target + length, 0, tail - length);
+                mappedBytes += length;
+            }
+            else {
+                if (pread(fd, target, length, section.rawOffset) != static_cast<ssize_t>(length))
+                    return Fail("can't read section %s", section.name.c_str());
+                copiedBytes += length;
+            }
+        }
+        return true;
+    }
+
+    std::vector<Scanner::Span> Spans() const
+    {
+        std::vector<Scanner::Span> spans;
+        for (const auto& section : headers.sections) {
+            bool code = section.IsCode();
+            bool data = section.IsData();
+            if ((!code && !data) || section.virtualAddress >= headers.sizeOfImage)
+                continue;
+            auto size = (std::min)(section.virtualSize, headers.sizeOfImage - section.virtualAddress);
+            spans.push_back({ base + section.virtualAddress, size, code, data });
+        }
+        return spans;
+    }
+
+    // For following signature operands: absolute addresses in the file are relative to the preferred base.
+    Scanner::Module Module() const { return { base, headers.sizeOfImage, headers.imageBase }; }
+
+    std::uint32_t Rva(const std::uint8_t* p) const { return static_cast<std::uint32_t>(p - base); }
+
+    Pe::Headers headers;
+    std::uint8_t* base = nullptr;
+    std::size_t fileSize = 0;
+    std::size_t mappedBytes = 0;
+    std::size_t copiedBytes = 0;
+
+private:
+    const char* tool;
+    int fd = -1;
+
+    template<typename... Args>
+    bool Fail(const char* format, Args... args)
+    {
+        fprintf(stderr, "%s: ", tool);
+        fprintf(stderr, format, args...);
+        fprintf(stderr, "\n");
+        return false;
+    }
+};
@@ -0,0 +1,264 @@
+// regioncheck: tests the runtime region scanner in src/regions.hpp against a synthetic heap, using its
+// /proc/self/maps backend.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++20 -O2 -pthread -Isrc tools/regioncheck.cpp -o regioncheck
+//
+// Usage:
+//   regioncheck [--seed N] [--regions 48]
+//
+// Lays out --regions anonymous mappings of different sizes in one reservation, separated by inaccessible pages,
+// and writes a marker at random offsets, some straddling a chunk boundary or ending on the last byte of a region.
+// Checks that a scan finds exactly those markers with and without a pool, that a rescan with nothing changed
+// scans nothing, that only grown and new regions are scanned after the heap changes, that markers in removed or
+// overwritten memory go away, and that Invalidate() brings back a marker written into an unchanged region. Then
+// scans the whole process once for timing. Prints each failure and exits with 1 if there were any.
+
+#include "regions.hpp"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace
+{
+    constexpr std::size_t Page = 4096;
+    constexpr std::size_t ChunkSize = 16 * Page;
+    constexpr std::size_t MarkerLength = 16;
+
+    int failures = 0;
+
+    void Fail(const char* what)
+    {
+        printf("FAIL: %s\n", what);
+        ++failures;
+    }
+
+    // The marker is never held in one piece outside the heap, so the only copies are the ones planted and the
+    // pattern inside the Map. Byte i is derived from the seed when it's needed.
+    std::uint8_t MarkerByte(unsigned seed, std::size_t i)
+    {
+        return static_cast<std::uint8_t>((seed * 2654435761u >> (i % 4 * 8)) ^ (0xA5 + i * 29));
+    }
+
+    void Plant(std::uintptr_t address, unsigned seed)
+    {
+        for (std::size_t i = 0; i < MarkerLength; ++i)
+            reinterpret_cast<std::uint8_t*>(address)[i] = MarkerByte(seed, i);
+    }
+
+    Scanner::Pattern MarkerPattern(unsigned seed)
+    {
+        Scanner::Pattern pattern;
+        for (std::size_t i = 0; i < MarkerLength; ++i) {
+            pattern.bytes[i] = MarkerByte(seed, i);
+            pattern.mask[i] = 0xFF;
+        }
+        pattern.length = MarkerLength;
+        pattern.anchor = Scanner::PickAnchor(pattern.bytes.data(), pattern.mask.data(), pattern.length);
+        return pattern;
+    }
+
+    struct Heap
+    {
+        std::uint8_t* base = nullptr;
+        std::size_t size = 0;
+        std::vector<std::pair<std::size_t, std::size_t>> regions;  // offset, size in bytes
+
+        std::uintptr_t Begin(std::size_t i) const { return reinterpret_cast<std::uintptr_t>(base + regions[i].first); }
+        std::uintptr_t End(std::size_t i) const { return Begin(i) + regions[i].second; }
+        bool Contains(const Regions::Region& region) const
+        {
+            auto begin = reinterpret_cast<std::uintptr_t>(base);
+            return region.base >= begin && region.End() <= begin + size;
+        }
+    };
+
+    void Compare(const char* what, std::vector<std::uintptr_t> found, std::set<std::uintptr_t> expected)
+    {
+        std::vector<std::uintptr_t> want(expected.begin(), expected.end());
+        if (!std::is_sorted(found.begin(), found.end())) {
+            printf("FAIL: %s: results out of order\n", what);
+            ++failures;
+            std::sort(found.begin(), found.end());
+        }
+        if (found != want) {
+            printf("FAIL: %s: found %zu markers, expected %zu\n", what, found.size(), want.size());
+            ++failures;
+        }
+    }
+
+    void Expect(const char* what, std::size_t actual, std::size_t expected)
+    {
+        if (actual != expected) {
+            printf("FAIL: %s: %zu, expected %zu\n", what, actual, expected);
+            ++failures;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned seed = 1;
+    std::size_t count = 48;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seed") == 0)
+            seed = static_cast<unsigned>(strtoul(argv[i + 1], nullptr, 10));
+        else if (strcmp(argv[i], "--regions") == 0)
+            count = (std::max)(strtoul(argv[i + 1], nullptr, 10), 12ul);
+    }
+    std::mt19937 random(seed);
+
+    // Regions of 1 to 40 pages with four inaccessible pages after each, which leaves room to grow by two.
+    Heap heap;
+    std::vector<std::size_t> pages;
+    for (std::size_t i = 0; i < count; ++i) {
+        pages.push_back(1 + random() % 40);
+        heap.size += (pages.back() + 4) * Page;
+    }
+    heap.size += 8 * Page;      // for a new region at the end
+    auto reserved = mmap(nullptr, heap.size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        printf("FAIL: couldn't reserve the heap\n");
+        return 1;
+    }
+    heap.base = static_cast<std::uint8_t*>(reserved);
+    std::size_t offset = 0;
+    for (auto size : pages) {
+        heap.regions.emplace_back(offset, size * Page);
+        mprotect(heap.base + offset, size * Page, PROT_READ | PROT_WRITE);
+        offset += (size + 4) * Page;
+    }
+
+    // One marker at a random offset in each region, plus one across a chunk boundary and one ending on the last
+    // byte where there's room.
+    auto markerSeed = seed * 7919 + 17;
+    std::set<std::uintptr_t> expected;
+    auto plant = [&](std::uintptr_t address) {
+        Plant(address, markerSeed);
+        expected.insert(address);
+    };
+    for (std::size_t i = 0; i < count; ++i) {
+        auto size = heap.regions[i].second;
+        auto place = random() % (size - MarkerLength);
+        plant(heap.Begin(i) + place);
+        if (size > ChunkSize + MarkerLength) {
+            auto straddle = heap.Begin(i) + ChunkSize - MarkerLength / 2;
+            if (straddle >= heap.Begin(i) + place + MarkerLength || straddle + MarkerLength <= heap.Begin(i) + place)
+                plant(straddle);
+        }
+        auto last = heap.End(i) - MarkerLength;
+        if (last >= heap.Begin(i) + place + MarkerLength)
+            plant(last);
+    }
+
+    Regions::Map::Options options;
+    options.chunkSize = ChunkSize;
+    options.filter = [&heap](const Regions::Region& region) { return heap.Contains(region); };
+    Regions::Map map(options);
+    auto marker = map.Add("Marker", MarkerPattern(markerSeed));
+    Regions::Map sequential(options);
+    sequential.Add("Marker", MarkerPattern(markerSeed));
+    ThreadPool pool(4);
+
+    // First scan covers everything.
+    auto stats = map.Scan(&pool);
+    Expect("first scan: regions", stats.regions, count);
+    Expect("first scan: added", stats.added, count);
+    Compare("first scan", map.Results(marker), expected);
+    sequential.Scan();
+    if (sequential.Results("Marker") != map.Results("Marker"))
+        Fail("first scan: sequential and pooled results differ");
+    printf("first scan: %zu regions, %zu markers, %zu KB in %.3fms\n", stats.regions, expected.size(), stats.bytesScanned / 1024,
+        stats.milliseconds);
+
+    // Nothing changed, nothing scanned.
+    stats = map.Scan(&pool);
+    Expect("unchanged: bytes scanned", stats.bytesScanned, 0);
+    Expect("unchanged: added", stats.added + stats.resized + stats.removed, 0);
+    Compare("unchanged", map.Results(marker), expected);
+    printf("rescan, nothing changed: %.3fms\n", stats.milliseconds);
+
+    // Grow region 1 by two pages with a marker in the new part, remove region 3, add a region at the end with a
+    // marker, overwrite the marker at the start of region 5 and write a new one into region 7 without changing it.
+    auto grown = heap.End(1);
+    mprotect(reinterpret_cast<void*>(grown), 2 * Page, PROT_READ | PROT_WRITE);
+    heap.regions[1].second += 2 * Page;
+    plant(grown + Page);
+
+    mprotect(reinterpret_cast<void*>(heap.Begin(3)), heap.regions[3].second, PROT_NONE);
+    for (auto it = expected.begin(); it != expected.end();) {
+        if (*it >= heap.Begin(3) && *it < heap.End(3))
+            it = expected.erase(it);
+        else
+            ++it;
+    }
+
+    auto added = reinterpret_cast<std::uintptr_t>(heap.base) + offset;
+    mprotect(reinterpret_cast<void*>(added), 3 * Page, PROT_READ | PROT_WRITE);
+    plant(added + Page + 100);
+
+    auto overwritten = *expected.lower_bound(heap.Begin(5));
+    memset(reinterpret_cast<void*>(overwritten), 0, MarkerLength);
+    expected.erase(overwritten);
+
+    auto hidden = heap.Begin(7) + heap.regions[7].second / 2 + 3;
+    bool hiddenFree = true;
+    for (auto address : expected) {
+        if (address + MarkerLength > hidden && address < hidden + MarkerLength)
+            hiddenFree = false;
+    }
+
+    stats = map.Scan(&pool);
+    Expect("changed: added", stats.added, 1);
+    Expect("changed: resized", stats.resized, 1);
+    Expect("changed: removed", stats.removed, 1);
+    Expect("changed: dropped", stats.dropped, 1);
+    Expect("changed: bytes scanned", stats.bytesScanned, heap.regions[1].second + 3 * Page);
+    Compare("changed", map.Results(marker), expected);
+    printf("rescan after changes: %zu KB in %.3fms\n", stats.bytesScanned / 1024, stats.milliseconds);
+
+    // A marker written into a region that kept its shape is only found once the map is invalidated.
+    if (hiddenFree) {
+        Plant(hidden, markerSeed);
+        stats = map.Scan(&pool);
+        Compare("unchanged region", map.Results(marker), expected);
+        expected.insert(hidden);
+        map.Invalidate();
+        stats = map.Scan(&pool);
+        Expect("invalidated: added", stats.added, count);
+        Compare("invalidated", map.Results(marker), expected);
+    }
+
+    // Reads of memory that isn't there fail instead of faulting.
+    std::uint8_t byte;
+    if (Regions::Read(heap.Begin(3), &byte, 1))
+        Fail("read of an inaccessible page succeeded");
+
+    // The whole process, for timing. The heap markers have to be among the results, the marker can't turn up in
+    // the Map's own pattern, and a rescan should be much cheaper than the first scan.
+    Regions::Map process;
+    process.Add("Marker", MarkerPattern(markerSeed));
+    auto full = process.Scan(&pool);
+    auto again = process.Scan(&pool);
+    auto results = process.Results("Marker");
+    for (auto address : expected) {
+        if (!std::binary_search(results.begin(), results.end(), address)) {
+            Fail("whole process: a heap marker is missing");
+            break;
+        }
+    }
+    printf("whole process: %zu regions, %zu KB in %.3fms, rescan %zu KB in %.3fms, %zu matches\n", full.regions,
+        full.bytesScanned / 1024, full.milliseconds, again.bytesScanned / 1024, again.milliseconds, results.size());
+
+    munmap(heap.base, heap.size);
+    printf("%zu regions with seed %u: %s\n", count, seed, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,100 @@
+// seqlockstress: hammers SeqLock from several writer and reader threads and checks that no reader ever sees
+// a half-written value.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++20 -O2 -pthread -Isrc tools/seqlockstress.cpp -o seqlockstress
+//
+// Usage:
+//   seqlockstress [--writers 2] [--readers 6] [--seconds 5]
+//
+// Exits with 1 if a torn read was seen.
+
+#include "seqlock.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Roughly the size and shape of the display state. Every field is derived from the same counter, so a
+    // consistent snapshot is easy to check.
+    struct Sample
+    {
+        std::uint32_t epoch;
+        float values[12];
+        int integers[4];
+    };
+
+    Sample MakeSample(std::uint32_t n)
+    {
+        Sample sample;
+        sample.epoch = n;
+        for (int i = 0; i < 12; ++i)
+            sample.values[i] = static_cast<float>(n) * (i + 1);
+        for (int i = 0; i < 4; ++i)
+            sample.integers[i] = static_cast<int>(n) ^ (0x5A5A5A5A << i);
+        return sample;
+    }
+
+    bool Consistent(const Sample& sample)
+    {
+        auto expected = MakeSample(sample.epoch);
+        return memcmp(&expected, &sample, sizeof(Sample)) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int writers = 2;
+    int readers = 6;
+    int seconds = 5;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--writers") == 0)
+            writers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--readers") == 0)
+            readers = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "--seconds") == 0)
+            seconds = atoi(argv[i + 1]);
+    }
+
+    SeqLock<Sample> lock(MakeSample(0));
+    std::atomic<bool> stop{ false };
+    std::atomic<std::uint32_t> counter{ 0 };
+    std::atomic<std::uint64_t> reads{ 0 };
+    std::atomic<std::uint64_t> torn{ 0 };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < writers; ++i) {
+        threads.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed))
+                lock.Store(MakeSample(++counter));
+        });
+    }
+    for (int i = 0; i < readers; ++i) {
+        threads.emplace_back([&] {
+            std::uint64_t localReads = 0;
+            std::uint64_t localTorn = 0;
+            while (!stop.load(std::memory_order_relaxed)) {
+                if (!Consistent(lock.Load()))
+                    ++localTorn;
+                ++localReads;
+            }
+            reads += localReads;
+            torn += localTorn;
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto& thread : threads)
+        thread.join();
+
+    printf("%d writer(s), %d reader(s), %ds: %u writes, %llu reads, %llu torn\n", writers, readers, seconds,
+        counter.load(), static_cast<unsigned long long>(reads.load()), static_cast<unsigned long long>(torn.load()));
+    return torn.load() ? 1 : 0;
+}
@@ -0,0 +1,416 @@
+// sigcheck: test corpus for the signature language in src/scanner.hpp.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++20 -O2 -pthread -Isrc tools/sigcheck.cpp -o sigcheck
+//
+// Usage:
+//   sigcheck [--seed N]
+//
+// Parses every signature in the corpus and compares the compiled pattern and operand program against the
+// expected form, or the expected error. Then resolves signatures against a small synthetic image laid out like
+// 32-bit game code, through the batch scanner the DLL uses, and checks random nibble-wildcard patterns give the
+// same match on every engine. Prints each failure and exits with 1 if there were any.
+
+#include "scanner.hpp"
+#include "threadpool.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// The compile-time parser accepts the same language. A bad literal here would fail the build.
+static_assert(Scanner::Signature("E8 ^ ?? ?? ?? ?? rel32").program.size() == 2);
+static_assert(Scanner::Signature("A1 ^ ?? ?? ?? ?? abs32 -C").program.operations[1].code == Scanner::Opcode::Abs32);
+static_assert(Scanner::Signature("8? ?F C3").pattern.mask[0] == 0xF0);
+static_assert(Scanner::Signature("8B 45 +4 -4").program.size() == 0);
+
+namespace
+{
+    const char* ErrorName(Scanner::ParseError error)
+    {
+        switch (error) {
+        case Scanner::ParseError::None: return "none";
+        case Scanner::ParseError::Empty: return "empty";
+        case Scanner::ParseError::BadToken: return "bad token";
+        case Scanner::ParseError::TooLong: return "too long";
+        case Scanner::ParseError::NoFixedBytes: return "no fixed bytes";
+        case Scanner::ParseError::BadCapture: return "bad capture";
+        case Scanner::ParseError::BadOperation: return "bad operation";
+        }
+        return "?";
+    }
+
+    // Pattern bytes with "?" for masked nibbles, then the program after a "|".
+    std::string Describe(const Scanner::Pattern& pattern, const Scanner::Program& program)
+    {
+        const char* digits = "0123456789ABCDEF";
+        std::string text;
+        for (std::size_t i = 0; i < pattern.size(); ++i) {
+            if (i)
+                text += ' ';
+            text += pattern.mask[i] & 0xF0 ? digits[pattern.bytes[i] >> 4] : '?';
+            text += pattern.mask[i] & 0x0F ? digits[pattern.bytes[i] & 0xF] : '?';
+        }
+        text += " |";
+        char buffer[16];
+        for (std::size_t i = 0; i < program.size(); ++i) {
+            const auto& operation = program.operations[i];
+            switch (operation.code) {
+            case Scanner::Opcode::Offset:
+                snprintf(buffer, sizeof(buffer), " %c%X", operation.operand < 0 ? '-' : '+',
+                    static_cast<unsigned>(operation.operand < 0 ? -static_cast<std::int64_t>(operation.operand) : operation.operand));
+                text += buffer;
+                break;
+            case Scanner::Opcode::Rel32: text += " rel32"; break;
+            case Scanner::Opcode::Abs32: text += " abs32"; break;
+            }
+        }
+        return text;
+    }
+
+    struct ParseCase
+    {
+        const char* text;
+        const char* expected;           // Describe() of the result
+        Scanner::ParseError error = Scanner::ParseError::None;
+    };
+
+    const ParseCase ParseCases[] = {
+        // The IDA-style subset the fixes have always used.
+        { "8B ?? ?? E8", "8B ?? ?? E8 |" },
+        { "8b ? 0f", "8B ?? 0F |" },
+        { "  C3  ", "C3 |" },
+        // Nibble wildcards.
+        { "8? ?5 ?? 0F", "8? ?5 ?? 0F |" },
+        { "?? 4?", "?? 4? |" },
+        // Capture points and operations.
+        { "^ E8 ?? ?? ?? ??", "E8 ?? ?? ?? ?? |" },
+        { "E8 ^ ?? ?? ?? ?? rel32", "E8 ?? ?? ?? ?? | +1 rel32" },
+        { "E8 ^ ?? ?? ?? ?? rel32 +62", "E8 ?? ?? ?? ?? | +1 rel32 +62" },
+        { "A1 ^ ?? ?? ?? ?? abs32 -12C", "A1 ?? ?? ?? ?? | +1 abs32 -12C" },
+        { "8B 3D ?? ?? ?? ?? +21", "8B 3D ?? ?? ?? ?? | +21" },
+        { "C3 ^", "C3 | +1" },
+        { "A1 ^ ?? ?? ?? ?? abs32 +C -C", "A1 ?? ?? ?? ?? | +1 abs32" },
+        { "90 ^ E8 ?? ?? ?? ?? +1 rel32", "90 E8 ?? ?? ?? ?? | +2 rel32" },
+        { "E8 ?? ?? ?? ?? -4 rel32 abs32", "E8 ?? ?? ?? ?? | -4 rel32 abs32" },
+        { "C3 +7FFFFFFF", "C3 | +7FFFFFFF" },
+        { "C3 -7FFFFFFF", "C3 | -7FFFFFFF" },
+        // Errors.
+        { "", "", Scanner::ParseError::Empty },
+        { "^", "", Scanner::ParseError::Empty },
+        { "?? ?", "", Scanner::ParseError::NoFixedBytes },
+        { "?? ?? rel32", "", Scanner::ParseError::NoFixedBytes },
+        { "8", "", Scanner::ParseError::BadToken },
+        { "8BC", "", Scanner::ParseError::BadToken },
+        { "8G", "", Scanner::ParseError::BadToken },
+        { "8B rel16", "", Scanner::ParseError::BadToken },
+        { "8B +", "", Scanner::ParseError::BadToken },
+        { "8B +1G", "", Scanner::ParseError::BadToken },
+        { "8B ^^", "", Scanner::ParseError::BadToken },
+        { "8B ^ ?? ^ ??", "", Scanner::ParseError::BadCapture },
+        { "8B rel32 ^", "", Scanner::ParseError::BadCapture },
+        { "8B rel32 ??", "", Scanner::ParseError::BadOperation },
+        { "8B +1 C3", "", Scanner::ParseError::BadOperation },
+        { "C3 +80000000", "", Scanner::ParseError::BadOperation },
+        { "C3 +100000000", "", Scanner::ParseError::BadOperation },
+        { "C3 +7FFFFFFF +1", "", Scanner::ParseError::BadOperation },
+        { "C3 rel32 rel32 rel32 rel32 rel32 rel32 rel32 rel32 rel32", "", Scanner::ParseError::BadOperation },
+    };
+
+    int failures = 0;
+
+    template<typename... Args>
+    void Fail(const char* format, Args... args)
+    {
+        printf("FAIL ");
+        printf(format, args...);
+        printf("\n");
+        ++failures;
+    }
+
+    void CheckParsing()
+    {
+        for (const auto& test : ParseCases) {
+            Scanner::ParseError error;
+            Scanner::Program program;
+            auto pattern = Scanner::Parse(test.text, &error, &program);
+            if (error != test.error) {
+                Fail("parse \"%s\": %s, expected %s", test.text, ErrorName(error), ErrorName(test.error));
+                continue;
+            }
+            if (error == Scanner::ParseError::None && Describe(pattern, program) != test.expected)
+                Fail("parse \"%s\": \"%s\", expected \"%s\"", test.text, Describe(pattern, program).c_str(), test.expected);
+        }
+        std::string tooLong;
+        for (std::size_t i = 0; i <= Scanner::MaxPatternLength; ++i)
+            tooLong += "90 ";
+        Scanner::ParseError error;
+        Scanner::Parse(tooLong.c_str(), &error);
+        if (error != Scanner::ParseError::TooLong)
+            Fail("parse of %zu bytes: %s, expected too long", Scanner::MaxPatternLength + 1, ErrorName(error));
+    }
+
+    // A small 32-bit image, loaded at its preferred base of 0x400000, with a code section and a data section.
+    constexpr std::uint32_t ImageBase = 0x400000;
+    constexpr std::size_t ImageSize = 0x3000;
+    constexpr std::size_t CodeStart = 0x1000;
+    constexpr std::size_t DataStart = 0x2000;
+
+    struct Writer
+    {
+        std::vector<std::uint8_t>& image;
+        std::size_t at;
+
+        Writer& Bytes(std::initializer_list<std::uint8_t> bytes)
+        {
+            for (auto byte : bytes)
+                image[at++] = byte;
+            return *this;
+        }
+
+        Writer& U32(std::uint32_t value)
+        {
+            memcpy(&image[at], &value, sizeof(value));
+            at += sizeof(value);
+            return *this;
+        }
+
+        // call/jmp rel32 to an RVA.
+        Writer& Rel32(std::uint8_t opcode, std::uint32_t target)
+        {
+            image[at++] = opcode;
+            return U32(static_cast<std::uint32_t>(target - (at + 4)));
+        }
+    };
+
+    struct ResolveCase
+    {
+        const char* name;
+        const char* text;
+        std::int64_t expected;          // RVA, or -1 if the signature must not resolve
+    };
+
+    const ResolveCase ResolveCases[] = {
+        // mov [esp+8], 480.0f; call SetViewport
+        { "call target", "C7 44 24 08 00 00 F0 43 E8 ^ ?? ?? ?? ?? rel32", 0x1800 },
+        { "call target +60", "C7 44 24 08 00 00 F0 43 E8 ^ ?? ?? ?? ?? rel32 +60", 0x1860 },
+        // A jmp rel32 at the call target, followed through.
+        { "call then jmp", "C7 44 24 08 00 00 F0 43 E8 ^ ?? ?? ?? ?? rel32 +1 rel32", 0x1900 },
+        // movss xmm0, [global]
+        { "global", "F3 0F 10 05 ^ ?? ?? ?? ?? F3 0F 59 C1 abs32", 0x2010 },
+        { "global -C", "F3 0F 10 05 ^ ?? ?? ?? ?? F3 0F 59 C1 abs32 -C", 0x2004 },
+        { "global +10", "F3 0F 10 05 ^ ?? ?? ?? ?? F3 0F 59 C1 abs32 +10", 0x2020 },
+        // Matched through nibble wildcards: mov e?x, [global]
+        { "nibble", "8B 1? ^ ?? ?? ?? ?? 85 C0 abs32", 0x2040 },
+        { "capture only", "80 7F 08 ^ 00 0F 85", 0x1103 },
+        { "offset past match", "80 7F 08 00 0F 85 +21", 0x1121 },
+        // Resolving outside the image must fail, not return a wild pointer.
+        { "rel32 outside", "E9 ^ ?? ?? ?? ?? CC CC CC rel32", -1 },
+        { "abs32 outside", "A1 ^ ?? ?? ?? ?? C3 abs32", -1 },
+        { "offset outside", "80 7F 08 00 0F 85 -2000", -1 },
+        { "not found", "0F 0B 0F 0B ^ ?? rel32", -1 },
+    };
+
+    std::vector<std::uint8_t> BuildImage()
+    {
+        std::vector<std::uint8_t> image(ImageSize, 0xCC);
+        memset(&image[DataStart], 0, ImageSize - DataStart);
+
+        Writer{ image, 0x1010 }.Bytes({ 0xC7, 0x44, 0x24, 0x08, 0x00, 0x00, 0xF0, 0x43 }).Rel32(0xE8, 0x1800);
+        Writer{ image, 0x1800 }.Rel32(0xE9, 0x1900);
+        Writer{ image, 0x1040 }.Bytes({ 0xF3, 0x0F, 0x10, 0x05 }).U32(ImageBase + 0x2010).Bytes({ 0xF3, 0x0F, 0x59, 0xC1 });
+        // mov ebx, [global]. An earlier mov with the wrong nibble mustn't match.
+        Writer{ image, 0x1060 }.Bytes({ 0x8B, 0x2D }).U32(ImageBase + 0x2030).Bytes({ 0x85, 0xC0 });
+        Writer{ image, 0x1070 }.Bytes({ 0x8B, 0x1D }).U32(ImageBase + 0x2040).Bytes({ 0x85, 0xC0 });
+        Writer{ image, 0x1100 }.Bytes({ 0x80, 0x7F, 0x08, 0x00, 0x0F, 0x85 });
+        Writer{ image, 0x1200 }.Bytes({ 0xE9 }).U32(0x7FFF0000).Bytes({ 0xCC, 0xCC, 0xCC });
+        Writer{ image, 0x1210 }.Bytes({ 0xA1 }).U32(0x10000000).Bytes({ 0xC3 });
+        return image;
+    }
+
+    void CheckResolution(ThreadPool& pool)
+    {
+        auto image = BuildImage();
+        std::vector<Scanner::Span> spans = {
+            { image.data() + CodeStart, DataStart - CodeStart, true, false },
+            { image.data() + DataStart, ImageSize - DataStart, false, true },
+        };
+
+        Scanner::Batch batch;
+        for (const auto& test : ResolveCases) {
+            Scanner::ParseError error;
+            Scanner::Program program;
+            auto pattern = Scanner::Parse(test.text, &error, &program);
+            if (error != Scanner::ParseError::None) {
+                Fail("resolve %s: \"%s\" doesn't parse (%s)", test.name, test.text, ErrorName(error));
+                continue;
+            }
+            batch.Add(test.name, test.text, pattern, program);
+        }
+        batch.SetModule({ image.data(), image.size(), ImageBase });
+        batch.Run(spans, &pool);
+
+        for (const auto& test : ResolveCases) {
+            auto resolved = batch.Find(test.name);
+            std::int64_t rva = resolved ? resolved - image.data() : -1;
+            if (rva != test.expected)
+                Fail("resolve %s: got %llx, expected %llx", test.name, static_cast<long long>(rva), static_cast<long long>(test.expected));
+        }
+    }
+
+    // Random patterns with nibble wildcards planted in random code. Every engine must return the match the
+    // scalar reference does, and so must the batch scanner.
+    void CheckEngines(unsigned seed, ThreadPool& pool)
+    {
+        std::mt19937 rng(seed);
+        constexpr int Rounds = 300;
+        for (int round = 0; round < Rounds; ++round) {
+            std::vector<std::uint8_t> data(4096 + rng() % 4096);
+            for (auto& byte : data)
+                byte = static_cast<std::uint8_t>(rng() % 16 == 0 ? 0x8B : rng());
+
+            std::size_t length = 2 + rng() % 24;
+            std::string text;
+            auto source = data.data() + rng() % (data.size() - length);
+            bool plant = rng() % 4 != 0;
+            for (std::size_t i = 0; i < length; ++i) {
+                char token[4];
+                snprintf(token, sizeof(token), "%02X", source[i]);
+                // The first byte always keeps a fixed nibble, so the pattern has one.
+                auto kind = rng() % 8;
+                if (kind == 0 && i > 0) token[0] = token[1] = '?';
+                else if (kind == 1) token[0] = '?';
+                else if (kind == 2) token[1] = '?';
+                text += token;
+                text += ' ';
+            }
+            // Without a plant the source bytes are scrambled, so a match may or may not exist.
+            if (!plant) {
+                for (std::size_t i = 0; i < length; ++i)
+                    source[i] ^= 0x5A;
+            }
+
+            Scanner::ParseError error;
+            auto pattern = Scanner::Parse(text.c_str(), &error);
+            if (error != Scanner::ParseError::None) {
+                Fail("engines round %d: \"%s\" doesn't parse (%s)", round, text.c_str(), ErrorName(error));
+                continue;
+            }
+
+            auto expected = Scanner::FindScalar(data.data(), data.size(), pattern);
+            if (plant && !expected)
+                Fail("engines round %d: scalar missed a planted \"%s\"", round, text.c_str());
+            for (auto engine : { Scanner::Engine::SSE2, Scanner::Engine::AVX2 }) {
+                if (Scanner::Resolve(engine) != engine)
+                    continue;
+                auto found = Scanner::Find(data.data(), data.size(), pattern, engine);
+                if (found != expected)
+                    Fail("engines round %d: %s disagrees with scalar on \"%s\"", round, Scanner::EngineName(engine), text.c_str());
+            }
+
+            Scanner::Batch batch;
+            batch.Add("random", text, pattern, {});
+            batch.Run({ Scanner::Span{ data.data(), data.size(), true, true } }, &pool);
+            auto found = batch[0].results.empty() ? nullptr : batch[0].results.front();
+            if (found != expected)
+                Fail("engines round %d: batch disagrees with scalar on \"%s\"", round, text.c_str());
+        }
+    }
+
+    // A batch big enough that its shared pass runs out of anchor bytes and scans some needles on their own, with
+    // every few signatures repeating an earlier pattern under the other match mode. First and all-match entries
+    // must agree with the scalar reference either way.
+    void CheckSharedPass(unsigned seed, ThreadPool& pool)
+    {
+        std::mt19937 rng(seed);
+        constexpr int Rounds = 20;
+        constexpr std::size_t Signatures = 48;
+        for (int round = 0; round < Rounds; ++round) {
+            std::vector<std::uint8_t> data(65536 + rng() % 65536);
+            for (auto& byte : data)
+                byte = static_cast<std::uint8_t>(rng() % 8 == 0 ? 0x8B : rng());
+
+            Scanner::Batch batch;
+            std::vector<Scanner::Pattern> patterns;
+            std::vector<std::string> texts;
+            for (std::size_t id = 0; id < Signatures; ++id) {
+                auto mode = id % 2 ? Scanner::Match::All : Scanner::Match::First;
+                if (!texts.empty() && rng() % 5 == 0) {
+                    auto copy = rng() % texts.size();
+                    batch.Add("duplicate", texts[copy], patterns[copy], {}, mode);
+                    texts.push_back(texts[copy]);
+                    patterns.push_back(patterns[copy]);
+                    continue;
+                }
+
+                std::size_t length = 8 + rng() % 24;
+                auto source = data.data() + rng() % (data.size() - length);
+                // A second copy further on gives the all-match entries more than one result.
+                if (rng() % 2) {
+                    auto copy = data.data() + rng() % (data.size() - length);
+                    if (copy + length <= source || copy >= source + length)
+                        memcpy(copy, source, length);
+                }
+                std::string text;
+                for (std::size_t i = 0; i < length; ++i) {
+                    char token[4];
+                    snprintf(token, sizeof(token), "%02X", source[i]);
+                    if (i > 0 && rng() % 6 == 0)
+                        token[0] = token[1] = '?';
+                    text += token;
+                    text += ' ';
+                }
+                if (rng() % 8 == 0)
+                    data[source - data.data()] ^= 0x5A;
+
+                Scanner::ParseError error;
+                auto pattern = Scanner::Parse(text.c_str(), &error);
+                if (error != Scanner::ParseError::None) {
+                    Fail("shared pass round %d: \"%s\" doesn't parse (%s)", round, text.c_str(), ErrorName(error));
+                    continue;
+                }
+                batch.Add("random", text, pattern, {}, mode);
+                texts.push_back(text);
+                patterns.push_back(pattern);
+            }
+
+            batch.Run({ Scanner::Span{ data.data(), data.size(), true, true } }, round % 2 ? &pool : nullptr);
+            for (std::size_t id = 0; id < patterns.size(); ++id) {
+                std::vector<const std::uint8_t*> expected;
+                const std::uint8_t* p = data.data();
+                auto end = data.data() + data.size();
+                while (auto hit = Scanner::FindScalar(p, end - p, patterns[id])) {
+                    expected.push_back(hit);
+                    if (batch[id].mode == Scanner::Match::First)
+                        break;
+                    p = hit + 1;
+                }
+                if (batch[id].results != expected)
+                    Fail("shared pass round %d: batch disagrees with scalar on \"%s\" (%zu results, expected %zu)", round,
+                        batch[id].signature.c_str(), batch[id].results.size(), expected.size());
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--seed") == 0)
+            seed = static_cast<unsigned>(strtoul(argv[i + 1], nullptr, 10));
+    }
+
+    ThreadPool pool(4);
+    CheckParsing();
+    CheckResolution(pool);
+    CheckEngines(seed, pool);
+    CheckSharedPass(seed, pool);
+
+    printf("%zu parse cases, %zu resolve cases, random engine rounds with seed %u: %s\n", std::size(ParseCases),
+        std::size(ResolveCases), seed, failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+// xrefcheck: tests the cross-reference index in src/xrefs.hpp against small hand-assembled images.
+//
+// Build (Linux, from the repository root):
+//   g++ -std=c++20 -O2 -Isrc -Iexternal/safetyhook tools/xrefcheck.cpp -o xrefcheck
+//
+// Usage:
+//   xrefcheck
+//
+// Zydis is replaced by a decoder for the few instructions the images are made of (see tools/README.md), so this
+// checks what the index does with decoded instructions rather than Zydis itself. A 32-bit image loaded away from
+// its preferred base has direct calls, absolute reads and writes, a read-modify-write, a pushed address, an
+// address taken with lea, a table read through an index register, a call through an import slot, an fs: access,
+// addresses outside the image, and a byte that doesn't decode. Checks every query against what was planted, then
+// does the same for the RIP-relative forms in a 64-bit image. Prints each failure and exits with 1 if there were
+// any.
+
+#include "xrefs.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    bool longMode = false;
+
+    std::int32_t Read32(const std::uint8_t* p)
+    {
+        std::int32_t value;
+        memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // One operand naming [disp32], absolute on 32-bit and RIP-relative on 64-bit, the way Zydis reports both.
+    void Memory(ZydisDecodedOperand& operand, std::int32_t disp, ZydisOperandActions actions,
+        ZydisMemoryOperandType type = ZYDIS_MEMOP_TYPE_MEM)
+    {
+        operand.type = ZYDIS_OPERAND_TYPE_MEMORY;
+        operand.mem.type = type;
+        operand.mem.base = longMode ? ZYDIS_REGISTER_RIP : ZYDIS_REGISTER_NONE;
+        operand.mem.disp.has_displacement = true;
+        operand.mem.disp.value = longMode ? disp : static_cast<std::uint32_t>(disp);
+        operand.actions = actions;
+    }
+}
+
+// Decodes:
+//   E8 rel32           call rel32
+//   A1 / A3 disp32     mov eax, [disp32] / mov [disp32], eax
+//   01 05 disp32       add [disp32], eax
+//   68 imm32           push imm32
+//   8D 05 disp32       lea eax, [disp32]
+//   8B 04 85 disp32    mov eax, [eax*4 + disp32]
+//   FF 15 disp32       call [disp32]
+//   64 A1 disp32       mov eax, fs:[disp32]
+// CC fails to decode, everything else is a one byte instruction with no operands.
+extern "C" ZyanStatus ZydisDecoderInit(ZydisDecoder*, ZydisMachineMode mode, ZydisStackWidth)
+{
+    longMode = mode == ZYDIS_MACHINE_MODE_LONG_64;
+    return ZYAN_STATUS_SUCCESS;
+}
+
+extern "C" ZyanStatus ZydisDecoderDecodeFull(const ZydisDecoder*, const void* buffer, ZyanUSize length,
+    ZydisDecodedInstruction* instruction, ZydisDecodedOperand* operands)
+{
+    auto p = static_cast<const std::uint8_t*>(buffer);
+    memset(instruction, 0, sizeof(*instruction));
+    memset(operands, 0, sizeof(ZydisDecodedOperand) * ZYDIS_MAX_OPERAND_COUNT);
+    if (p[0] == 0xCC)
+        return ZYAN_STATUS_INVALID_ARGUMENT;
+
+    auto fits = [&](std::size_t size, std::size_t count) {
+        if (length < size)
+            return false;
+        instruction->length = static_cast<ZyanU8>(size);
+        instruction->operand_count_visible = static_cast<ZyanU8>(count);
+        return true;
+    };
+
+    instruction->length = 1;
+    if (p[0] == 0xE8 && fits(5, 1)) {
+        instruction->meta.category = ZYDIS_CATEGORY_CALL;
+        operands[0].type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
+        operands[0].imm.is_relative = true;
+        operands[0].imm.value.s = Read32(p + 1);
+    }
+    else if ((p[0] == 0xA1 || p[0] == 0xA3) && fits(5, 2)) {
+        Memory(operands[p[0] == 0xA1 ? 1 : 0], Read32(p + 1), p[0] == 0xA1 ? ZYDIS_OPERAND_ACTION_READ : ZYDIS_OPERAND_ACTION_WRITE);
+    }
+    else if (p[0] == 0x01 && p[1] == 0x05 && fits(6, 2)) {
+        Memory(operands[0], Read32(p + 2), ZYDIS_OPERAND_ACTION_READWRITE);
+    }
+    else if (p[0] == 0x68 && fits(5, 1)) {
+        operands[0].type = ZYDIS_OPERAND_TYPE_IMMEDIATE;
+        operands[0].size = 32;
+        operands[0].imm.value.u = static_cast<std::uint32_t>(Read32(p + 1));
+    }
+    else if (p[0] == 0x8D && p[1] == 0x05 && fits(6, 2)) {
+        Memory(operands[1], Read32(p + 2), static_cast<ZydisOperandActions>(0), ZYDIS_MEMOP_TYPE_AGEN);
+    }
+    else if (p[0] == 0x8B && p[1] == 0x04 && p[2] == 0x85 && fits(7, 2)) {
+        Memory(operands[1], Read32(p + 3), ZYDIS_OPERAND_ACTION_READ);
+        operands[1].mem.base = ZYDIS_REGISTER_NONE;
+        operands[1].mem.index = ZYDIS_REGISTER_EAX;
+        operands[1].mem.scale = 4;
+    }
+    else if (p[0] == 0xFF && p[1] == 0x15 && fits(6, 1)) {
+        instruction->meta.category = ZYDIS_CATEGORY_CALL;
+        Memory(operands[0], Read32(p + 2), ZYDIS_OPERAND_ACTION_READ);
+    }
+    else if (p[0] == 0x64 && p[1] == 0xA1 && fits(6, 2)) {
+        Memory(operands[1], Read32(p + 2), ZYDIS_OPERAND_ACTION_READ);
+        operands[1].mem.segment = ZYDIS_REGISTER_FS;
+    }
+    return ZYAN_STATUS_SUCCESS;
+}
+
+extern "C" ZyanStatus ZydisCalcAbsoluteAddress(const ZydisDecodedInstruction* instruction, const ZydisDecodedOperand* operand,
+    ZyanU64 runtimeAddress, ZyanU64* result)
+{
+    *result = runtimeAddress + instruction->length + operand->imm.value.s;
+    return ZYAN_STATUS_SUCCESS;
+}
+
+namespace
+{
+    constexpr std::uint32_t Text = 0x1000;
+    constexpr std::uint32_t Data = 0x2000;
+    constexpr std::uint32_t ImageSize = 0x3000;
+
+    int failures = 0;
+
+    void Expect(bool condition, const char* what)
+    {
+        if (!condition) {
+            printf("FAIL: %s\n", what);
+            ++failures;
+        }
+    }
+
+    // .text and .data, filled with one byte instructions that don't reference anything.
+    struct Image
+    {
+        std::vector<std::uint8_t> bytes = std::vector<std::uint8_t>(ImageSize, 0x90);
+        Pe::Headers headers;
+        std::uint64_t base;
+
+        Image(bool is64, std::uint64_t imageBase, std::uint64_t loadedAt) : base(loadedAt)
+        {
+            headers.valid = true;
+            headers.is64 = is64;
+            headers.imageBase = imageBase;
+            headers.sizeOfImage = ImageSize;
+
+            Pe::Section text;
+            text.name = ".text";
+            text.virtualAddress = Text;
+            text.virtualSize = 0x1000;
+            text.characteristics = Pe::ScnCntCode | Pe::ScnMemExecute | Pe::ScnMemRead;
+            headers.sections.push_back(text);
+
+            Pe::Section data;
+            data.name = ".data";
+            data.virtualAddress = Data;
+            data.virtualSize = 0x1000;
+            data.characteristics = Pe::ScnCntInitializedData | Pe::ScnMemRead | Pe::ScnMemWrite;
+            headers.sections.push_back(data);
+        }
+
+        void Put(std::uint32_t rva, std::initializer_list<std::uint8_t> opcode, std::int32_t value)
+        {
+            std::copy(opcode.begin(), opcode.end(), bytes.begin() + rva);
+            memcpy(&bytes[rva + opcode.size()], &value, sizeof(value));
+        }
+
+        void Call(std::uint32_t rva, std::uint32_t callee)
+        {
+            Put(rva, { 0xE8 }, static_cast<std::int32_t>(callee - (rva + 5)));
+        }
+
+        // An instruction naming target by its absolute address.
+        void Absolute(std::uint32_t rva, std::initializer_list<std::uint8_t> opcode, std::uint32_t target)
+        {
+            Put(rva, opcode, static_cast<std::int32_t>(base + target));
+        }
+
+        // The same instruction naming target relative to the next one.
+        void Relative(std::uint32_t rva, std::initializer_list<std::uint8_t> opcode, std::uint32_t target)
+        {
+            Put(rva, opcode, static_cast<std::int32_t>(target - (rva + opcode.size() + 4)));
+        }
+    };
+
+    bool Has(std::span<const Xrefs::Reference> references, std::uint32_t from, Xrefs::Access access)
+    {
+        return std::any_of(references.begin(), references.end(),
+            [&](const Xrefs::Reference& reference) { return reference.from == from && reference.access == access; });
+    }
+
+    void Check32()
+    {
+        // Loaded away from its preferred base, so absolute operands hold relocated addresses.
+        Image image(false, 0x400000, 0x10000000);
+        image.Call(Text + 0x100, Text + 0x800);
+        image.Call(Text + 0x050, Text + 0x800);
+        image.Call(Text + 0x200, Text + 0x800);
+        image.Call(Text + 0x300, Text + 0x900);
+        image.Call(Text + 0x310, 0x8000);                           // outside the image
+        image.Absolute(Text + 0x400, { 0xA1 }, Data + 0x10);
+        image.Absolute(Text + 0x410, { 0xA3 }, Data + 0x10);
+        image.Absolute(Text + 0x420, { 0x68 }, Data + 0x10);
+        image.Absolute(Text + 0x430, { 0x01, 0x05 }, Data + 0x10);
+        image.Absolute(Text + 0x440, { 0x8D, 0x05 }, Data + 0x20);
+        image.Absolute(Text + 0x450, { 0x8B, 0x04, 0x85 }, Data + 0x40);
+        image.Absolute(Text + 0x460, { 0xFF, 0x15 }, Data + 0x100);
+        image.Absolute(Text + 0x470, { 0xA3 }, 0x90000);             // outside the image
+        image.Absolute(Text + 0x480, { 0x64, 0xA1 }, Data + 0x10);   // fs:[...] isn't in the image
+        image.Put(Text + 0x490, { 0x68 }, 0x12345678);               // a plain constant
+        image.bytes[Text + 0x4A0] = 0xCC;
+        image.Call(Text + 0x4A1, Text + 0xA00);                     // resynchronises after the bad byte
+
+        Xrefs::Index index;
+        Expect(index.Build(image.bytes.data(), image.headers, image.base), "32-bit: build failed");
+
+        auto callers = index.CallersOf(Text + 0x800);
+        Expect(callers.size() == 3 && callers[0].from == Text + 0x050 && callers[1].from == Text + 0x100 &&
+            callers[2].from == Text + 0x200, "32-bit: callers aren't the three calls in call site order");
+        Expect(index.CallersOf(Text + 0x900).size() == 1, "32-bit: second callee");
+        Expect(index.CallersOf(Text + 0xA00).size() == 1, "32-bit: call after a byte that doesn't decode");
+        Expect(index.CallersOf(Text + 0x234).empty(), "32-bit: callers of something nobody calls");
+        Expect(index.Calls() == 5, "32-bit: a call outside the image was recorded");
+
+        Expect(index.CalleeAt(Text + 0x200) == Text + 0x800 && index.CalleeAt(Text + 0x300) == Text + 0x900,
+            "32-bit: callee at a call site");
+        Expect(index.CalleeAt(Text + 0x201) == 0, "32-bit: callee in the middle of a call");
+        auto from = index.CallsFrom(Text, Text + 0x250);
+        Expect(from.size() == 3 && from[0].from == Text + 0x050 && from[2].from == Text + 0x200,
+            "32-bit: calls from a range aren't in call site order");
+
+        using Xrefs::Access;
+        auto references = index.ReferencesTo(Data + 0x10);
+        Expect(references.size() == 4, "32-bit: references to a variable");
+        Expect(Has(references, Text + 0x400, Access::Read), "32-bit: read");
+        Expect(Has(references, Text + 0x410, Access::Write), "32-bit: write");
+        Expect(Has(references, Text + 0x420, Access::Address), "32-bit: pushed address");
+        Expect(Has(references, Text + 0x430, Access::ReadWrite), "32-bit: read-modify-write");
+        auto writers = index.WritersOf(Data + 0x10);
+        Expect(writers.size() == 2 && writers[0] == Text + 0x410 && writers[1] == Text + 0x430, "32-bit: writers");
+
+        Expect(Has(index.ReferencesTo(Data + 0x20), Text + 0x440, Access::Address), "32-bit: lea");
+        Expect(Has(index.ReferencesTo(Data + 0x40), Text + 0x450, Access::Read), "32-bit: indexed table base");
+        Expect(Has(index.ReferencesTo(Data + 0x100), Text + 0x460, Access::Read), "32-bit: call through an import slot");
+        Expect(index.ReferencesTo(Data, Data + 0x100).size() == 6, "32-bit: references to a range");
+        Expect(index.References() == 7, "32-bit: fs:, a constant or an address outside the image was recorded");
+    }
+
+    void Check64()
+    {
+        // RIP-relative operands, and immediates that are never taken for addresses even where they could be one.
+        Image image(true, 0x140000000ull, 0x10000000);
+        image.Relative(Text + 0x000, { 0xA3 }, Data + 0x40);
+        image.Relative(Text + 0x010, { 0xA1 }, Data + 0x40);
+        image.Relative(Text + 0x020, { 0x8D, 0x05 }, Data + 0x80);
+        image.Call(Text + 0x030, Text + 0x800);
+        image.Absolute(Text + 0x040, { 0x68 }, Data + 0x40);
+
+        Xrefs::Index index;
+        Expect(index.Build(image.bytes.data(), image.headers, image.base), "64-bit: build failed");
+        using Xrefs::Access;
+        auto references = index.ReferencesTo(Data + 0x40);
+        Expect(references.size() == 2 && Has(references, Text + 0x000, Access::Write) &&
+            Has(references, Text + 0x010, Access::Read), "64-bit: RIP-relative read and write");
+        Expect(Has(index.ReferencesTo(Data + 0x80), Text + 0x020, Access::Address), "64-bit: RIP-relative lea");
+        Expect(index.CalleeAt(Text + 0x030) == Text + 0x800, "64-bit: call");
+        Expect(index.References() == 3, "64-bit: an immediate was taken for an address");
+    }
+}
+
+int main()
+{
+    Check32();
+    Check64();
+    printf("xrefs: %s\n", failures ? "FAILED" : "ok");
+    return failures ? 1 : 0;
+}